@@ -0,0 +1,29 @@
+#ifndef __BATCH_RENDERER_H__
+#define __BATCH_RENDERER_H__
+
+#include "common.h"
+
+// Headless batch rendering of preview images: every terrain is rendered from a set of
+// viewpoints into an offscreen framebuffer and written as PNG. Pixels are read back
+// asynchronously through PBOs and encoded on a thread pool, overlapping with rendering.
+//
+// usage: make_terrain --batch [--terrain NAME]... [--camera-path FILE] [--views N]
+//        [--width W] [--height H] [--threads N] [--context osmesa|egl] [--output-dir DIR]
+struct BatchOptions {
+    std::vector<std::string> terrainNames;  // empty: every terrain in assets/Terrain
+    std::string cameraPathFile;             // empty: orbit around the terrain
+    std::string outputDir = "thumbnails";
+    std::string contextAPI = "osmesa";
+    int numViews = 4;                       // evenly spaced over the camera path
+    int width = 512;
+    int height = 512;
+    int numThreads = 0;                     // 0: one per hardware thread
+};
+
+class BatchRenderer {
+public:
+    static bool parseOptions(int argc, const char** argv, BatchOptions& options);
+    static int run(const BatchOptions& options);
+};
+
+#endif // __BATCH_RENDERER_H__
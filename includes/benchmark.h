@@ -0,0 +1,38 @@
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include "common.h"
+
+// Headless, deterministic benchmark: renders a fixed number of frames offscreen
+// while replaying a camera path with a fixed timestep, and writes timing results as JSON.
+//
+// usage: make_terrain --benchmark [--terrain NAME] [--camera-path FILE] [--frames N]
+//        [--warmup N] [--dt SECONDS] [--width W] [--height H] [--context osmesa|egl]
+//        [--output FILE] [--replay FILE] [--generator-parity]
+//
+// --generator-parity renders nothing: it generates the procedural terrain with both noise types on the GPU
+// and on the CPU, writes the largest difference as JSON and fails if it exceeds GENERATOR_PARITY_TOLERANCE.
+struct BenchmarkOptions {
+    std::string terrainName;          // empty: the default terrain
+    std::string cameraPathFile;       // empty: orbit around the terrain
+    std::string replayFile;           // input recording; replaces the camera path and frame count
+    std::string outputFile = "benchmark.json";
+    std::string contextAPI = "osmesa";
+    int numFrames = 300;
+    int numWarmupFrames = 10;
+    float fixedDeltaTime = 1.0f / 60.0f;
+    int width = WINDOW_WIDTH;
+    int height = WINDOW_HEIGHT;
+    bool generatorParity = false;
+    bool invalid = false;             // an option was rejected, run fails without rendering
+};
+
+class Benchmark {
+public:
+    static bool parseOptions(int argc, const char** argv, BenchmarkOptions& options);
+    static int run(const BenchmarkOptions& options);
+    static GLFWwindow* createOffscreenWindow(int width, int height, const std::string& contextAPI);
+    static constexpr float GENERATOR_PARITY_TOLERANCE = 1e-3f;  // in normalized heights
+};
+
+#endif // __BENCHMARK_H__
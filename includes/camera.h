@@ -53,6 +53,7 @@ public:
     void reset();
     void invertPitch();
     void rotateCamera(float theta);
+    void setPose(glm::vec3 position, float yaw, float pitch);
 private:
     void updateCameraVectors();
 };
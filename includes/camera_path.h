@@ -0,0 +1,29 @@
+#ifndef __CAMERA_PATH_H__
+#define __CAMERA_PATH_H__
+
+#include "common.h"
+
+class Camera;  // forward declaration
+
+// Camera keyframes interpolated linearly over time.
+// File format: one keyframe per line, "time x y z yaw pitch"; '#' starts a comment.
+class CameraPath {
+public:
+    struct Keyframe {
+        float time;
+        glm::vec3 position;
+        float yaw;
+        float pitch;
+    };
+
+    static std::unique_ptr<CameraPath> load(const std::string& filePath);
+    static std::unique_ptr<CameraPath> createOrbit(float radius, float height, float pitch, float duration);
+    void apply(float time, Camera* camera) const;
+    float getDuration() const { return keyframes.back().time; }
+
+private:
+    CameraPath() {};
+    std::vector<Keyframe> keyframes;
+};
+
+#endif // __CAMERA_PATH_H__
@@ -11,6 +11,15 @@
 #include "framebuffer.h"
 #include "water.h"
 #include "fog.h"
+#include "dynamic_resolution.h"
+#include "gpu_profiler.h"
+#include "cpu_profiler.h"
+#include "pipeline_statistics.h"
+#include "input_recorder.h"
+#include "frame_capture.h"
+#include "thread_pool.h"
+#include "hiz_buffer.h"
+#include "ground_clamp.h"
 
 class Context {
 public:
@@ -21,17 +30,43 @@ public:
     void _renderToWaterFramebuffer();
     void _renderToAntiAliasingScreenBuffer();
     void _renderToScreen();
+    void _updateRenderResolution();
     void renderGUI();
     void updateDeltaTime();
-    void processInput(GLFWwindow* window);
+    void setFixedDeltaTime(float fixedDeltaTime) { this->fixedDeltaTime = fixedDeltaTime; }
+    float getElapsedTime() { return elapsedTime; }
+    bool selectTerrain(const std::string& terrainName);
+    const std::vector<std::string>& getTerrainNames() { return terrainNames; }
+    void setOutputFramebuffer(Framebuffer* framebuffer) { outputFramebuffer = framebuffer; }
+    Camera* getCamera() { return camera.get(); }
+    Terrain* getTerrain() { return terrain.get(); }
+    void update(GLFWwindow* window);
+    unsigned int readKeyState(GLFWwindow* window);
+    void applyKeyState(unsigned int keyMask);
     void reshape(int width, int height);
     void mouseMove(double x, double y);
     void mouseButton(int button, int action, double x, double y);
+    void _mouseMove(double x, double y);
+    void _mouseButton(int button, int action, double x, double y, bool capturedByGui);
     glm::mat4 getModelMatrix(glm::vec3 transl = glm::vec3(0.0f), glm::vec3 axis = glm::vec3(0.0f, 1.0f, 0.0f), float angleInDeg = 0.0f, glm::vec3 scale = glm::vec3(1.0f));
     glm::mat4 getViewMatrix();
     glm::mat4 getProjectionMatrix();
     glm::vec3 getCameraPosition(); // added for Water class
+    bool pickTerrain(double x, double y, glm::vec3& position);  // cursor position to the ground point under it
     glm::vec4 getClipPlane();
+    GpuProfiler* getGpuProfiler() { return gpuProfiler.get(); }
+    void dumpCpuTrace();
+    InputRecorder* getInputRecorder() { return inputRecorder.get(); }
+    void toggleInputRecording();
+    FrameCapture* getFrameCapture() { return frameCapture.get(); }
+    const HiZBuffer* getHiZBuffer() const { return hiZBuffer.get(); }  // previous frame's scene depth, check isValid()
+    bool isReverseZ() const { return useReverseZ && isReverseZSupported; }  // camera depth is 1 at the near plane, 0 at infinity
+    void takeScreenshot();
+    void toggleVideoCapture();
+    void undoTerrainEdit();
+    void redoTerrainEdit();
+    void clearErosionWater();
+    void restoreTerrain();  // reloads the selected terrain, discarding erosion and sculpting
 
     friend class DirectionalLight;
     friend class Terrain;
@@ -40,32 +75,61 @@ public:
 private:
     Context() {};
     bool init();
+    void _trackRecordedParameters();
+    void _buildHiZ();
+    void _updateViewshed();
+    void _sculptTerrain();
+    void _setDepthConvention(bool reversed);
 
+    std::unique_ptr<ThreadPool> threadPool;  // CPU work of the subsystems, e.g. terrain preprocessing
     std::unique_ptr<Camera> camera;
+    std::unique_ptr<GroundClamp> groundClamp;  // keeps the camera above the terrain
     std::unique_ptr<DirectionalLight> light;
     std::unique_ptr<Terrain> terrain;
     std::unique_ptr<Skybox> skybox;
     std::unique_ptr<Water> water;
     std::unique_ptr<Fog> fog;
+    std::unique_ptr<DynamicResolution> dynamicResolution;
+    std::unique_ptr<GpuProfiler> gpuProfiler;
+    std::unique_ptr<PipelineStatistics> pipelineStatistics;
+    std::unique_ptr<InputRecorder> inputRecorder;
+    std::unique_ptr<FrameCapture> frameCapture;
     std::unique_ptr<Framebuffer> depthMap;
     std::unique_ptr<Framebuffer> fogScreenBuffer;
+    std::unique_ptr<HiZBuffer> hiZBuffer;  // max-depth pyramid of fogScreenBuffer
     std::unique_ptr<Framebuffer> debugScreenBuffer;
     std::unique_ptr<Framebuffer> antiAliasingScreenBuffer;
     std::unique_ptr<Shader> depthQuadShader;
     std::unique_ptr<Shader> FXAAShader;
+    Framebuffer* outputFramebuffer = nullptr;  // final image target, the window when null
     unsigned int screenQuadVAO;
 
     int width = WINDOW_WIDTH;
     int height = WINDOW_HEIGHT;
+    int renderWidth = WINDOW_WIDTH;   // size of the internal scene render targets
+    int renderHeight = WINDOW_HEIGHT;
     bool cameraMouseControlActivated = false;
+    double cursorX = 0.0;  // last cursor position, window units
+    double cursorY = 0.0;
+    bool isSculpting = false;  // left button held with the sculptor enabled
+    bool isNewStroke = false;
+    bool hasPickedPosition = false;  // left click on the terrain
+    glm::vec3 pickedPosition = glm::vec3(0.0f);
+    float generatorParityError = -1.0f;  // GPU against CPU generation, negative until compared
+    glm::vec2 viewshedObserver = glm::vec2(0.0f);  // world (x, z)
     float lastX = WINDOW_WIDTH / 2.0f;
     float lastY = WINDOW_HEIGHT / 2.0f;
     float deltaTime = 0.0f;
     float lastTime = 0.0f;
+    float fixedDeltaTime = 0.0f;  // replaces the measured frame time when positive
+    float elapsedTime = 0.0f;     // sum of delta times, drives animations
     std::vector<std::string> terrainNames;
     int currentTerrainIdx = -1;
+    std::string currentTerrainName;  // recorded by name, the indices depend on the terrains present
+    bool terrainResetPending = false;  // set by the replayed terrain and generator parameters
 
     // flags
+    std::string currentPass;  // name of the render pass in progress, used for statistics
     bool isRenderingToDepthMap = false;
     bool isRenderingReflection = false;
 
@@ -78,6 +142,8 @@ private:
     bool useAntiAliasing = true;
     bool useAntiAliasingSaved = useAntiAliasing;
     bool showLightDirection = false;
+    bool useReverseZ = true;
+    bool isReverseZSupported = false;  // needs glClipControl (GL 4.5 or ARB_clip_control)
 
     // shadow mapping
     bool useShadow = true;
@@ -92,6 +158,22 @@ private:
     float mulReduce = 1.0f / 8.0f;
     float minReduce = 1.0f / 128.0f;
     float maxSpan = 8.0f;
+
+    // profiling
+    int traceFrames = 120;
+    char tracePath[256] = "cpu_trace.json";
+
+    // input recording
+    char recordingPath[256] = "input.rec";
+    bool replayAtMaximumSpeed = false;
+
+    // export, to assets/Terrain/<name>
+    char exportName[128] = "Exported Terrain";
+
+    // capture
+    char videoPath[256] = "capture";  // PNG sequence prefix, or Y4M file ("-" for stdout)
+    int videoFormat = 0;              // FrameCapture::Format
+    int videoFrameRate = 60;
 };
 
 inline glm::mat4 Context::getModelMatrix(glm::vec3 transl, glm::vec3 axis, float angleInDeg, glm::vec3 scale) {
@@ -107,7 +189,18 @@ inline glm::mat4 Context::getViewMatrix() {
 }
 
 inline glm::mat4 Context::getProjectionMatrix() {
-    return glm::perspective(glm::radians(camera->zoom), (float)this->width / (float)this->height, 0.1f, 100000.0f);
+    float aspect = (float)this->width / (float)this->height;
+    if (isReverseZ()) {
+        // infinite far plane; with a [0, 1] clip range depth is near / distance, spreading float precision evenly
+        float focal = 1.0f / std::tan(glm::radians(camera->zoom) / 2.0f);
+        glm::mat4 projection(0.0f);
+        projection[0][0] = focal / aspect;
+        projection[1][1] = focal;
+        projection[2][3] = -1.0f;
+        projection[3][2] = 0.1f;
+        return projection;
+    }
+    return glm::perspective(glm::radians(camera->zoom), aspect, 0.1f, 100000.0f);
 }
 
 inline glm::vec3 Context::getCameraPosition() {
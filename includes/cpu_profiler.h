@@ -0,0 +1,53 @@
+#ifndef __CPU_PROFILER_H__
+#define __CPU_PROFILER_H__
+
+#include "common.h"
+#include <atomic>
+#include <cstdint>
+
+// Lightweight scoped-zone CPU instrumentation.
+// Each thread records completed zones into its own ring buffer, so recording is a
+// couple of clock reads and a store without any locking. Zone names must be string
+// literals (or otherwise outlive the profiler) since only the pointer is stored.
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) CpuProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+
+class CpuProfiler {
+public:
+    struct Event {
+        const char* name;
+        uint64_t startNs;
+        uint64_t endNs;
+        uint32_t threadId;
+    };
+
+    static uint64_t now();
+    static void record(const char* name, uint64_t startNs, uint64_t endNs);
+    static void markFrame();  // call once per frame on the main thread
+    static void setThreadName(const std::string& name);
+    static std::vector<Event> getEvents(int numFrames);  // zones of the last numFrames frames
+    static bool dumpChromeTrace(const std::string& filePath, int numFrames);
+
+    static std::atomic<bool> enabled;
+    static constexpr int EVENTS_PER_THREAD = 1 << 16;
+    static constexpr int MAX_FRAMES = 1024;
+};
+
+class CpuProfileZone {
+public:
+    CpuProfileZone(const char* name) : name(name) {
+        if (CpuProfiler::enabled.load(std::memory_order_relaxed))
+            startNs = CpuProfiler::now();
+    }
+    ~CpuProfileZone() {
+        if (startNs != 0)
+            CpuProfiler::record(name, startNs, CpuProfiler::now());
+    }
+private:
+    const char* name;
+    uint64_t startNs = 0;
+};
+
+#endif // __CPU_PROFILER_H__
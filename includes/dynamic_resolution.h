@@ -0,0 +1,43 @@
+#ifndef __DYNAMIC_RESOLUTION_H__
+#define __DYNAMIC_RESOLUTION_H__
+
+#include "common.h"
+
+// Scales the internal scene render targets to hold a target GPU frame time.
+// GPU time is measured with GL_TIMESTAMP query pairs so it does not conflict with
+// GL_TIME_ELAPSED queries issued by other code in the same frame.
+class DynamicResolution {
+public:
+    static std::unique_ptr<DynamicResolution> create();
+    ~DynamicResolution();
+    void beginFrame();
+    void endFrame();
+    bool update();  // returns true when the render scale has changed
+    void reset();
+    float getGPUFrameTime() const { return gpuFrameTimeMs; }
+
+    bool enabled = false;
+    float targetFrameTimeMs = 16.6f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    float scaleStep = 0.05f;      // render scale is quantized to avoid resizing every frame
+    float tolerance = 0.1f;       // relative frame time error ignored by the controller
+    int adjustInterval = 15;      // minimum number of frames between two adjustments
+    float scale = 1.0f;
+
+private:
+    DynamicResolution() {};
+    void init();
+    void collectQueryResult(int slot);
+
+    static constexpr int NUM_QUERY_FRAMES = 3;
+    unsigned int startQueries[NUM_QUERY_FRAMES] = { 0 };
+    unsigned int endQueries[NUM_QUERY_FRAMES] = { 0 };
+    bool isQueryPending[NUM_QUERY_FRAMES] = { false };
+    int frameIndex = 0;
+    int framesSinceAdjust = 0;
+    float gpuFrameTimeMs = 0.0f;
+    bool hasSample = false;
+};
+
+#endif // __DYNAMIC_RESOLUTION_H__
@@ -12,6 +12,7 @@ public:
     Fog(Context* context);
     void render();
     float fogDensity = 0.0f;
+    float fogDistance = 100.0f;  // view distance normalized to 1, about the far side of the terrain
     glm::vec3 fogColor = glm::vec3(0.5f, 0.5f, 0.5f);
     float fogHeight = 1.0f;
     bool isLayeredFog = false;
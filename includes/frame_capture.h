@@ -0,0 +1,53 @@
+#ifndef __FRAME_CAPTURE_H__
+#define __FRAME_CAPTURE_H__
+
+#include "common.h"
+#include "readback.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <cstdio>
+
+// Screenshot and video capture of the final image without stalling the pipeline.
+// Frames go through the PBO ring of AsyncReadback and are encoded on background threads. Videos are paced by
+// the frame times: rendered frames are skipped or repeated so the video plays at its frame rate.
+class FrameCapture {
+public:
+    enum class Format {
+        PNG_SEQUENCE,  // <path>_000000.png, <path>_000001.png, ...
+        Y4M,           // raw YUV 4:4:4 stream; "-" writes to stdout for piping into ffmpeg and co.
+    };
+
+    static std::unique_ptr<FrameCapture> create();
+    ~FrameCapture();
+    static void logToStderr();  // before writing a video to stdout
+    void requestScreenshot(const std::string& filePath);
+    bool startVideo(Format format, const std::string& path, int frameRate);
+    void stopVideo();
+    // reads the bound GL_READ_FRAMEBUFFER when a capture is pending; deltaTime: seconds since the last frame
+    void captureFrame(int width, int height, float deltaTime);
+    bool isRecordingVideo() const { return recordingVideo; }
+    int getNumVideoFrames() const { return numVideoFrames; }
+    int getNumDroppedFrames() const { return numDroppedFrames; }
+
+private:
+    FrameCapture() {};
+    void writeY4MFrame(const std::vector<uint8_t>& pixels, int width, int height, int numCopies);
+
+    std::unique_ptr<AsyncReadback> readback;
+    std::unique_ptr<ThreadPool> imageEncoder;  // screenshots and PNG sequences, order does not matter
+    std::unique_ptr<ThreadPool> videoEncoder;  // single thread so Y4M frames stay in order
+
+    std::string screenshotPath;
+    bool recordingVideo = false;
+    Format videoFormat = Format::PNG_SEQUENCE;
+    std::string videoPath;
+    int videoFrameRate = 60;
+    int videoWidth = 0;
+    int videoHeight = 0;
+    int numVideoFrames = 0;
+    double videoTime = 0.0;  // seconds since the first captured frame
+    std::atomic<int> numDroppedFrames = 0;
+    FILE* videoFile = nullptr;
+};
+
+#endif // __FRAME_CAPTURE_H__
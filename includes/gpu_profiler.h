@@ -0,0 +1,79 @@
+#ifndef __GPU_PROFILER_H__
+#define __GPU_PROFILER_H__
+
+#include "common.h"
+
+// Measures GPU time of render passes with GL_TIME_ELAPSED queries.
+// Queries are kept in a ring of NUM_QUERY_FRAMES frames and read back only when
+// their results are available, so profiling never stalls the pipeline.
+// Passes must not be nested since only one GL_TIME_ELAPSED query can be active.
+class GpuProfiler {
+public:
+    static std::unique_ptr<GpuProfiler> create();
+    ~GpuProfiler();
+    void beginFrame();
+    void endFrame();
+    void beginPass(const std::string& name);
+    void endPass();
+    void flush();
+    void setHistorySize(int size);
+    void renderGUI();
+    bool dumpCSV(const std::string& filePath) const;
+    float getAverage(const std::string& name) const;
+    float getPercentile(const std::string& name, float percentile) const;
+    std::vector<std::string> getPassNames() const;
+
+    bool enabled = true;
+
+private:
+    struct Sample {
+        int frame;
+        float timeMs;
+    };
+    struct PassHistory {
+        std::string name;
+        std::vector<Sample> samples;  // ring buffer of historySize samples
+        int next = 0;
+        int count = 0;
+    };
+    struct FrameQueries {
+        std::vector<unsigned int> queries;
+        std::vector<int> passIndices;
+        int numUsed = 0;
+        int frame = 0;
+        bool pending = false;
+    };
+
+    GpuProfiler() {};
+    void collectFrame(FrameQueries& frameQueries);
+    void addSample(int passIndex, int frame, float timeMs);
+    int findPass(const std::string& name) const;
+    std::vector<float> getSortedSamples(int passIndex) const;
+    static float getPercentileOfSorted(const std::vector<float>& values, float percentile);
+
+    static constexpr int NUM_QUERY_FRAMES = 3;
+    static constexpr int TOTAL_PASS_INDEX = 0;  // sum of all passes of a frame
+    FrameQueries frames[NUM_QUERY_FRAMES];
+    std::vector<PassHistory> passes;
+    int historySize = 240;
+    int frameIndex = 0;
+    bool isInFrame = false;
+    bool isPassActive = false;
+    int selectedPass = TOTAL_PASS_INDEX;
+    char csvPath[256] = "gpu_profile.csv";
+};
+
+// begins a pass on construction and ends it on destruction
+class GpuProfileScope {
+public:
+    GpuProfileScope(GpuProfiler* profiler, const std::string& name) : profiler(profiler) {
+        profiler->beginPass(name);
+    }
+    ~GpuProfileScope() {
+        profiler->endPass();
+    }
+private:
+    GpuProfiler* profiler;
+};
+
+#endif // __GPU_PROFILER_H__
@@ -0,0 +1,42 @@
+#ifndef __GPU_TERRAIN_GENERATOR_H__
+#define __GPU_TERRAIN_GENERATOR_H__
+
+#include "common.h"
+#include "shader.h"
+#include "terrain_generator.h"
+
+// Compute-shader version of TerrainGenerator (GL 4.3+), same noise and parameters.
+// One command stream writes the fractal heights, reduces them into a min/max pyramid, normalizes them into
+// the height map with the diffuse ramp, and derives the gradient map and the per-patch height bounds of
+// the culler, so parameter sweeps never transfer the terrain between the CPU and the GPU.
+class GpuTerrainGenerator {
+public:
+    static std::unique_ptr<GpuTerrainGenerator> create();  // nullptr if compute shaders are not available
+    ~GpuTerrainGenerator();
+
+    // heightMap R32F, diffuseMap RGBA8 and gradientMap RG16F, all generator.resolution texels per side;
+    // patchBounds is a buffer of gridSize^2 vec2 indexed like the instanced grid, 0 skips the bounds
+    void generate(const TerrainGenerator& generator, unsigned int heightMap, unsigned int diffuseMap,
+        unsigned int gradientMap, unsigned int patchBounds, int gridSize);
+    float getGenerationTime();  // ms on the GPU of the last generation whose timer is available
+
+private:
+    GpuTerrainGenerator() {};
+    bool init();
+    void resize(int size);
+
+    std::unique_ptr<Shader> noiseShader;
+    std::unique_ptr<Shader> minMaxShader;
+    std::unique_ptr<Shader> finalizeShader;
+    std::unique_ptr<Shader> gradientShader;
+    std::unique_ptr<Shader> boundsShader;
+    unsigned int rawHeights = 0;  // R32F fractal values before normalization
+    unsigned int minMaxPyramid = 0;  // RG32F, level 0 at half the resolution, the last level 1x1
+    int size = 0;
+    int numLevels = 0;
+    unsigned int timerQuery = 0;
+    bool timerPending = false;
+    float generationTime = 0.0f;
+};
+
+#endif // __GPU_TERRAIN_GENERATOR_H__
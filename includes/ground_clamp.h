@@ -0,0 +1,47 @@
+#ifndef __GROUND_CLAMP_H__
+#define __GROUND_CLAMP_H__
+
+#include "common.h"
+#include "camera.h"
+#include "heightfield.h"
+
+// Keeps the camera above the terrain. The heights around the camera are copied into a small patch
+// that is only refreshed when the camera gets close to its border or the height data changes, so
+// the per-frame cost does not depend on the terrain size.
+// The ground height under the camera is low-pass filtered so bumps do not shake the view at high
+// movement speeds; it rises faster than it falls, and the camera never drops below the unfiltered ground.
+class GroundClamp {
+public:
+    static std::unique_ptr<GroundClamp> create();
+    void apply(Camera* camera, const Heightfield* heightfield, float deltaTime);
+    void invalidate() { patchRevision = 0; }
+
+    bool hasGround() const { return groundValid; }
+    float getGroundHeight() const { return smoothedGround; }  // filtered, world units
+    int getNumRefreshes() const { return numRefreshes; }
+
+    bool enabled = false;         // push the camera up when it gets closer than the clearance
+    bool followTerrain = false;   // hold the camera at the clearance, also when the ground falls away
+    float clearance = 1.0f;       // world units above the ground
+    float smoothing = 8.0f;       // 1/s, how quickly the filtered ground follows the terrain
+
+private:
+    GroundClamp() {};
+    bool isInPatch(int x, int y) const;
+    void refreshPatch(const Heightfield* heightfield, int x, int y);
+    float samplePatch(float x, float y) const;  // bilinear at heightfield texel coordinates
+
+    static constexpr int PATCH_SIZE = 32;    // texels per side
+    static constexpr int PATCH_MARGIN = 4;   // refresh when the camera gets this close to the border
+    std::vector<float> patch;                // raw samples, row-major
+    glm::ivec2 patchOrigin = glm::ivec2(0);  // heightfield texel of patch[0]
+    glm::ivec2 patchSize = glm::ivec2(0);    // smaller than PATCH_SIZE on small terrains
+    glm::ivec2 terrainSize = glm::ivec2(0);
+    uint64_t patchRevision = 0;              // heightfield revision the patch was copied from
+    int numRefreshes = 0;
+
+    bool groundValid = false;
+    float smoothedGround = 0.0f;
+};
+
+#endif // __GROUND_CLAMP_H__
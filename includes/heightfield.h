@@ -0,0 +1,62 @@
+#ifndef __HEIGHTFIELD_H__
+#define __HEIGHTFIELD_H__
+
+#include "common.h"
+
+struct TexelRegion {  // texels [x0, x1) x [y0, y1) of a height map
+    int x0, y0, x1, y1;
+};
+
+// CPU copy of the terrain height map for ground queries (camera clamping, placement, analytics).
+// Samples are stored in 8x8 tiles, so a bilinear footprint and spatially close queries touch few
+// cache lines. World-space queries use the transform of Terrain::render: the map is centered on the
+// origin and spans horizontalScale along x and z, and a sample h is at height h * heightScale + heightOffset.
+// Sampling matches the terrain shaders: bilinear, clamped to the outermost texel centers.
+class Heightfield {
+public:
+    static std::unique_ptr<Heightfield> create(const std::vector<float>& samples, int width, int height);
+    void setTransform(float horizontalScale, float heightScale, float heightOffset);
+    // copies the region's samples of a row-major grid of the same size, for in-place edits
+    void update(const std::vector<float>& samples, const TexelRegion& region);
+
+    float getNormalizedHeight(float u, float v) const;  // raw sample in [0, 1], texture coordinates
+    float getHeight(float x, float z) const;
+    glm::vec3 getNormal(float x, float z) const;
+    // batched queries on x/z arrays, four points per SIMD step
+    void getHeights(const float* x, const float* z, float* heights, size_t count) const;
+    void getNormals(const float* x, const float* z, glm::vec3* normals, size_t count) const;
+
+    bool contains(float x, float z) const;
+    float getSample(int x, int y) const { return samples[index(x, y)]; }  // raw, texel (x, y)
+    uint64_t getRevision() const { return revision; }  // unique per height data and edit, lets caches detect changes
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    float getHorizontalScale() const { return horizontalScale; }
+    float getHeightScale() const { return heightScale; }
+    float getHeightOffset() const { return heightOffset; }
+
+private:
+    Heightfield() {};
+    static uint64_t nextRevision();
+    size_t index(int x, int y) const;
+    float sampleTexels(float x, float y) const;  // bilinear at continuous texel coordinates
+    void getHeights4(const float* x, const float* z, float* heights) const;
+
+    static constexpr int TILE_SHIFT = 3;  // 8x8 samples, 256 bytes per tile
+    static constexpr int TILE_SIZE = 1 << TILE_SHIFT;
+    std::vector<float> samples;  // tiled
+    int width = 0;
+    int height = 0;
+    int numTilesX = 0;
+    float horizontalScale = 1.0f;
+    float heightScale = 1.0f;
+    float heightOffset = 0.0f;
+    uint64_t revision = 0;
+};
+
+inline size_t Heightfield::index(int x, int y) const {
+    size_t tile = (size_t)(y >> TILE_SHIFT) * numTilesX + (x >> TILE_SHIFT);
+    return (tile << (2 * TILE_SHIFT)) + ((y & (TILE_SIZE - 1)) << TILE_SHIFT) + (x & (TILE_SIZE - 1));
+}
+
+#endif // __HEIGHTFIELD_H__
@@ -0,0 +1,47 @@
+#ifndef __HIZ_BUFFER_H__
+#define __HIZ_BUFFER_H__
+
+#include "common.h"
+#include "shader.h"
+#include "framebuffer.h"
+
+// Farthest-depth mip pyramid of the scene depth, rebuilt every frame after the fog scene pass.
+// A texel of level n holds the farthest depth of its footprint in level 0 (the maximum, or the
+// minimum with reverse-Z), so anything whose nearest depth lies behind it was hidden in that frame.
+// Consumers read it one frame late and have to project with getViewProjection(), the camera the
+// depth was rendered with.
+class HiZBuffer {
+public:
+    static std::unique_ptr<HiZBuffer> create();
+    ~HiZBuffer();
+    void build(const Framebuffer* sceneBuffer, const glm::mat4& viewProjection, bool reverseZ);
+    void invalidate() { valid = false; }
+
+    bool isValid() const { return valid; }
+    unsigned int getTexture() const { return texture; }  // R32F, full mip chain
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getNumLevels() const { return numLevels; }
+    const glm::mat4& getViewProjection() const { return viewProjection; }
+    bool isReverseZ() const { return reverseZ; }  // depth in [0, 1] from a [0, 1] clip range, far is 0
+
+    bool enabled = true;
+
+private:
+    HiZBuffer() {};
+    void init();
+    void resize(int width, int height);
+
+    std::unique_ptr<Shader> shader;
+    unsigned int FBO = 0;
+    unsigned int texture = 0;
+    unsigned int screenQuadVAO = 0;
+    int width = 0;
+    int height = 0;
+    int numLevels = 0;
+    bool valid = false;
+    bool reverseZ = false;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+};
+
+#endif // __HIZ_BUFFER_H__
@@ -0,0 +1,38 @@
+#ifndef __HORIZON_CULLER_H__
+#define __HORIZON_CULLER_H__
+
+#include "common.h"
+
+// CPU occlusion culling of height field chunks with an occlusion horizon.
+// Chunks are visited front to back. A chunk whose projected top lies below the horizon, the highest
+// solid terrain seen so far in every screen column it covers, is hidden. Each visible chunk then raises
+// the horizon to the projection of its minimum height, below which a height field is solid.
+// This assumes a roll-free camera above the terrain, like the fly camera outside of the water reflection.
+class HorizonCuller {
+public:
+    struct Chunk {
+        glm::vec3 boundsMin;  // world space
+        glm::vec3 boundsMax;
+    };
+
+    static std::unique_ptr<HorizonCuller> create(int numColumns = 512);
+    // visible chunk indices in front-to-back order; useHorizon = false only tests the frustum
+    void cull(const std::vector<Chunk>& chunks, const glm::mat4& viewProjection, const glm::vec3& cameraPosition,
+        bool useHorizon, std::vector<unsigned int>& visibleChunks);
+
+    int getNumFrustumCulled() const { return numFrustumCulled; }
+    int getNumHorizonCulled() const { return numHorizonCulled; }
+
+private:
+    HorizonCuller() {};
+    bool _isBelowHorizon(int begin, int end, float top) const;
+    void _raiseHorizon(int begin, int end, float height);
+
+    int numColumns = 0;
+    std::vector<float> horizon;  // NDC y per screen column
+    std::vector<std::pair<float, unsigned int>> order;
+    int numFrustumCulled = 0;
+    int numHorizonCulled = 0;
+};
+
+#endif // __HORIZON_CULLER_H__
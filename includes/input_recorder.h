@@ -0,0 +1,122 @@
+#ifndef __INPUT_RECORDER_H__
+#define __INPUT_RECORDER_H__
+
+#include "common.h"
+#include <chrono>
+#include <functional>
+
+// Records input events, frame times and GUI parameter changes into a compact binary
+// file, and feeds them back frame by frame so a captured session renders identically.
+//
+// Stream layout: the initial state at the start of the recording, then per frame the mouse
+// events received while polling, a FRAME record with the delta time and the held camera
+// keys, then the parameters changed by the GUI.
+class InputRecorder {
+public:
+    enum class ParameterType : uint8_t {
+        FLOAT,
+        INT,
+        BOOL,
+        VEC3,
+        STRING,  // length-prefixed, e.g. names whose index depends on the files present
+    };
+    enum class PlaybackSpeed {
+        REALTIME,  // wait for the recorded frame times
+        MAXIMUM,   // render frames as fast as possible
+    };
+    struct MouseEvent {
+        bool isButton;
+        int button;
+        int action;
+        float x;
+        float y;
+        bool capturedByGui;  // buttons: the click went to the GUI, not to the scene
+    };
+    struct Frame {
+        float deltaTime;
+        unsigned int keyMask;
+        std::vector<MouseEvent> mouseEvents;
+    };
+
+    static std::unique_ptr<InputRecorder> create();
+    ~InputRecorder();
+    void trackParameter(const std::string& name, float* value, std::function<void()> onReplay = nullptr);
+    void trackParameter(const std::string& name, int* value, std::function<void()> onReplay = nullptr);
+    void trackParameter(const std::string& name, bool* value, std::function<void()> onReplay = nullptr);
+    void trackParameter(const std::string& name, glm::vec3* value, std::function<void()> onReplay = nullptr);
+    void trackParameter(const std::string& name, std::string* value, std::function<void()> onReplay = nullptr);
+    // state that evolves from the recorded input (e.g. the camera pose) is only captured once at the start
+    void trackInitialState(const std::string& name, float* value, std::function<void()> onReplay = nullptr);
+    void trackInitialState(const std::string& name, bool* value, std::function<void()> onReplay = nullptr);
+    void trackInitialState(const std::string& name, glm::vec3* value, std::function<void()> onReplay = nullptr);
+
+    bool startRecording(const std::string& filePath);
+    void stopRecording();
+    void recordMouseMove(float x, float y);
+    void recordMouseButton(int button, int action, float x, float y, bool capturedByGui);
+    void recordFrame(float deltaTime, unsigned int keyMask);
+    void recordParameterChanges();
+
+    bool startReplay(const std::string& filePath, PlaybackSpeed speed);
+    void stopReplay();
+    bool replayFrame(Frame& frame);  // returns false once the recording is exhausted
+    void replayParameterChanges();
+
+    bool isRecording() const { return recording; }
+    bool isReplaying() const { return replaying; }
+    int getNumRecordedFrames() const { return numFrames; }
+    int getReplayFrameIndex() const { return replayFrameIndex; }
+    int getNumReplayFrames() const { return numReplayFrames; }
+
+private:
+    enum Tag : uint8_t {
+        TAG_FRAME = 1,
+        TAG_MOUSE_MOVE = 2,
+        TAG_MOUSE_BUTTON = 3,
+        TAG_PARAMETER = 4,
+        TAG_END = 0xFF,
+    };
+    struct Parameter {
+        std::string name;
+        ParameterType type;
+        void* value;
+        std::function<void()> onReplay;
+        bool initialOnly;
+        uint8_t lastValue[12];
+        std::string lastString;     // the last value of a STRING
+        bool hasLastValue = false;  // false records the next value even if unchanged
+    };
+
+    InputRecorder() {};
+    void addParameter(const std::string& name, ParameterType type, void* value, std::function<void()> onReplay, bool initialOnly = false);
+    static int getValueSize(ParameterType type);
+    bool updateLastValue(Parameter& parameter);  // returns whether the value changed since the last call
+    void writeValue(const Parameter& parameter);
+    template <typename T> void write(const T& value);
+    template <typename T> bool read(T& value);
+    bool readBytes(void* data, size_t size);
+    void flushRecording();
+
+    std::vector<Parameter> parameters;
+
+    // recording
+    bool recording = false;
+    std::string recordingPath;
+    std::vector<uint8_t> recordBuffer;
+    int numFrames = 0;
+
+    // replay
+    bool replaying = false;
+    PlaybackSpeed playbackSpeed = PlaybackSpeed::REALTIME;
+    std::vector<uint8_t> replayBuffer;
+    size_t replayOffset = 0;
+    uint32_t replayVersion = 0;
+    std::vector<int> replayParameterIndices;  // recorded parameter id -> index in parameters, -1 if unknown
+    std::vector<ParameterType> replayParameterTypes;
+    int replayFrameIndex = 0;
+    int numReplayFrames = 0;
+    double replayTime = 0.0;
+    std::chrono::steady_clock::time_point replayStart;
+};
+
+#endif // __INPUT_RECORDER_H__
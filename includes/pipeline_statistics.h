@@ -0,0 +1,74 @@
+#ifndef __PIPELINE_STATISTICS_H__
+#define __PIPELINE_STATISTICS_H__
+
+#include "common.h"
+
+// Counts the work done by the terrain draws of each render pass.
+// GL_PRIMITIVES_GENERATED is always available; the remaining counters need
+// ARB_pipeline_statistics_query (core in GL 4.6). Results are read back with a
+// delay of NUM_QUERY_FRAMES frames and only once available, so nothing stalls.
+class PipelineStatistics {
+public:
+    enum Counter {
+        PRIMITIVES_GENERATED,       // primitives emitted by the last vertex processing stage (tessellated triangles)
+        PATCHES_SUBMITTED,
+        TESS_CONTROL_PATCHES,
+        TESS_EVALUATION_INVOCATIONS,
+        GEOMETRY_SHADER_INVOCATIONS,
+        GEOMETRY_SHADER_PRIMITIVES,
+        CLIPPING_INPUT_PRIMITIVES,
+        CLIPPING_OUTPUT_PRIMITIVES,
+        FRAGMENT_SHADER_INVOCATIONS,
+        NUM_COUNTERS
+    };
+    struct Counters {
+        GLuint64 values[NUM_COUNTERS] = { 0 };
+    };
+
+    static std::unique_ptr<PipelineStatistics> create();
+    ~PipelineStatistics();
+    void beginFrame();
+    void endFrame();
+    void beginQuery(const std::string& passName);
+    void endQuery();
+    void renderGUI();
+    bool getCounters(const std::string& passName, Counters& counters) const;
+    bool hasPipelineStatistics() const { return isPipelineStatisticsSupported; }
+
+    bool enabled = true;
+
+private:
+    struct PassCounters {
+        std::string name;
+        Counters latest;
+        Counters baseline;
+        bool hasLatest = false;
+        bool hasBaseline = false;
+    };
+    struct PassQueries {
+        int passIndex;
+        unsigned int queries[NUM_COUNTERS];
+    };
+    struct FrameQueries {
+        std::vector<PassQueries> passQueries;
+        int numUsed = 0;
+        bool pending = false;
+    };
+
+    PipelineStatistics() {};
+    void init();
+    void collectFrame(FrameQueries& frameQueries);
+    int findPass(const std::string& name) const;
+    bool isCounterSupported(int counter) const;
+
+    static constexpr int NUM_QUERY_FRAMES = 3;
+    static const GLenum QUERY_TARGETS[NUM_COUNTERS];
+    FrameQueries frames[NUM_QUERY_FRAMES];
+    std::vector<PassCounters> passes;
+    int frameIndex = 0;
+    bool isInFrame = false;
+    bool isQueryActive = false;
+    bool isPipelineStatisticsSupported = false;
+};
+
+#endif // __PIPELINE_STATISTICS_H__
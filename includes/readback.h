@@ -0,0 +1,43 @@
+#ifndef __READBACK_H__
+#define __READBACK_H__
+
+#include "common.h"
+#include <functional>
+
+// Asynchronous framebuffer readback through a ring of pixel buffer objects.
+// glReadPixels into a PBO only queues a copy; each slot is mapped once its fence
+// has signaled, usually a couple of frames later, so the CPU never waits on the GPU.
+class AsyncReadback {
+public:
+    // pixels are tightly packed RGB8 rows, bottom row first (OpenGL order)
+    using Callback = std::function<void(std::vector<uint8_t>&& pixels, int width, int height)>;
+
+    static std::unique_ptr<AsyncReadback> create(int numBuffers = 3);
+    ~AsyncReadback();
+    void request(int width, int height, Callback callback);  // reads from the bound GL_READ_FRAMEBUFFER
+    int poll();   // completes the finished readbacks in order, returns how many
+    void flush(); // blocks until every pending readback has completed
+    int getNumPending() const { return numPending; }
+
+private:
+    struct Slot {
+        unsigned int PBO = 0;
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+        int width = 0;
+        int height = 0;
+        Callback callback;
+    };
+
+    AsyncReadback() {};
+    bool complete(Slot& slot, bool wait);
+
+    std::vector<Slot> slots;
+    int nextSlot = 0;
+    int numPending = 0;
+};
+
+// writes readback pixels (RGB8, bottom row first) as a top-down PNG; safe to call from worker threads
+bool writeReadbackPNG(const std::string& filePath, const std::vector<uint8_t>& pixels, int width, int height);
+
+#endif // __READBACK_H__
@@ -14,6 +14,7 @@ public:
     unsigned int ID;
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
         const char* tcsPath = nullptr, const char* tesPath = nullptr);
+    explicit Shader(const char* computePath);  // compute program, needs a GL 4.3 context
 
     void use();
     void bindTexture(const std::string& name, const Texture* texture, int unit = 0);
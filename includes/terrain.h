@@ -4,6 +4,17 @@
 #include "common.h"
 #include "shader.h"
 #include "texture.h"
+#include "terrain_culler.h"
+#include "horizon_culler.h"
+#include "heightfield.h"
+#include "terrain_raycaster.h"
+#include "viewshed.h"
+#include "terrain_generator.h"
+#include "gpu_terrain_generator.h"
+#include "terrain_erosion.h"
+#include "terrain_sculptor.h"
+#include "terrain_history.h"
+#include "terrain_exporter.h"
 
 class Context;  // forward declaration
 
@@ -12,7 +23,37 @@ public:
     static std::unique_ptr<Terrain> createWithTessellation(Context* context);
     static std::unique_ptr<Terrain> createWithoutTessellation(Context* context);
     void render();
-    void resetTerrain(const std::string& terrainDir);
+    void resetTerrain(const std::string& terrainDir);  // PROCEDURAL_TERRAIN runs the generator
+    bool isGpuCullingSupported() const { return culler != nullptr; }
+    const HorizonCuller* getHorizonCuller() const { return horizonCuller.get(); }
+    int getNumPatches() const { return numStrips * numStrips; }
+    const Heightfield* getHeightfield() const { return heightfield.get(); }  // null if the height map could not be read
+    const TerrainRaycaster* getRaycaster() const { return raycaster.get(); }  // null with the heightfield
+    void updateTransform();  // hands the scales to the heightfield, call after changing them
+    Viewshed* getViewshed() { return viewshed.get(); }
+    void updateViewshed(const glm::vec2& observer);  // world (x, z), recomputes only when needed
+    TerrainGenerator* getGenerator() { return generator.get(); }
+    bool isGpuGeneratorSupported() const { return gpuGenerator != nullptr; }
+    float getGpuGenerationTime() { return gpuGenerator ? gpuGenerator->getGenerationTime() : 0.0f; }
+    bool isGeneratedOnGpu() const { return generatedOnGpu; }
+    void syncGeneratedHeights();  // CPU copy of GPU-generated heights, once the GPU has written them
+    // largest difference between the GPU-generated terrain and the CPU generator, negative if not on the GPU
+    float measureGeneratorParity();
+    TerrainErosion* getErosion() { return erosion.get(); }
+    void updateErosion();  // a few erosion iterations while running, uploads the changed tiles
+    TerrainSculptor* getSculptor() { return sculptor.get(); }
+    // one brush stamp at a world position on the terrain; updates only the touched part of the terrain's data
+    bool sculpt(const glm::vec3& position, float deltaTime, bool beginStroke);
+    void endSculptStroke();  // the stroke becomes one undo step
+    TerrainHistory* getHistory() { return history.get(); }
+    bool undoEdit();  // strokes and erosion runs, newest first
+    bool redoEdit();
+    TerrainExporter* getExporter() { return exporter.get(); }
+    // writes the current heights and diffuse map to assets/Terrain/<name>/converted in the background;
+    // name is a single directory name other than PROCEDURAL_TERRAIN
+    bool exportTerrain(const std::string& name);
+
+    static constexpr const char* PROCEDURAL_TERRAIN = "Procedural";
 
     const std::string initTerrain = "Rolling Hills Height Map 1k";
     float heightScale = 9.0f;
@@ -27,19 +68,85 @@ public:
     bool showNormals = false;
     bool useLighting = false;
     float ambientStrength = 0.7f;
+    bool useInstancedGrid = true;  // derive patch corners from gl_InstanceID instead of a vertex buffer
+    bool useGpuCulling = true;     // frustum/occlusion test per patch in a compute pass, instanced grid only
+    bool useOcclusionCulling = true;
+    bool useHorizonCulling = true; // CPU frustum/horizon test per patch when GPU culling is not active
+    bool showViewshed = false;     // tint the ground by visibility from the viewshed observer
+    bool useGpuGenerator = false;  // procedural terrain from compute passes, when supported
 
 private:
     Terrain(Context* context) : context(context) {};
     void init();
+    bool loadHeights(const std::string& filePath);
+    void generateTerrain();
+    void generateTerrainOnGpu();
+    void requestHeightsReadback();
+    bool readBackHeights(bool wait);  // false while the GPU is still writing them, or on failure
+    void uploadGradientMap(int width, int height, const float* gradients);  // RG16F, kept while the size matches
+    void computeGradientMap();
+    void computeGradients(int x0, int y0, int x1, int y1, std::vector<float>& gradients);  // region, row-major RG
+    void syncErodedHeights();
+    void buildSkirt();
+    void buildPatchBuffer();
+    void releasePatchBuffer();
+    void computePatchBounds();
+    glm::ivec4 computePatchBounds(const TexelRegion& region);  // patches over the region, returns their i/j range
+    void useFloatHeightMap();
+    void uploadHeightRegion(const TexelRegion& region);  // height map, gradients and patch bounds
+    void applyHeightEdits(const std::vector<TexelRegion>& regions);  // refreshes everything that reads the heights
+    bool isGpuCullingActive() const;
+    bool isCpuCullingActive() const;
+    void cullPatchesOnCPU(const glm::mat4& model, const glm::mat4& viewProjection);
+    void drawPatches(bool useCulledPatches);
 
     Context* context;
     std::unique_ptr<Shader> shader;
+    std::unique_ptr<Shader> skirtShader;
     std::unique_ptr<Shader> normalShader;
+    std::unique_ptr<TerrainCuller> culler;  // null below GL 4.3
+    std::unique_ptr<HorizonCuller> horizonCuller;
+    std::unique_ptr<Heightfield> heightfield;  // CPU copy of the height map for ground queries
+    std::unique_ptr<TerrainRaycaster> raycaster;  // over heightfield
+    std::unique_ptr<Viewshed> viewshed;
+    std::unique_ptr<TerrainGenerator> generator;
+    std::unique_ptr<GpuTerrainGenerator> gpuGenerator;  // null below GL 4.3
+    std::unique_ptr<TerrainErosion> erosion;
+    std::vector<TexelRegion> erosionRegions;
+    std::unique_ptr<TerrainSculptor> sculptor;
+    std::unique_ptr<TerrainHistory> history;
+    std::vector<TexelRegion> historyRegions;
+    bool isRecordingErosion = false;  // an erosion run is recorded as one step, ended when it pauses
+    std::unique_ptr<TerrainExporter> exporter;
+    std::string terrainName;  // of the last reset
+    std::vector<float> regionGradients;
+    int erodedFrames = 0;  // eroded frames since the heightfield, raycaster and skirt were rebuilt
+    static constexpr int ERODED_FRAMES_PER_SYNC = 30;
     std::unique_ptr<Texture> heightMap;
     std::unique_ptr<Texture> diffuseMap;
-    unsigned int VAO = 0;
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
+    unsigned int gradientMap = 0;  // RG16F Sobel height gradient per texel, normals are rebuilt from it in the TES
+    int gradientMapWidth = 0;
+    int gradientMapHeight = 0;
+    std::vector<float> heights;    // height map in [0, 1], same orientation as the texture
+    std::vector<unsigned char> generatedColors;  // RGB diffuse map of the procedural terrain
+    int heightsWidth = 0;
+    int heightsHeight = 0;
+    bool generatedOnGpu = false;
+    bool heightsPendingReadback = false;  // heights, heightfield and bounds still have to follow the GPU
+    unsigned int heightsReadbackPBO = 0;  // GPU-generated heights on their way to the CPU
+    GLsync heightsReadbackFence = nullptr;
+    std::vector<glm::vec2> patchHeightRanges;  // min/max of heights per patch of the instanced grid
+    std::vector<HorizonCuller::Chunk> patchChunks;
+    std::vector<unsigned int> cpuVisiblePatches;
+    unsigned int cpuCulledVAO = 0;  // cpuVisiblePatches as a per-instance attribute
+    unsigned int cpuCulledVBO = 0;
+    unsigned int gridVAO = 0;    // empty VAO for the instanced grid
+    unsigned int VAO = 0;        // per-vertex grid, only while useInstancedGrid is off
+    int patchBufferStrips = 0;
+    unsigned int skirtVAO = 0;   // ground walls along the border and the bottom plane
+    unsigned int skirtVBO = 0;
+    unsigned int skirtEBO = 0;
+    int numSkirtIndices = 0;
 };
 
 #endif  // __TERRAIN_H__
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef __TERRAIN_CULLER_H__
+#define __TERRAIN_CULLER_H__
+
+#include "common.h"
+#include "shader.h"
+#include "hiz_buffer.h"
+
+// GPU-driven culling of the instanced terrain grid (GL 4.3+).
+// A compute pass tests every patch against the frustum and, for the main camera pass, against the
+// Hi-Z pyramid of the previous frame's depth. Survivors are appended to a buffer that feeds the patch index
+// of each instance, and the draw is issued with glDrawArraysIndirect using the GPU-written instance count.
+class TerrainCuller {
+public:
+    static std::unique_ptr<TerrainCuller> create();  // nullptr if compute shaders are not available
+    ~TerrainCuller();
+
+    // per-patch height range in [0, 1], indexed like gl_InstanceID of the instanced grid
+    void updatePatchBounds(const std::vector<glm::vec2>& patchHeightRanges, int gridSize);
+    void updatePatchBounds(const std::vector<glm::vec2>& patchHeightRanges, size_t first, size_t count);  // same grid
+    // hiZ is optional, null skips the occlusion test
+    void cull(const glm::mat4& model, const glm::mat4& viewProjection, glm::vec2 terrainSize,
+        float heightScale, float heightOffset, const HiZBuffer* hiZ);
+    void draw();
+
+    int getGridSize() const { return gridSize; }
+    unsigned int getBoundsBuffer() const { return boundsBuffer; }  // for bounds written on the GPU
+
+private:
+    TerrainCuller() {};
+    bool init();
+
+    std::unique_ptr<Shader> cullShader;
+    unsigned int boundsBuffer = 0;   // vec2 min/max height per patch
+    unsigned int visibleBuffer = 0;  // uint patch index per surviving instance
+    unsigned int commandBuffer = 0;  // DrawArraysIndirectCommand
+    unsigned int VAO = 0;            // visible patch indices as a per-instance attribute
+    int gridSize = 0;
+};
+
+#endif  // __TERRAIN_CULLER_H__
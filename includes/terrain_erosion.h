@@ -0,0 +1,69 @@
+#ifndef __TERRAIN_EROSION_H__
+#define __TERRAIN_EROSION_H__
+
+#include "common.h"
+#include "heightfield.h"
+
+class ThreadPool;  // forward declaration
+
+// Grid-based erosion of the height map: hydraulic erosion with virtual pipes (water, sediment, outflow flux and
+// velocity per texel, after Mei et al. 2007) followed by thermal relaxation of slopes steeper than the talus angle.
+// The map is processed in 64x64 tiles that fit in the L2 cache: every tile copies its texels plus a halo of the
+// neighbouring tiles' state, runs all stages of one iteration locally and writes its interior to the other half
+// of the double-buffered state, so the tiles are independent and the result does not depend on the thread count.
+// Heights are simulated in texel units, so slopes and the talus angle are those of the rendered terrain.
+class TerrainErosion {
+public:
+    static std::unique_ptr<TerrainErosion> create();
+    // starts from normalized heights; relief is the height of 1.0 in texels (heightScale / world size of a texel)
+    void reset(const std::vector<float>& heights, int width, int height, float relief);
+    void invalidate() { ready = false; }  // the next run starts again from the terrain's heights, without water
+    bool isReady() const { return ready; }
+    void step(ThreadPool* threadPool, int numIterations);
+    // returns the tiles changed since the last call as row runs
+    void collectDirtyRegions(std::vector<TexelRegion>& regions);
+    // copies the normalized heights of the regions from the simulation
+    void copyHeights(ThreadPool* threadPool, const std::vector<TexelRegion>& regions, std::vector<float>& heights) const;
+    int getIteration() const { return iteration; }
+    float getStepTime() const { return stepTime; }  // ms of the last step
+
+    bool running = false;
+    int iterationsPerFrame = 4;
+    bool hydraulic = true;
+    bool thermal = true;
+    float timeStep = 0.02f;           // s per iteration; the pipe model is stable while timeStep * g stays small
+    float rainRate = 0.01f;           // texels of water per second on every texel
+    float evaporation = 0.02f;        // fraction of the water per second
+    float sedimentCapacity = 1.0f;    // sediment carried per unit of water speed and slope
+    float dissolving = 15.0f;         // fraction of the missing capacity picked up per second, at most all of it per iteration
+    float deposition = 15.0f;         // fraction of the excess sediment dropped per second, at most all of it per iteration
+    float minTilt = 0.05f;            // keeps flat water eroding a little
+    float maxErosionDepth = 1.0f;     // texels of water above which the capacity stops growing
+    float talusAngle = 35.0f;         // degrees
+    float thermalRate = 0.5f;         // fraction of the excess slope relaxed per iteration
+
+private:
+    TerrainErosion() {};
+    void stepTiles(int tileBegin, int tileEnd);
+
+    // double-buffered state, row-major; flux is the outflow towards -x, +x, -y, +y
+    struct State {
+        std::vector<float> terrain;
+        std::vector<float> water;
+        std::vector<float> sediment;
+        std::vector<float> flux[4];
+    };
+    State states[2];
+    int current = 0;
+    std::vector<unsigned char> dirtyTiles;  // changed heights since the last collectDirtyRegions
+    int width = 0;
+    int height = 0;
+    int numTilesX = 0;
+    int numTilesY = 0;
+    float relief = 1.0f;
+    int iteration = 0;
+    float stepTime = 0.0f;
+    bool ready = false;
+};
+
+#endif // __TERRAIN_EROSION_H__
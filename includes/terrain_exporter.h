@@ -0,0 +1,43 @@
+#ifndef __TERRAIN_EXPORTER_H__
+#define __TERRAIN_EXPORTER_H__
+
+#include "common.h"
+#include "thread_pool.h"
+#include <atomic>
+
+// Writes a terrain in the layout of assets/Terrain/<name>/converted: a 16-bit grayscale "Height Map.png" and an
+// RGB "Diffuse Map.png". The export runs on a background thread from snapshots taken by the caller; the PNGs
+// are streamed in bands of rows that are filtered and deflated in parallel and written in order, so only a
+// few bands are held beside the snapshots whatever the map size.
+class TerrainExporter {
+public:
+    struct Job {
+        std::string directory;
+        int width = 0;
+        int height = 0;
+        std::vector<uint16_t> heights;  // normalized heights in 1/65535 units, rows in texture order (bottom first)
+        std::vector<uint8_t> colors;    // diffuse texels, rows in texture order; empty to copy diffuseSource
+        int colorChannels = 3;          // 3 or 4, alpha is dropped
+        std::string diffuseSource;      // image file copied as the diffuse map when there are no colors
+    };
+
+    static std::unique_ptr<TerrainExporter> create();
+    ~TerrainExporter();
+    bool start(Job&& job);  // false while an export is running
+    bool isExporting() const { return exporting; }
+    float getProgress() const;  // [0, 1] of the rows of the running export
+    const std::string& getDirectory() const { return directory; }
+
+private:
+    TerrainExporter() {};
+    void run(const Job& job);
+
+    std::unique_ptr<ThreadPool> writer;    // single thread, runs the export and writes the files
+    std::unique_ptr<ThreadPool> encoders;  // filter and deflate bands of rows
+    std::atomic<bool> exporting = false;
+    std::atomic<int> rowsWritten = 0;
+    int totalRows = 0;
+    std::string directory;
+};
+
+#endif // __TERRAIN_EXPORTER_H__
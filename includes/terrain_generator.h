@@ -0,0 +1,37 @@
+#ifndef __TERRAIN_GENERATOR_H__
+#define __TERRAIN_GENERATOR_H__
+
+#include "common.h"
+
+class ThreadPool;  // forward declaration
+
+// Procedural height map: fractal gradient noise (fBm or ridged multifractal) and a diffuse color ramp
+// by height and slope. The noise hashes the lattice corners instead of reading a permutation table,
+// so it evaluates eight points per SIMD step without gathers; rows are split across the thread pool.
+class TerrainGenerator {
+public:
+    enum NoiseType { FBM = 0, RIDGED = 1 };
+    static constexpr int MAX_OCTAVES = 16;
+
+    static std::unique_ptr<TerrainGenerator> create();
+    // heights normalized to [0, 1] and RGB colors, row-major in the orientation of the height map texture
+    void generate(ThreadPool* threadPool, std::vector<float>& heights, std::vector<unsigned char>& colors);
+    float evaluate(float u, float v) const;  // fractal value at texture coordinates, before normalization
+    void clampParameters();  // into the ranges both generator paths support
+    float getGenerationTime() const { return generationTime; }  // ms, heights and colors
+
+    int resolution = 2048;  // texels per side
+    int noiseType = FBM;
+    int seed = 1337;
+    int octaves = 8;
+    float frequency = 3.0f;  // noise periods across the map at the first octave
+    float lacunarity = 2.0f;
+    float gain = 0.5f;
+    float slopeRock = 0.6f;  // how strongly steep ground is colored as rock
+
+private:
+    TerrainGenerator() {};
+    float generationTime = 0.0f;
+};
+
+#endif // __TERRAIN_GENERATOR_H__
@@ -0,0 +1,72 @@
+#ifndef __TERRAIN_HISTORY_H__
+#define __TERRAIN_HISTORY_H__
+
+#include "common.h"
+#include "heightfield.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+
+// Undo/redo of height edits as per-tile deltas. An edit records the 64x64 tiles it is about to change; when it
+// ends, every touched tile keeps the XOR of its height bits before and after, zero wherever the edit did not
+// reach. XOR is its own inverse, so the same delta undoes and redoes the step.
+// A background thread splits the deltas into byte planes and LZ-compresses them; once the history exceeds the
+// memory budget, the oldest steps are moved to a spill file and read back when they are undone.
+class TerrainHistory {
+public:
+    static std::unique_ptr<TerrainHistory> create();
+    ~TerrainHistory();
+    void clear();  // the height data was replaced
+    // copies the tiles over the region that the current edit has not recorded yet; call before changing them
+    void recordBefore(const std::vector<float>& heights, int width, int height, const TexelRegion& region);
+    void endEdit(const std::vector<float>& heights);  // the recorded tiles become one undo step
+    bool isEditing() const { return !pendingTiles.empty(); }
+    // apply a step to the heights and return the texels it changed as row runs of tiles
+    bool undo(ThreadPool* threadPool, std::vector<float>& heights, std::vector<TexelRegion>& regions);
+    bool redo(ThreadPool* threadPool, std::vector<float>& heights, std::vector<TexelRegion>& regions);
+    int getNumUndoSteps() const { return (int)undoSteps.size(); }
+    int getNumRedoSteps() const { return (int)redoSteps.size(); }
+    size_t getMemoryUsage() const { return memoryUsage; }  // bytes of deltas in memory, raw or compressed
+    size_t getSpilledBytes() const { return spilledBytes; }
+
+    int memoryBudgetMB = 64;
+    std::string spillPath = "terrain_history.tmp";
+
+private:
+    TerrainHistory() {};
+    struct TileDelta {
+        int tile;                         // index in the tile grid
+        std::vector<uint32_t> raw;        // XOR of the bits, until compressed
+        std::vector<uint8_t> compressed;  // byte planes, LZ-compressed
+        size_t compressedSize = 0;        // also kept while spilled
+    };
+    struct Step {
+        std::mutex mutex;  // held by the compressor while it works on the step
+        std::vector<TileDelta> tiles;
+        bool compressed = false;
+        bool spilled = false;
+        long spillOffset = 0;
+    };
+    bool apply(ThreadPool* threadPool, Step& step, std::vector<float>& heights, std::vector<TexelRegion>& regions);
+    void compress(const std::shared_ptr<Step>& step);
+    void spillOverBudget();
+    TexelRegion getTileRegion(int tile) const;
+
+    int width = 0;
+    int height = 0;
+    int numTilesX = 0;
+    std::vector<std::pair<int, std::vector<float>>> pendingTiles;  // tiles of the current edit before it
+    std::vector<unsigned char> isTilePending;
+    std::mutex stepsMutex;  // the step lists, shared with the compressor
+    std::vector<std::shared_ptr<Step>> undoSteps;  // oldest first
+    std::vector<std::shared_ptr<Step>> redoSteps;  // next redo last
+    std::atomic<size_t> memoryUsage = 0;
+    std::atomic<size_t> spilledBytes = 0;
+    std::mutex spillMutex;
+    FILE* spillFile = nullptr;
+    long spillEnd = 0;
+    std::unique_ptr<ThreadPool> compressor;  // single thread, steps are compressed in order
+};
+
+#endif // __TERRAIN_HISTORY_H__
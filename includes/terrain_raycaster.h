@@ -0,0 +1,55 @@
+#ifndef __TERRAIN_RAYCASTER_H__
+#define __TERRAIN_RAYCASTER_H__
+
+#include "common.h"
+#include "heightfield.h"
+#include <cfloat>
+
+class ThreadPool;  // forward declaration
+
+// Ray and segment intersection with the heightfield surface for picking and line-of-sight queries.
+// The ground is solid below the surface, like the rendered skirt. A max quadtree over the height samples
+// lets a ray skip every node it passes above; the cells of the leaves it reaches are tested exactly
+// against their bilinear patch.
+// Queries use the heightfield's current transform, so only new height data needs a rebuild.
+// The surface spans the texel centers, half a texel less than the rendered terrain on each side.
+class TerrainRaycaster {
+public:
+    struct Ray {
+        glm::vec3 origin;
+        glm::vec3 direction;  // distances are in units of its length
+        float maxDistance = FLT_MAX;
+    };
+    struct Hit {
+        bool hit = false;
+        float distance = 0.0f;
+        glm::vec3 position = glm::vec3(0.0f);
+    };
+
+    static std::unique_ptr<TerrainRaycaster> create(const Heightfield* heightfield, ThreadPool* threadPool = nullptr);
+    Hit intersect(const Ray& ray) const;
+    void intersect(const Ray* rays, Hit* hits, size_t count, ThreadPool* threadPool = nullptr) const;
+    bool isVisible(const glm::vec3& from, const glm::vec3& to) const;  // the segment stays above the ground
+    void update(const TexelRegion& region);  // refits the nodes over samples edited in place
+
+private:
+    TerrainRaycaster() {};
+    void build(ThreadPool* threadPool);
+    float intersectLeaf(int leafX, int leafY, const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax) const;
+    struct Level;
+    float computeLeafMax(int leafX, int leafY) const;  // highest corner sample of the leaf's cells
+    float computeNodeMax(const Level& below, int x, int y) const;
+
+    static constexpr int LEAF_SHIFT = 2;  // a leaf covers 4x4 cells
+    const Heightfield* heightfield = nullptr;
+    int numCellsX = 0;  // cells lie between texel centers: (width - 1) x (height - 1)
+    int numCellsY = 0;
+    struct Level {
+        int width;
+        int height;
+        std::vector<float> maxHeights;  // highest raw sample per node
+    };
+    std::vector<Level> levels;  // leaves first, a single root last
+};
+
+#endif // __TERRAIN_RAYCASTER_H__
@@ -0,0 +1,38 @@
+#ifndef __TERRAIN_SCULPTOR_H__
+#define __TERRAIN_SCULPTOR_H__
+
+#include "common.h"
+#include "heightfield.h"
+
+class ThreadPool;  // forward declaration
+
+// Brush edits of the normalized height map: raise, lower, smooth and flatten.
+// A stroke stamps the brush once per frame while the mouse button is held, scaled by the frame time, and
+// every stamp returns the rectangle it touched so the terrain only refreshes that part of its data.
+class TerrainSculptor {
+public:
+    enum Mode { RAISE, LOWER, SMOOTH, FLATTEN };
+
+    static std::unique_ptr<TerrainSculptor> create();
+    // center in texel coordinates; flatten keeps the height under the first stamp for the whole stroke
+    void beginStroke(const std::vector<float>& heights, int width, int height, glm::vec2 center);
+    // the texels a stamp at the center may change, an empty region outside the map
+    TexelRegion getStampRegion(glm::vec2 center, int width, int height) const;
+    // returns the texels that changed, an empty region outside the map
+    TexelRegion stamp(ThreadPool* threadPool, std::vector<float>& heights, int width, int height, glm::vec2 center,
+        float deltaTime);
+
+    bool enabled = false;    // the left mouse button sculpts instead of picking
+    int mode = RAISE;
+    float radius = 24.0f;    // texels
+    float strength = 0.05f;  // normalized height per second at the center; smooth and flatten blend at 20x this rate
+    float hardness = 0.5f;   // fraction of the radius at full strength, the rest falls off smoothly
+
+private:
+    TerrainSculptor() {};
+
+    float flattenHeight = 0.0f;
+    std::vector<float> source;  // heights under a smooth stamp before it, with a texel of border
+};
+
+#endif // __TERRAIN_SCULPTOR_H__
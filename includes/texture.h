@@ -7,8 +7,14 @@ public:
     int width;
     int height;
     int channels;
+    unsigned int format = 0;    // of the client data, for update
+    unsigned int dataType = 0;
 
     Texture(const char* filePath);
+    Texture(int width, int height, int channels, const unsigned char* data);  // 3 or 4 channels
+    Texture(int width, int height, const float* data);  // one channel, also read as .g and .b like a gray image
+    void update(const void* data);  // whole image, same size and layout as at creation
+    void updateRegion(int x, int y, int w, int h, const void* data);  // sub-rectangle of a whole image in data
 };
 
 class CubemapTexture {
@@ -0,0 +1,38 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include "common.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+// Fixed set of worker threads consuming a FIFO task queue.
+// Tasks must not touch OpenGL; the GL context stays on the main thread.
+class ThreadPool {
+public:
+    static std::unique_ptr<ThreadPool> create(int numThreads = 0);  // 0: one per hardware thread
+    ~ThreadPool();
+    void submit(std::function<void()> task);
+    void waitForPendingBelow(size_t maxPending);  // back-pressure for producers
+    void wait();                                  // until every submitted task has finished
+    // splits [0, count) into chunks processed by the workers and the calling thread; returns when all are done
+    void parallelFor(int count, const std::function<void(int begin, int end)>& body);
+    int getNumThreads() const { return (int)workers.size(); }
+
+private:
+    ThreadPool() {};
+    void init(int numThreads);
+    void workerLoop(int index);
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable taskFinished;
+    size_t numUnfinishedTasks = 0;  // queued and running
+    bool stopping = false;
+};
+
+#endif // __THREAD_POOL_H__
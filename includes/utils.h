@@ -9,6 +9,8 @@ unsigned int generatePositionTextureVAO(const float* vertices, unsigned int vert
 unsigned int generatePositionTextureVAO(const std::vector<float>& vertices);
 unsigned int generatePositionTextureVAOWithEBO(const float* vertices, unsigned int vertexSize, const unsigned int* indices, unsigned int indexSize);
 unsigned int generatePositionTextureVAOWithEBO(const std::vector<float>& vertices, const std::vector<unsigned int>& indices);
+// left, right, bottom, top, near, far planes of a clip matrix (Gribb-Hartmann), inside where dot(plane, p) >= 0
+void extractFrustumPlanes(const glm::mat4& matrix, glm::vec4 planes[6]);
 
 
 
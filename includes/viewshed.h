@@ -0,0 +1,69 @@
+#ifndef __VIEWSHED_H__
+#define __VIEWSHED_H__
+
+#include "common.h"
+#include "heightfield.h"
+#include "thread_pool.h"
+#include <atomic>
+
+// Which heightfield texels an observer standing on the terrain can see, as an R8 mask texture in the
+// orientation of the height map (255 visible, 0 hidden).
+// Rays leave the observer towards every texel on the border of its eight octants and carry the
+// steepest elevation angle met so far; every texel is tested by exactly the ray passing closest to
+// it, so consecutive rays form independent radial sectors that are spread over the viewshed's own
+// threads. The mask is recomputed there from a copy of the heightfield while the last one stays
+// displayed, and the frame's work never queues behind it. A move within the observer's texel costs
+// nothing; any other move traces the whole map again, there is no incremental recomputation. Only the
+// rows whose visibility changed are uploaded.
+class Viewshed {
+public:
+    static std::unique_ptr<Viewshed> create();
+    ~Viewshed();
+    // observer at world (x, z), eyes observerHeight above the ground; starts a recomputation when the inputs
+    // changed and none is running, returns whether a finished mask was uploaded
+    bool compute(const Heightfield* heightfield, const glm::vec2& observer);
+    void invalidate() { stale = true; }  // after the heights were edited, the current mask stays displayed
+
+    bool isValid() const { return valid; }
+    unsigned int getTexture() const { return texture; }
+    const std::vector<unsigned char>& getMask() const { return uploadedMask; }
+    glm::vec3 getObserverPosition() const { return observerPosition; }  // eye position
+    float getVisibleFraction() const { return visibleFraction; }
+    float getComputeTime() const { return computeTime; }  // ms, last finished recomputation
+
+    float observerHeight = 2.0f;  // eyes above the ground, world units
+    float targetHeight = 0.0f;    // a texel is visible if this point above it is
+    bool followCamera = true;     // observer below the camera instead of a fixed point
+
+private:
+    Viewshed() {};
+    // runs on the tracers, reads only the snapshot and writes only the mask and the computed* results
+    void trace(glm::ivec2 observerTexel, glm::vec4 heights, float horizontalScale);
+    void upload();
+
+    unsigned int texture = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> mask;          // written by the running recomputation
+    std::vector<unsigned char> uploadedMask;  // texture contents, to find the changed rows
+    bool valid = false;
+    bool stale = false;
+
+    // inputs of the current or running recomputation
+    std::unique_ptr<Heightfield> snapshot;  // copied when the heights changed and no recomputation runs
+    glm::ivec2 lastObserverTexel = glm::ivec2(-1);
+    glm::vec4 lastHeights = glm::vec4(0.0f);  // height scale, offset, observer and target height
+    float lastHorizontalScale = 0.0f;
+
+    std::unique_ptr<ThreadPool> tracers;  // run the recomputation, apart from the frame's thread pool
+    bool computing = false;
+    std::atomic<bool> finished = false;
+    glm::vec3 computedObserverPosition = glm::vec3(0.0f);
+    float computedTime = 0.0f;
+
+    glm::vec3 observerPosition = glm::vec3(0.0f);
+    float visibleFraction = 0.0f;
+    float computeTime = 0.0f;
+};
+
+#endif // __VIEWSHED_H__
@@ -0,0 +1,2 @@
+#define STB_IMAGE_WRITE_IMPLEMENTATION // use of stb functions once and for all
+#include "stb/stb_image_write.h"
\ No newline at end of file
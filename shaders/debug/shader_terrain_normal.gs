@@ -4,11 +4,9 @@ layout (line_strip, max_vertices = 12) out;
 
 in TESE_OUT {
     vec3 color;
-    vec4 bottomPoint;
-    float clipDistance;
-    float bottomClipDistance;
-    bool isCloseToBorder;
-    bool isAdjacentToBorder;
+    vec4 worldPos;
+    vec4 fragPosLightSpace;
+    vec3 normal;
 } gs_in[];
 
 out GS_OUT {
@@ -29,20 +27,15 @@ void generateLine(vec4 v0, vec4 v1, vec3 color);
 
 void main()
 {
-    bool isAdjacentToBorder = gs_in[0].isAdjacentToBorder || gs_in[1].isAdjacentToBorder || gs_in[2].isAdjacentToBorder;
-    if (isAdjacentToBorder)
-        return;
-
     // world space positions
-    vec4 v0 = gl_in[0].gl_Position;
-    vec4 v1 = gl_in[1].gl_Position;
-    vec4 v2 = gl_in[2].gl_Position;
-    vec3 normal = normalize(cross(vec3(v2 - v0), vec3(v1 - v0)));
+    vec4 v0 = gs_in[0].worldPos;
+    vec4 v1 = gs_in[1].worldPos;
+    vec4 v2 = gs_in[2].worldPos;
 
     if (showNormals) {
-        generateLine(v0, v0 + vec4(normal, 0.0) * MAGNITUDE, normalColor);
-        generateLine(v1, v1 + vec4(normal, 0.0) * MAGNITUDE, normalColor);
-        generateLine(v2, v2 + vec4(normal, 0.0) * MAGNITUDE, normalColor);
+        generateLine(v0, v0 + vec4(gs_in[0].normal, 0.0) * MAGNITUDE, normalColor);
+        generateLine(v1, v1 + vec4(gs_in[1].normal, 0.0) * MAGNITUDE, normalColor);
+        generateLine(v2, v2 + vec4(gs_in[2].normal, 0.0) * MAGNITUDE, normalColor);
     }
     if (showLightDirection) {
         generateLine(v0, v0 + vec4(-lightDir, 0.0) * MAGNITUDE, lightDirColor);
@@ -10,8 +10,8 @@ uniform vec3 fogColor;
 // uniform float fogMin;
 // uniform float fogMax;
 uniform float fogDensity;
-uniform float nearPlane;
-uniform float farPlane;
+uniform float fogDistance;  // view distance that counts as 1 in the fog equations
+uniform bool reverseZ;      // depth is 1 at the near plane and 0 at infinity, clip range [0, 1]
 
 uniform mat4 view;
 uniform mat4 invProjection;
@@ -21,16 +21,24 @@ uniform vec3 cameraPosition;
 uniform float fogHeight;
 uniform bool isLayeredFog;
 
+bool isSky(float depth) {
+  return reverseZ ? depth <= 0.0 : depth >= 1.0;
+}
+
+float toNDCDepth(float depth) {
+  return reverseZ ? depth : depth * 2.0 - 1.0;
+}
+
+// view-space distance along the camera axis, from the actual projection
 float LinearizeDepth(float depth) {
-  float z = depth * 2.0 - 1.0;
-  return (2.0 * nearPlane * farPlane) /
-         (farPlane + nearPlane - z * (farPlane - nearPlane));
+  vec4 viewSpaceCoords = invProjection * vec4(TexCoords * 2.0 - 1.0, toNDCDepth(depth), 1.0);
+  return -viewSpaceCoords.z / viewSpaceCoords.w;
 }
 
 vec3 getWorldSpacePosition() {
   // get NDC coordinates
   vec2 ndc = TexCoords * 2.0 - 1.0;
-  float z = texture(depthMap, TexCoords).r * 2.0 - 1.0;
+  float z = toNDCDepth(texture(depthMap, TexCoords).r);
 
   // get clip space coordinates
   vec4 clipSpaceCoords = vec4(ndc, z, 1.0);
@@ -46,10 +54,11 @@ vec3 getWorldSpacePosition() {
 }
 
 float CalculateFogFactor(float depth) {
+  // the sky is fogged like a surface at the fog distance
   float linearizedDepth =
-      LinearizeDepth(depth) / farPlane; // linearize and normalize depth
+      isSky(depth) ? 1.0 : LinearizeDepth(depth) / fogDistance; // linearize and normalize depth
   float fogFactor = exp(-pow(linearizedDepth * fogDensity, 2.0f));
-  if (depth > 0.999)
+  if (isSky(depth))
     return clamp(fogFactor, 0.2, 1.0);
 
   return clamp(fogFactor, 0.0, 1.0);
@@ -65,21 +74,21 @@ float CalculateLayerdFogFactor(vec3 worldSpaceCoords, float depth) {
   cameraPositionProj.y = 0.0;
 
   // calculate normalized distance from camera in xz plane
-  float deltaD = length(cameraPositionProj - worldSpaceCoordsProj) / farPlane;
-  if (depth > 0.999) // fix deltaD for skybox
+  float deltaD = length(cameraPositionProj - worldSpaceCoordsProj) / fogDistance;
+  if (isSky(depth)) // fix deltaD for skybox
     deltaD = 10.0;
 
   float deltaY = 0.0;
   float densityIntegral = 0.0;
 
   if (cameraPosition.y > fogHeight) {     // camera is above fog
-    if (worldSpaceCoords.y < fogHeight && depth < 0.999) { // fragment is below fog and not skybox
+    if (worldSpaceCoords.y < fogHeight && !isSky(depth)) { // fragment is below fog and not skybox
       deltaY = (fogHeight - worldSpaceCoords.y) / fogHeight;
       densityIntegral = 0.5 * deltaY * deltaY;
     }      // when fragment is above fog, density integral is 0
   } else { // camera is below fog
     if (worldSpaceCoords.y < fogHeight) { // fragment is below fog
-      if (depth > 0.999) { // fragment is skybox
+      if (isSky(depth)) { // fragment is skybox
         deltaY = (fogHeight - cameraPosition.y) / fogHeight;
         densityIntegral = 0.5 * deltaY * deltaY;
       } else {
@@ -0,0 +1,29 @@
+#version 410 core
+layout (location = 0) out vec4 FragColor;
+
+uniform sampler2D sourceTexture;  // scene depth for level 0, otherwise the level above (as its base level)
+uniform bool copyDepth;
+uniform bool reverseZ;  // far is 0, keep the minimum
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    if (copyDepth) {
+        FragColor = vec4(texelFetch(sourceTexture, texel, 0).r);
+        return;
+    }
+
+    // 2x2 footprint; the last row and column of an odd-sized level also take the leftover texels
+    ivec2 sourceSize = textureSize(sourceTexture, 0);
+    ivec2 size = max(sourceSize / 2, ivec2(1));
+    ivec2 sourceBegin = texel * 2;
+    ivec2 sourceEnd = min(sourceBegin + 2 + ivec2(equal(texel, size - 1)) * (sourceSize & 1), sourceSize);
+    float depth = reverseZ ? 1.0 : 0.0;
+    for (int y = sourceBegin.y; y < sourceEnd.y; y++) {
+        for (int x = sourceBegin.x; x < sourceEnd.x; x++) {
+            float sourceDepth = texelFetch(sourceTexture, ivec2(x, y), 0).r;
+            depth = reverseZ ? min(depth, sourceDepth) : max(depth, sourceDepth);
+        }
+    }
+    FragColor = vec4(depth);
+}
@@ -5,10 +5,11 @@ out vec3 TexCoords;
 
 uniform mat4 projection;
 uniform mat4 view;
+uniform bool reverseZ;  // the far plane is at depth 0 instead of 1
 
 void main()
 {
     TexCoords = aPos;
     vec4 pos = projection * view * vec4(aPos, 1.0);
-    gl_Position = pos.xyww;
+    gl_Position = reverseZ ? vec4(pos.xy, 0.0, pos.w) : pos.xyww;
 }
\ No newline at end of file
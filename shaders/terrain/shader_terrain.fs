@@ -1,7 +1,8 @@
 #version 410 core
 
-in GS_OUT {
+in TESE_OUT {
     vec3 color;
+    vec4 worldPos;
     vec4 fragPosLightSpace;
     vec3 normal;
 } fs_in;
@@ -19,6 +20,9 @@ uniform float minShadowBias;
 uniform float maxShadowBias;
 uniform int numPCFSamples;
 uniform float PCFSpreadness;
+uniform bool showViewshed;
+uniform sampler2D viewshedMap;  // 1 where the viewshed observer sees the ground
+uniform float horizontalScale;
 
 float calculateShadow(vec4 fragPosLightSpace);
 float random(vec3 seed, int i);
@@ -30,6 +34,11 @@ void main()
     }
 
     vec3 color = fs_in.color;
+    if (showViewshed) {
+        // inverse of the terrain's model matrix, the mask has the orientation of the height map
+        float visible = texture(viewshedMap, fs_in.worldPos.xz / horizontalScale + 0.5).r;
+        color = mix(color * vec3(0.6, 0.3, 0.3), mix(color, vec3(0.2, 0.9, 0.3), 0.4), visible);
+    }
     float shadow = calculateShadow(fs_in.fragPosLightSpace);
     if (!useLighting) {
         fragColor = vec4(ambientStrength * color + color * (1.0 - ambientStrength) * (1.0 - shadow), 1.0);
@@ -1,13 +1,30 @@
 #version 410 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in uint aPatchIndex;  // per instance, written by the culling pass
 
 out VS_OUT {
 	vec2 texCoord;
 } vs_out;
 
+uniform bool useInstancedGrid;
+uniform bool useCulledPatches;  // instances are the visible patches only
+uniform int gridSize;       // patches per side
+uniform vec2 terrainSize;   // height map size in texels
+
+// patch corners in the order of the per-vertex grid: bottom-left, bottom-right, top-left, top-right
+const vec2 corners[4] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0), vec2(1.0, 1.0));
+
 void main()
 {
+	if (useInstancedGrid) {
+		int patchIndex = useCulledPatches ? int(aPatchIndex) : gl_InstanceID;
+		ivec2 cell = ivec2(patchIndex / gridSize, patchIndex % gridSize);
+		vec2 uv = (vec2(cell) + corners[gl_VertexID]) / float(gridSize);
+		gl_Position = vec4(terrainSize.x * (uv.x - 0.5), 0.0, terrainSize.y * (uv.y - 0.5), 1.0);
+		vs_out.texCoord = uv;
+		return;
+	}
 	gl_Position = vec4(aPos, 1.0f);
 	vs_out.texCoord = aTexCoord;
 }
@@ -0,0 +1,22 @@
+#version 410 core
+
+in vec3 color;
+in vec3 normal;
+
+out vec4 fragColor;
+
+uniform bool useLighting;
+uniform vec3 lightDir;
+uniform float ambientStrength;
+
+void main()
+{
+    if (!useLighting) {
+        fragColor = vec4(color, 1.0);
+        return;
+    }
+
+    vec3 ambient = ambientStrength * color;
+    vec3 diffuse = max(dot(normalize(normal), -lightDir), 0.0) * color * (1.0 - ambientStrength);
+    fragColor = vec4(ambient + diffuse, 1.0);
+}
\ No newline at end of file
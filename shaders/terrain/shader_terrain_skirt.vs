@@ -0,0 +1,23 @@
+#version 410 core
+layout (location = 0) in vec3 aPos;       // x, raw height in [0, 1], z
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in float aIsTop;    // 1 on the terrain border, 0 on the ground plane
+
+out vec3 color;
+out vec3 normal;
+
+uniform sampler2D diffuseMap;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform float heightScale;
+uniform float heightOffset;
+
+void main()
+{
+    float height = heightOffset + aIsTop * aPos.y * heightScale;
+    gl_Position = projection * view * model * vec4(aPos.x, height, aPos.z, 1.0);
+    color = texture(diffuseMap, aTexCoord).rgb;
+    normal = aNormal;
+}
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "batch_renderer.h"
+#include "benchmark.h"
+#include "context.h"
+#include "camera_path.h"
+#include "framebuffer.h"
+#include "readback.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+bool BatchRenderer::parseOptions(int argc, const char** argv, BatchOptions& options) {
+    bool isBatch = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--batch")
+            isBatch = true;
+        else if (arg == "--terrain" && hasValue)
+            options.terrainNames.push_back(argv[++i]);
+        else if (arg == "--camera-path" && hasValue)
+            options.cameraPathFile = argv[++i];
+        else if (arg == "--views" && hasValue)
+            options.numViews = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--width" && hasValue)
+            options.width = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--height" && hasValue)
+            options.height = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--threads" && hasValue)
+            options.numThreads = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--context" && hasValue)
+            options.contextAPI = argv[++i];
+        else if (arg == "--output-dir" && hasValue)
+            options.outputDir = argv[++i];
+    }
+    return isBatch;
+}
+
+int BatchRenderer::run(const BatchOptions& options) {
+    auto window = Benchmark::createOffscreenWindow(options.width, options.height, options.contextAPI);
+    if (!window)
+        return -1;
+
+    int result = 0;
+    {
+        auto context = Context::create();
+        if (!context) {
+            SPDLOG_ERROR("failed to create context");
+            glfwDestroyWindow(window);
+            glfwTerminate();
+            return -1;
+        }
+        auto outputFramebuffer = Framebuffer::create(options.width, options.height, AttachmentType::COLOR);
+        std::unique_ptr<CameraPath> cameraPath = options.cameraPathFile.empty()
+            ? CameraPath::createOrbit(40.0f, 30.0f, -35.0f, options.numViews)
+            : CameraPath::load(options.cameraPathFile);
+        std::error_code error;
+        fs::create_directories(options.outputDir, error);
+        if (!outputFramebuffer || !cameraPath || error) {
+            SPDLOG_ERROR("Failed to prepare batch rendering to {}", options.outputDir);
+            // the GL objects and the context's worker threads go before the GL context does
+            outputFramebuffer.reset();
+            context.reset();
+            glfwDestroyWindow(window);
+            glfwTerminate();
+            return -1;
+        }
+
+        context->reshape(options.width, options.height);
+        context->setOutputFramebuffer(outputFramebuffer.get());
+        context->setFixedDeltaTime(1.0f / 60.0f);
+        auto readback = AsyncReadback::create();
+        auto threadPool = ThreadPool::create(options.numThreads);
+        std::atomic<int> numFailed = 0;
+
+        std::vector<std::string> terrainNames = options.terrainNames;
+        if (terrainNames.empty())
+            terrainNames = context->getTerrainNames();
+        int numImages = 0;
+        SPDLOG_INFO("Batch rendering {} terrains x {} views ({} encoder threads)",
+            terrainNames.size(), options.numViews, threadPool->getNumThreads());
+
+        uint64_t startNs = CpuProfiler::now();
+        for (const auto& terrainName : terrainNames) {
+            if (!context->selectTerrain(terrainName)) {
+                result = -1;
+                continue;
+            }
+            std::string baseName = terrainName;
+            std::replace(baseName.begin(), baseName.end(), ' ', '_');
+
+            for (int view = 0; view < options.numViews; view++) {
+                CpuProfiler::markFrame();
+                PROFILE_ZONE("batch view");
+                cameraPath->apply(cameraPath->getDuration() * view / options.numViews, context->getCamera());
+                context->updateDeltaTime();
+                context->render();
+
+                // the GPU keeps rendering the next views while this one is copied and encoded
+                std::string filePath = (fs::path(options.outputDir) / (baseName + "_" + std::to_string(view) + ".png")).string();
+                outputFramebuffer->bind(BindType::READ);
+                readback->request(options.width, options.height,
+                    [&threadPool, &numFailed, filePath](std::vector<uint8_t>&& pixels, int width, int height) {
+                        threadPool->submit([&numFailed, filePath, pixels = std::move(pixels), width, height]() {
+                            if (!writeReadbackPNG(filePath, pixels, width, height))
+                                numFailed++;
+                        });
+                    });
+                outputFramebuffer->unbind();
+                readback->poll();
+                // bound the number of raw images held in memory
+                threadPool->waitForPendingBelow(2 * threadPool->getNumThreads() + 1);
+                numImages++;
+            }
+        }
+        readback->flush();
+        threadPool->wait();
+        double seconds = (CpuProfiler::now() - startNs) / 1e9;
+
+        if (numFailed > 0)
+            result = -1;
+        SPDLOG_INFO("Batch rendering finished: {} images in {:.2f} s ({:.2f} images/s) -> {}",
+            numImages - numFailed, seconds, seconds > 0.0 ? numImages / seconds : 0.0, options.outputDir);
+        context->setOutputFramebuffer(nullptr);
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return result;
+}
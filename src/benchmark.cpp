@@ -0,0 +1,336 @@
+#include "benchmark.h"
+#include "context.h"
+#include "camera_path.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <numeric>
+
+namespace {
+
+struct Summary {
+    double mean = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+};
+
+Summary summarize(std::vector<double> values) {
+    Summary summary;
+    if (values.empty())
+        return summary;
+    std::sort(values.begin(), values.end());
+    auto percentile = [&values](double p) {
+        size_t rank = std::min(values.size() - 1, (size_t)(p / 100.0 * values.size()));
+        return values[rank];
+    };
+    summary.mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    summary.min = values.front();
+    summary.max = values.back();
+    summary.p50 = percentile(50.0);
+    summary.p90 = percentile(90.0);
+    summary.p95 = percentile(95.0);
+    summary.p99 = percentile(99.0);
+    return summary;
+}
+
+// a JSON string literal: quotes, backslashes (Windows paths) and control characters escaped
+std::string quoteJson(const std::string& value) {
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\')
+            quoted += {'\\', c};
+        else if ((unsigned char)c < 0x20) {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        }
+        else
+            quoted += c;
+    }
+    return quoted + "\"";
+}
+
+void writeSummary(std::ofstream& file, const Summary& summary) {
+    file << "{\"mean\": " << summary.mean << ", \"min\": " << summary.min << ", \"p50\": " << summary.p50
+        << ", \"p90\": " << summary.p90 << ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99
+        << ", \"max\": " << summary.max << "}";
+}
+
+int checkGeneratorParity(Context* context, const BenchmarkOptions& options, const std::string& renderer,
+    const std::string& glVersion) {
+    Terrain* terrain = context->getTerrain();
+    if (!terrain->isGpuGeneratorSupported()) {
+        SPDLOG_ERROR("GPU terrain generation is not supported by {} ({})", renderer, glVersion);
+        return -1;
+    }
+    TerrainGenerator* generator = terrain->getGenerator();
+    terrain->useGpuGenerator = true;
+    const struct {
+        const char* name;
+        int noiseType;
+    } noiseTypes[] = { { "fbm", TerrainGenerator::FBM }, { "ridged", TerrainGenerator::RIDGED } };
+
+    float maxError = 0.0f;
+    std::map<std::string, float> errors;
+    for (const auto& noise : noiseTypes) {
+        generator->noiseType = noise.noiseType;
+        terrain->resetTerrain(Terrain::PROCEDURAL_TERRAIN);
+        float error = terrain->measureGeneratorParity();
+        SPDLOG_INFO("Generator parity ({}, {}x{}): max error {:.3e}", noise.name, generator->resolution,
+            generator->resolution, error);
+        errors[noise.name] = error;
+        maxError = std::max(maxError, error);
+    }
+
+    std::ofstream file(options.outputFile);
+    if (!file.is_open()) {
+        SPDLOG_ERROR("Failed to open benchmark output: {}", options.outputFile);
+        return -1;
+    }
+    file << "{\n";
+    file << "  \"renderer\": " << quoteJson(renderer) << ",\n";
+    file << "  \"gl_version\": " << quoteJson(glVersion) << ",\n";
+    file << "  \"resolution\": " << generator->resolution << ",\n";
+    file << "  \"tolerance\": " << Benchmark::GENERATOR_PARITY_TOLERANCE << ",\n";
+    file << "  \"generator_parity\": {";
+    const char* separator = "\n";
+    for (const auto& [name, error] : errors) {
+        file << separator << "    " << quoteJson(name) << ": " << error;
+        separator = ",\n";
+    }
+    file << "\n  }\n}\n";
+    if (maxError > Benchmark::GENERATOR_PARITY_TOLERANCE) {
+        SPDLOG_ERROR("Generator parity failed: {:.3e} > {:.1e}", maxError, Benchmark::GENERATOR_PARITY_TOLERANCE);
+        return 1;
+    }
+    return 0;
+}
+
+}  // namespace
+
+bool Benchmark::parseOptions(int argc, const char** argv, BenchmarkOptions& options) {
+    bool isBenchmark = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--benchmark")
+            isBenchmark = true;
+        else if (arg == "--terrain" && hasValue)
+            options.terrainName = argv[++i];
+        else if (arg == "--camera-path" && hasValue)
+            options.cameraPathFile = argv[++i];
+        else if (arg == "--frames" && hasValue)
+            options.numFrames = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--warmup" && hasValue)
+            options.numWarmupFrames = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--dt" && hasValue) {
+            // zero would fall back to the measured frame time and break determinism
+            options.fixedDeltaTime = std::atof(argv[++i]);
+            if (!(options.fixedDeltaTime > 0.0f)) {
+                SPDLOG_ERROR("--dt must be positive, got {}", argv[i]);
+                options.invalid = true;
+            }
+        }
+        else if (arg == "--width" && hasValue)
+            options.width = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--height" && hasValue)
+            options.height = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--context" && hasValue)
+            options.contextAPI = argv[++i];
+        else if (arg == "--output" && hasValue)
+            options.outputFile = argv[++i];
+        else if (arg == "--replay" && hasValue)
+            options.replayFile = argv[++i];
+        else if (arg == "--generator-parity")
+            options.generatorParity = true;
+    }
+    return isBenchmark;
+}
+
+GLFWwindow* Benchmark::createOffscreenWindow(int width, int height, const std::string& contextAPI) {
+    // the null platform needs no display; the context comes from OSMesa or EGL (e.g. Mesa llvmpipe)
+    SPDLOG_INFO("Initialize glfw (headless)");
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    if (!glfwInit()) {
+        const char* description = nullptr;
+        glfwGetError(&description);
+        SPDLOG_ERROR("failed to initialize glfw: {}", description);
+        return nullptr;
+    }
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, contextAPI == "egl" ? GLFW_EGL_CONTEXT_API : GLFW_OSMESA_CONTEXT_API);
+
+    // same version fallback as the window in main
+    GLFWwindow* window = nullptr;
+    for (int minorVersion : { 3, 1 }) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minorVersion);
+        window = glfwCreateWindow(width, height, WINDOW_NAME, nullptr, nullptr);
+        if (window)
+            break;
+    }
+    if (!window) {
+        const char* description = nullptr;
+        glfwGetError(&description);
+        SPDLOG_ERROR("failed to create offscreen context: {}", description);
+        glfwTerminate();
+        return nullptr;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        SPDLOG_ERROR("failed to initialize glad");
+        glfwTerminate();
+        return nullptr;
+    }
+    SPDLOG_INFO("OpenGL renderer: {}, version: {}",
+        reinterpret_cast<const char*>(glGetString(GL_RENDERER)), reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+    return window;
+}
+
+int Benchmark::run(const BenchmarkOptions& options) {
+    if (options.invalid)
+        return -1;  // reported by parseOptions
+    auto window = createOffscreenWindow(options.width, options.height, options.contextAPI);
+    if (!window)
+        return -1;
+    std::string renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    std::string glVersion = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+
+    int result = 0;
+    {
+        auto context = Context::create();
+        // the context's GL objects and worker threads go before the GL context does
+        auto terminate = [&](int result) {
+            context.reset();
+            glfwDestroyWindow(window);
+            glfwTerminate();
+            return result;
+        };
+        if (!context) {
+            SPDLOG_ERROR("failed to create context");
+            return terminate(-1);
+        }
+        if (!options.terrainName.empty() && !context->selectTerrain(options.terrainName))
+            return terminate(-1);
+        if (options.generatorParity)
+            return terminate(checkGeneratorParity(context.get(), options, renderer, glVersion));
+
+        std::unique_ptr<CameraPath> cameraPath = options.cameraPathFile.empty()
+            ? CameraPath::createOrbit(40.0f, 30.0f, -35.0f, options.numFrames * options.fixedDeltaTime)
+            : CameraPath::load(options.cameraPathFile);
+        if (!cameraPath)
+            return terminate(-1);
+
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        context->reshape(framebufferWidth, framebufferHeight);
+        context->setFixedDeltaTime(options.fixedDeltaTime);
+        GpuProfiler* gpuProfiler = context->getGpuProfiler();
+        InputRecorder* inputRecorder = context->getInputRecorder();
+
+        // a recording is replayed as fast as possible and decides the number of measured frames
+        bool isReplay = !options.replayFile.empty();
+        int numFrames = options.numFrames;
+        if (isReplay) {
+            if (!inputRecorder->startReplay(options.replayFile, InputRecorder::PlaybackSpeed::MAXIMUM))
+                return terminate(-1);
+            numFrames = inputRecorder->getNumReplayFrames();
+            inputRecorder->stopReplay();
+        }
+
+        std::vector<double> frameTimes;
+        std::map<std::string, std::vector<double>> cpuZoneTimes;
+        int totalFrames = options.numWarmupFrames + numFrames;
+        SPDLOG_INFO("Run benchmark: {} warmup + {} frames", options.numWarmupFrames, numFrames);
+        for (int frame = 0; frame < totalFrames; frame++) {
+            bool isMeasured = frame >= options.numWarmupFrames;
+            if (frame == options.numWarmupFrames) {
+                gpuProfiler->setHistorySize(numFrames);  // discard warmup samples
+                if (isReplay)
+                    inputRecorder->startReplay(options.replayFile, InputRecorder::PlaybackSpeed::MAXIMUM);
+            }
+
+            float time = (frame - options.numWarmupFrames) * options.fixedDeltaTime;
+            uint64_t frameStart = CpuProfiler::now();
+            CpuProfiler::markFrame();
+            {
+                PROFILE_ZONE("frame");
+                if (isReplay && isMeasured) {
+                    context->update(window);
+                }
+                else {
+                    cameraPath->apply(glm::max(time, 0.0f), context->getCamera());
+                    context->updateDeltaTime();
+                }
+                gpuProfiler->beginFrame();
+                context->render();
+                gpuProfiler->endFrame();
+                PROFILE_ZONE("glfwSwapBuffers");
+                glfwSwapBuffers(window);
+            }
+            if (!isMeasured)
+                continue;
+            frameTimes.push_back((CpuProfiler::now() - frameStart) / 1000000.0);
+
+            // sum every zone of this frame by name
+            std::map<std::string, double> frameZoneTimes;
+            for (const auto& event : CpuProfiler::getEvents(1))
+                frameZoneTimes[event.name] += (event.endNs - event.startNs) / 1000000.0;
+            for (const auto& [name, timeMs] : frameZoneTimes)
+                cpuZoneTimes[name].push_back(timeMs);
+        }
+        gpuProfiler->flush();
+
+        std::ofstream file(options.outputFile);
+        if (!file.is_open()) {
+            SPDLOG_ERROR("Failed to open benchmark output: {}", options.outputFile);
+            result = -1;
+        }
+        else {
+            file << "{\n";
+            file << "  \"terrain\": " << quoteJson(options.terrainName.empty() ? "default" : options.terrainName) << ",\n";
+            file << "  \"renderer\": " << quoteJson(renderer) << ",\n";
+            file << "  \"gl_version\": " << quoteJson(glVersion) << ",\n";
+            file << "  \"width\": " << framebufferWidth << ",\n";
+            file << "  \"height\": " << framebufferHeight << ",\n";
+            file << "  \"frames\": " << numFrames << ",\n";
+            file << "  \"fixed_delta_time\": " << options.fixedDeltaTime << ",\n";
+            if (isReplay)
+                file << "  \"replay\": " << quoteJson(options.replayFile) << ",\n";
+            file << "  \"frame_time_ms\": ";
+            writeSummary(file, summarize(frameTimes));
+            file << ",\n  \"cpu_zones_ms\": {";
+            const char* separator = "\n";
+            for (const auto& [name, times] : cpuZoneTimes) {
+                file << separator << "    " << quoteJson(name) << ": ";
+                writeSummary(file, summarize(times));
+                separator = ",\n";
+            }
+            file << "\n  },\n  \"gpu_passes_ms\": {";
+            separator = "\n";
+            for (const auto& name : gpuProfiler->getPassNames()) {
+                file << separator << "    " << quoteJson(name) << ": {\"mean\": " << gpuProfiler->getAverage(name)
+                    << ", \"p50\": " << gpuProfiler->getPercentile(name, 50.0f)
+                    << ", \"p95\": " << gpuProfiler->getPercentile(name, 95.0f)
+                    << ", \"p99\": " << gpuProfiler->getPercentile(name, 99.0f) << "}";
+                separator = ",\n";
+            }
+            file << "\n  }\n}\n";
+            Summary frameSummary = summarize(frameTimes);
+            SPDLOG_INFO("Benchmark finished: mean {:.3f} ms, p95 {:.3f} ms, p99 {:.3f} ms -> {}",
+                frameSummary.mean, frameSummary.p95, frameSummary.p99, options.outputFile);
+        }
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return result;
+}
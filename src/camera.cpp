@@ -104,4 +104,11 @@ void Camera::rotateCamera(float theta) {
     // rotate camera direction
     yaw -= theta;
     updateCameraVectors();
+}
+
+void Camera::setPose(glm::vec3 position, float yaw, float pitch) {
+    this->position = position;
+    this->yaw = yaw;
+    this->pitch = pitch;
+    updateCameraVectors();
 }
\ No newline at end of file
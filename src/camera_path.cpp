@@ -0,0 +1,72 @@
+#include "camera_path.h"
+#include "camera.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+std::unique_ptr<CameraPath> CameraPath::load(const std::string& filePath) {
+    std::ifstream file(filePath);
+    if (!file.is_open()) {
+        SPDLOG_ERROR("Failed to open camera path: {}", filePath);
+        return nullptr;
+    }
+
+    auto path = std::unique_ptr<CameraPath>(new CameraPath());
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        std::istringstream stream(line);
+        Keyframe keyframe;
+        if (!(stream >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.yaw >> keyframe.pitch)) {
+            SPDLOG_ERROR("Invalid camera keyframe at {}:{}", filePath, lineNumber);
+            return nullptr;
+        }
+        path->keyframes.push_back(keyframe);
+    }
+    if (path->keyframes.empty()) {
+        SPDLOG_ERROR("Camera path has no keyframes: {}", filePath);
+        return nullptr;
+    }
+
+    std::stable_sort(path->keyframes.begin(), path->keyframes.end(), [](const Keyframe& a, const Keyframe& b) {
+        return a.time < b.time;
+    });
+    SPDLOG_INFO("Camera path loaded: {} ({} keyframes, {:.2f} s)", filePath, path->keyframes.size(), path->getDuration());
+    return std::move(path);
+}
+
+std::unique_ptr<CameraPath> CameraPath::createOrbit(float radius, float height, float pitch, float duration) {
+    auto path = std::unique_ptr<CameraPath>(new CameraPath());
+    constexpr int NUM_KEYFRAMES = 64;
+    for (int i = 0; i <= NUM_KEYFRAMES; i++) {
+        float angle = 360.0f * i / NUM_KEYFRAMES;
+        float angleRad = glm::radians(angle);
+        Keyframe keyframe;
+        keyframe.time = duration * i / NUM_KEYFRAMES;
+        keyframe.position = glm::vec3(radius * sin(angleRad), height, radius * cos(angleRad));
+        keyframe.yaw = -90.0f - angle;  // keep looking at the terrain center
+        keyframe.pitch = pitch;
+        path->keyframes.push_back(keyframe);
+    }
+    return std::move(path);
+}
+
+void CameraPath::apply(float time, Camera* camera) const {
+    time = glm::clamp(time, keyframes.front().time, keyframes.back().time);
+    auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time, [](float t, const Keyframe& keyframe) {
+        return t < keyframe.time;
+    });
+    if (next == keyframes.end()) {
+        camera->setPose(keyframes.back().position, keyframes.back().yaw, keyframes.back().pitch);
+        return;
+    }
+    const Keyframe& b = *next;
+    const Keyframe& a = next == keyframes.begin() ? b : *(next - 1);
+    float t = b.time > a.time ? (time - a.time) / (b.time - a.time) : 0.0f;
+    camera->setPose(glm::mix(a.position, b.position, t), glm::mix(a.yaw, b.yaw, t), glm::mix(a.pitch, b.pitch, t));
+}
@@ -1,6 +1,8 @@
 #include "context.h"
 #include "utils.h"
 #include "geometry_primitives.h"
+#include <algorithm>
+#include <ctime>
 #include <filesystem>
 #include <imgui.h>
 
@@ -14,16 +16,24 @@ std::unique_ptr<Context> Context::create() {
 }
 
 bool Context::init() {
+    threadPool = ThreadPool::create();
     camera = std::make_unique<Camera>();
+    groundClamp = GroundClamp::create();
     light = std::make_unique<DirectionalLight>(this);
     skybox = std::make_unique<Skybox>(this);
     terrain = Terrain::createWithTessellation(this);
     water = std::make_unique<Water>(this);
     fog = std::make_unique<Fog>(this);
+    dynamicResolution = DynamicResolution::create();
+    gpuProfiler = GpuProfiler::create();
+    pipelineStatistics = PipelineStatistics::create();
+    inputRecorder = InputRecorder::create();
+    frameCapture = FrameCapture::create();
     depthMap = Framebuffer::create(1024, 1024, AttachmentType::DEPTH);
     debugScreenBuffer = Framebuffer::create(1024, 1024, AttachmentType::COLOR);
     antiAliasingScreenBuffer = Framebuffer::create(width, height, AttachmentType::COLOR);
     fogScreenBuffer = Framebuffer::create(width, height, AttachmentType::COLOR_AND_DEPTH);
+    hiZBuffer = HiZBuffer::create();
     screenQuadVAO = generatePositionTextureVAO(screenQuadVertices, sizeof(screenQuadVertices));
     depthQuadShader = std::make_unique<Shader>(
         "../shaders/debug/shader_depth_quad.vs",
@@ -34,41 +44,300 @@ bool Context::init() {
         "../shaders/shader_fxaa.fs"
     );
 
-    // load terrain directories
+    glPatchParameteri(GL_PATCH_VERTICES, 4);  // use quad patches
+    glEnable(GL_DEPTH_TEST);
+    glCullFace(GL_BACK);
+    isReverseZSupported = GLAD_GL_VERSION_4_5 || GLAD_GL_ARB_clip_control;
+    if (!isReverseZSupported)
+        SPDLOG_INFO("glClipControl is not available, using standard depth");
+    _setDepthConvention(isReverseZ());
+
+    // load terrain directories, sorted so that terrain indices are stable across machines
     fs::path baseDir = "../assets/Terrain";
     for (const auto& entry : fs::directory_iterator(baseDir)) {
-        if (fs::is_directory(entry)) {
-            std::string terrainName = entry.path().filename().string();
-            terrainNames.push_back(terrainName);
-            if (terrainName == terrain->initTerrain) {
-                currentTerrainIdx = terrainNames.size() - 1;
+        if (fs::is_directory(entry))
+            terrainNames.push_back(entry.path().filename().string());
+    }
+    std::sort(terrainNames.begin(), terrainNames.end());
+    terrainNames.push_back(Terrain::PROCEDURAL_TERRAIN);  // last, so the indices of the directories do not move
+    for (int i = 0; i < terrainNames.size(); i++) {
+        if (terrainNames[i] == terrain->initTerrain)
+            currentTerrainIdx = i;
+    }
+    currentTerrainName = terrain->initTerrain;
+
+    _trackRecordedParameters();
+    return true;
+}
+
+void Context::_trackRecordedParameters() {
+    // camera and mouse state evolve from the recorded input, so only the starting values are needed
+    auto updateCamera = [this]() { camera->setPose(camera->position, camera->yaw, camera->pitch); };
+    inputRecorder->trackInitialState("camera position", &camera->position, updateCamera);
+    inputRecorder->trackInitialState("camera yaw", &camera->yaw, updateCamera);
+    inputRecorder->trackInitialState("camera pitch", &camera->pitch, updateCamera);
+    inputRecorder->trackInitialState("camera mouse control", &cameraMouseControlActivated);
+    inputRecorder->trackInitialState("last mouse x", &lastX);
+    inputRecorder->trackInitialState("last mouse y", &lastY);
+    inputRecorder->trackInitialState("elapsed time", &elapsedTime);
+
+    // GUI parameters; dynamic resolution is driven by measured GPU time and is not replayed
+    inputRecorder->trackParameter("terrain", &currentTerrainName, [this]() {
+        auto it = std::find(terrainNames.begin(), terrainNames.end(), currentTerrainName);
+        if (it == terrainNames.end()) {
+            SPDLOG_ERROR("Recorded terrain not found, replay aborted: {}", currentTerrainName);
+            currentTerrainName = terrainNames[currentTerrainIdx];
+            inputRecorder->stopReplay();
+            return;
+        }
+        currentTerrainIdx = (int)(it - terrainNames.begin());
+        terrainResetPending = true;
+    });
+    // a frame can change several generator parameters, the terrain is reset once after all of them
+    auto regenerate = [this]() {
+        if (terrainNames[currentTerrainIdx] == Terrain::PROCEDURAL_TERRAIN)
+            terrainResetPending = true;
+    };
+    TerrainGenerator* generator = terrain->getGenerator();
+    inputRecorder->trackParameter("generator resolution", &generator->resolution, regenerate);
+    inputRecorder->trackParameter("generator noise", &generator->noiseType, regenerate);
+    inputRecorder->trackParameter("generator seed", &generator->seed, regenerate);
+    inputRecorder->trackParameter("generator octaves", &generator->octaves, regenerate);
+    inputRecorder->trackParameter("generator frequency", &generator->frequency, regenerate);
+    inputRecorder->trackParameter("generator lacunarity", &generator->lacunarity, regenerate);
+    inputRecorder->trackParameter("generator gain", &generator->gain, regenerate);
+    inputRecorder->trackParameter("generator slope rock", &generator->slopeRock, regenerate);
+    inputRecorder->trackParameter("generator on GPU", &terrain->useGpuGenerator, regenerate);
+    TerrainSculptor* sculptor = terrain->getSculptor();
+    inputRecorder->trackParameter("sculpting", &sculptor->enabled);
+    inputRecorder->trackParameter("brush mode", &sculptor->mode);
+    inputRecorder->trackParameter("brush radius", &sculptor->radius);
+    inputRecorder->trackParameter("brush strength", &sculptor->strength);
+    inputRecorder->trackParameter("brush hardness", &sculptor->hardness);
+    inputRecorder->trackParameter("undo memory budget", &terrain->getHistory()->memoryBudgetMB);
+    TerrainErosion* erosion = terrain->getErosion();
+    inputRecorder->trackParameter("erosion running", &erosion->running);
+    inputRecorder->trackParameter("erosion iterations per frame", &erosion->iterationsPerFrame);
+    inputRecorder->trackParameter("erosion hydraulic", &erosion->hydraulic);
+    inputRecorder->trackParameter("erosion thermal", &erosion->thermal);
+    inputRecorder->trackParameter("erosion time step", &erosion->timeStep);
+    inputRecorder->trackParameter("erosion rain rate", &erosion->rainRate);
+    inputRecorder->trackParameter("erosion evaporation", &erosion->evaporation);
+    inputRecorder->trackParameter("erosion sediment capacity", &erosion->sedimentCapacity);
+    inputRecorder->trackParameter("erosion dissolving", &erosion->dissolving);
+    inputRecorder->trackParameter("erosion deposition", &erosion->deposition);
+    inputRecorder->trackParameter("erosion min tilt", &erosion->minTilt);
+    inputRecorder->trackParameter("erosion max depth", &erosion->maxErosionDepth);
+    inputRecorder->trackParameter("erosion talus angle", &erosion->talusAngle);
+    inputRecorder->trackParameter("erosion thermal rate", &erosion->thermalRate);
+    inputRecorder->trackParameter("wireframe", &wireFrameMode, [this]() { glPolygonMode(GL_FRONT_AND_BACK, wireFrameMode ? GL_LINE : GL_FILL); });
+    inputRecorder->trackParameter("render fog saved", &renderFogSaved);
+    inputRecorder->trackParameter("use anti-aliasing saved", &useAntiAliasingSaved);
+    inputRecorder->trackParameter("use anti-aliasing", &useAntiAliasing);
+    inputRecorder->trackParameter("luma threshold", &lumaThreshold);
+    inputRecorder->trackParameter("mul reduce", &mulReduce);
+    inputRecorder->trackParameter("min reduce", &minReduce);
+    inputRecorder->trackParameter("max span", &maxSpan);
+    inputRecorder->trackParameter("show light direction", &showLightDirection);
+    inputRecorder->trackParameter("reverse Z", &useReverseZ, [this]() { _setDepthConvention(isReverseZ()); });
+    inputRecorder->trackParameter("movement speed", &camera->movementSpeed);
+    inputRecorder->trackParameter("ground collision", &groundClamp->enabled);
+    inputRecorder->trackParameter("follow terrain", &groundClamp->followTerrain);
+    inputRecorder->trackParameter("ground clearance", &groundClamp->clearance);
+    inputRecorder->trackParameter("ground smoothing", &groundClamp->smoothing);
+    inputRecorder->trackParameter("light azimuth", &light->azimuth, [this]() { light->updateLightDir(); });
+    inputRecorder->trackParameter("light elevation", &light->elevation, [this]() { light->updateLightDir(); });
+    inputRecorder->trackParameter("light frustum size", &light->frustumSize);
+    inputRecorder->trackParameter("light near plane", &light->nearPlane);
+    inputRecorder->trackParameter("light far plane", &light->farPlane);
+    inputRecorder->trackParameter("light distance", &light->lightDistance);
+    inputRecorder->trackParameter("use shadow", &useShadow);
+    inputRecorder->trackParameter("use PCF", &usePCF);
+    inputRecorder->trackParameter("min shadow bias", &minShadowBias);
+    inputRecorder->trackParameter("max shadow bias", &maxShadowBias);
+    inputRecorder->trackParameter("num PCF samples", &numPCFSamples);
+    inputRecorder->trackParameter("PCF spreadness", &PCFSpreadness);
+    inputRecorder->trackParameter("render terrain", &renderTerrain);
+    inputRecorder->trackParameter("show ground", &terrain->showGround);
+    inputRecorder->trackParameter("use lighting", &terrain->useLighting);
+    inputRecorder->trackParameter("show normals", &terrain->showNormals);
+    inputRecorder->trackParameter("instanced grid", &terrain->useInstancedGrid);
+    inputRecorder->trackParameter("GPU culling", &terrain->useGpuCulling);
+    inputRecorder->trackParameter("occlusion culling", &terrain->useOcclusionCulling);
+    inputRecorder->trackParameter("horizon culling", &terrain->useHorizonCulling);
+    inputRecorder->trackParameter("build Hi-Z", &hiZBuffer->enabled);
+    inputRecorder->trackParameter("show viewshed", &terrain->showViewshed);
+    inputRecorder->trackParameter("viewshed follows camera", &terrain->getViewshed()->followCamera);
+    inputRecorder->trackParameter("viewshed observer height", &terrain->getViewshed()->observerHeight);
+    inputRecorder->trackParameter("viewshed target height", &terrain->getViewshed()->targetHeight);
+    auto updateTransform = [this]() { terrain->updateTransform(); };
+    inputRecorder->trackParameter("height offset", &terrain->heightOffset, updateTransform);
+    inputRecorder->trackParameter("height scale", &terrain->heightScale, updateTransform);
+    inputRecorder->trackParameter("horizontal scale", &terrain->horizontalScale, updateTransform);
+    inputRecorder->trackParameter("min tess level", &terrain->minTessLevel);
+    inputRecorder->trackParameter("max tess level", &terrain->maxTessLevel);
+    inputRecorder->trackParameter("min distance", &terrain->minDistance);
+    inputRecorder->trackParameter("max distance", &terrain->maxDistance);
+    inputRecorder->trackParameter("ambient strength", &terrain->ambientStrength);
+    inputRecorder->trackParameter("render water", &renderWater);
+    inputRecorder->trackParameter("use DUDV", &water->useDUDV);
+    inputRecorder->trackParameter("specular", &water->specular);
+    inputRecorder->trackParameter("use normal map", &water->useNormalMap);
+    inputRecorder->trackParameter("water level", &water->waterLevel);
+    inputRecorder->trackParameter("wave speed", &water->WAVE_SPEED);
+    inputRecorder->trackParameter("tiling factor", &water->tiling);
+    inputRecorder->trackParameter("render fog", &renderFog);
+    inputRecorder->trackParameter("fog color", &fog->fogColor);
+    inputRecorder->trackParameter("fog density", &fog->fogDensity);
+    inputRecorder->trackParameter("fog distance", &fog->fogDistance);
+    inputRecorder->trackParameter("layered fog", &fog->isLayeredFog);
+    inputRecorder->trackParameter("fog height", &fog->fogHeight);
+}
+
+void Context::update(GLFWwindow* window) {
+    terrain->syncGeneratedHeights();
+    terrain->updateErosion();
+    if (inputRecorder->isReplaying()) {
+        InputRecorder::Frame frame;
+        if (inputRecorder->replayFrame(frame)) {
+            deltaTime = frame.deltaTime;
+            elapsedTime += deltaTime;
+            lastTime = static_cast<float>(glfwGetTime());
+            for (const auto& event : frame.mouseEvents) {
+                if (event.isButton)
+                    _mouseButton(event.button, event.action, event.x, event.y, event.capturedByGui);
+                else
+                    _mouseMove(event.x, event.y);
+            }
+            inputRecorder->replayParameterChanges();
+            if (terrainResetPending) {
+                terrainResetPending = false;
+                terrain->resetTerrain(terrainNames[currentTerrainIdx]);
             }
+            applyKeyState(frame.keyMask);
+            _sculptTerrain();
+            return;
         }
+        inputRecorder->stopReplay();
     }
-    return true;
+
+    updateDeltaTime();
+    unsigned int keyMask = readKeyState(window);
+    inputRecorder->recordFrame(deltaTime, keyMask);
+    applyKeyState(keyMask);
+    _sculptTerrain();
+}
+
+void Context::_sculptTerrain() {
+    // one stamp per frame while the button is held, at the terrain under the cursor
+    if (!isSculpting)
+        return;
+    glm::vec3 position;
+    if (pickTerrain(cursorX, cursorY, position))
+        terrain->sculpt(position, deltaTime, isNewStroke);
+    isNewStroke = false;
+}
+
+void Context::undoTerrainEdit() {
+    // not part of the recorded input, a replay of the recording would diverge
+    if (inputRecorder->isRecording()) {
+        SPDLOG_WARN("Undo is not available while recording input");
+        return;
+    }
+    if (inputRecorder->isReplaying() || isSculpting)
+        return;
+    if (terrain->undoEdit())
+        SPDLOG_INFO("Undid a terrain edit, {} left", terrain->getHistory()->getNumUndoSteps());
+}
+
+void Context::redoTerrainEdit() {
+    if (inputRecorder->isRecording()) {
+        SPDLOG_WARN("Redo is not available while recording input");
+        return;
+    }
+    if (inputRecorder->isReplaying() || isSculpting)
+        return;
+    if (terrain->redoEdit())
+        SPDLOG_INFO("Redid a terrain edit, {} left", terrain->getHistory()->getNumRedoSteps());
+}
+
+void Context::clearErosionWater() {
+    // not part of the recorded input either
+    if (inputRecorder->isRecording()) {
+        SPDLOG_WARN("Clearing the water is not available while recording input");
+        return;
+    }
+    if (inputRecorder->isReplaying())
+        return;
+    terrain->getErosion()->invalidate();  // restarts from the eroded heights
+}
+
+void Context::restoreTerrain() {
+    if (inputRecorder->isRecording()) {
+        SPDLOG_WARN("Restoring the terrain is not available while recording input");
+        return;
+    }
+    if (inputRecorder->isReplaying() || isSculpting)
+        return;
+    terrain->resetTerrain(terrainNames[currentTerrainIdx]);
 }
 
 void Context::updateDeltaTime() {
-    float currentTime = static_cast<float>(glfwGetTime());
-    deltaTime = currentTime - lastTime;
-    lastTime = currentTime;
+    if (fixedDeltaTime > 0.0f) {
+        deltaTime = fixedDeltaTime;
+    }
+    else {
+        float currentTime = static_cast<float>(glfwGetTime());
+        deltaTime = currentTime - lastTime;
+        lastTime = currentTime;
+    }
+    elapsedTime += deltaTime;
+}
+
+bool Context::selectTerrain(const std::string& terrainName) {
+    for (int i = 0; i < terrainNames.size(); i++) {
+        if (terrainNames[i] != terrainName)
+            continue;
+        currentTerrainIdx = i;
+        currentTerrainName = terrainName;
+        SPDLOG_INFO("Selected terrain: {}", terrainName);
+        terrain->resetTerrain(terrainName);
+        return true;
+    }
+    SPDLOG_ERROR("Terrain not found: {}", terrainName);
+    return false;
+}
+
+namespace {
+// camera keys in the order of their bit in the key mask
+constexpr int CAMERA_KEYS[] = { GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_E, GLFW_KEY_Q, GLFW_KEY_R };
+}  // namespace
+
+unsigned int Context::readKeyState(GLFWwindow* window) {
+    unsigned int keyMask = 0;
+    for (int i = 0; i < std::size(CAMERA_KEYS); i++) {
+        if (glfwGetKey(window, CAMERA_KEYS[i]) == GLFW_PRESS)
+            keyMask |= 1u << i;
+    }
+    return keyMask;
 }
 
-void Context::processInput(GLFWwindow* window) {
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+void Context::applyKeyState(unsigned int keyMask) {
+    if (keyMask & (1u << 0))
         camera->processKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    if (keyMask & (1u << 1))
         camera->processKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    if (keyMask & (1u << 2))
         camera->processKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    if (keyMask & (1u << 3))
         camera->processKeyboard(RIGHT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
+    if (keyMask & (1u << 4))
         camera->processKeyboard(UP, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
+    if (keyMask & (1u << 5))
         camera->processKeyboard(DOWN, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
+    if (keyMask & (1u << 6))
         camera->rotateCamera(1.0f);  // rotate camera on y axis for demo
+    groundClamp->apply(camera.get(), terrain->getHeightfield(), deltaTime);
 }
 
 void Context::reshape(int width, int height) {
@@ -78,11 +347,36 @@ void Context::reshape(int width, int height) {
     glViewport(0, 0, width, height);
 
     // resize the framebuffers for post-processing
-    fogScreenBuffer->resizeFramebuffer(width, height);
-    antiAliasingScreenBuffer->resizeFramebuffer(width, height);
+    _updateRenderResolution();
+}
+
+void Context::_updateRenderResolution() {
+    renderWidth = std::max(1, (int)(width * dynamicResolution->scale));
+    renderHeight = std::max(1, (int)(height * dynamicResolution->scale));
+    fogScreenBuffer->resizeFramebuffer(renderWidth, renderHeight);
+    antiAliasingScreenBuffer->resizeFramebuffer(renderWidth, renderHeight);
 }
 
 void Context::mouseMove(double x, double y) {
+    // live input is ignored while a recording drives the camera
+    if (inputRecorder->isReplaying())
+        return;
+    inputRecorder->recordMouseMove(x, y);
+    _mouseMove(x, y);
+}
+
+void Context::mouseButton(int button, int action, double x, double y) {
+    if (inputRecorder->isReplaying())
+        return;
+    // the GUI's state at replay differs, whether it took the click is recorded with it
+    bool capturedByGui = ImGui::GetIO().WantCaptureMouse;
+    inputRecorder->recordMouseButton(button, action, x, y, capturedByGui);
+    _mouseButton(button, action, x, y, capturedByGui);
+}
+
+void Context::_mouseMove(double x, double y) {
+    cursorX = x;
+    cursorY = y;
     if (!cameraMouseControlActivated)
         return;
 
@@ -94,7 +388,7 @@ void Context::mouseMove(double x, double y) {
     camera->processMouseMovement(xoffset, yoffset);
 }
 
-void Context::mouseButton(int button, int action, double x, double y) {
+void Context::_mouseButton(int button, int action, double x, double y, bool capturedByGui) {
     if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS) {
         cameraMouseControlActivated = true;
         lastX = x;
@@ -103,31 +397,108 @@ void Context::mouseButton(int button, int action, double x, double y) {
     if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_RELEASE) {
         cameraMouseControlActivated = false;
     }
+    cursorX = x;
+    cursorY = y;
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE && isSculpting) {
+        isSculpting = false;
+        terrain->endSculptStroke();
+    }
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS && !capturedByGui
+        && terrain->getSculptor()->enabled) {
+        isSculpting = true;
+        isNewStroke = true;
+        return;
+    }
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS && !capturedByGui) {
+        hasPickedPosition = pickTerrain(x, y, pickedPosition);
+        if (hasPickedPosition)
+            SPDLOG_INFO("Picked terrain at ({:.2f}, {:.2f}, {:.2f})", pickedPosition.x, pickedPosition.y, pickedPosition.z);
+    }
+}
+
+bool Context::pickTerrain(double x, double y, glm::vec3& position) {
+    const TerrainRaycaster* raycaster = terrain->getRaycaster();
+    if (!raycaster)
+        return false;
+    // cursor coordinates are in window units, which differ from framebuffer pixels on HiDPI displays
+    ImVec2 windowSize = ImGui::GetIO().DisplaySize;
+    if (windowSize.x <= 0.0f || windowSize.y <= 0.0f)
+        windowSize = ImVec2((float)width, (float)height);
+    float ndcX = 2.0f * (float)x / windowSize.x - 1.0f;
+    float ndcY = 1.0f - 2.0f * (float)y / windowSize.y;
+    float tanHalfFov = std::tan(glm::radians(camera->zoom) / 2.0f);
+    float aspect = (float)width / (float)height;
+    TerrainRaycaster::Ray ray;
+    ray.origin = camera->position;
+    ray.direction = glm::normalize(camera->front + camera->right * (ndcX * tanHalfFov * aspect) + camera->up * (ndcY * tanHalfFov));
+    TerrainRaycaster::Hit hit = raycaster->intersect(ray);
+    if (hit.hit)
+        position = hit.position;
+    return hit.hit;
 }
 
 void Context::render() {
+    PROFILE_ZONE("Context::render");
+    dynamicResolution->beginFrame();
+    pipelineStatistics->beginFrame();
+    _updateViewshed();
     _renderToShadowFramebuffer();
     _renderToWaterFramebuffer();
     _renderToFogFramebuffer();
+    _buildHiZ();
     _renderToAntiAliasingScreenBuffer();
     _renderToScreen();
+
+    // capture the final image before the GUI is drawn on top
+    if (outputFramebuffer)
+        outputFramebuffer->bind(BindType::READ);
+    else
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    frameCapture->captureFrame(width, height, deltaTime);
+    pipelineStatistics->endFrame();
+    dynamicResolution->endFrame();
+
+    if (dynamicResolution->update())
+        _updateRenderResolution();
+}
+
+void Context::_updateViewshed() {
+    if (!terrain->showViewshed)
+        return;
+    if (terrain->getViewshed()->followCamera)
+        viewshedObserver = glm::vec2(camera->position.x, camera->position.z);
+    terrain->updateViewshed(viewshedObserver);
 }
 
 void Context::_renderToShadowFramebuffer() {
+    PROFILE_ZONE("Context::_renderToShadowFramebuffer");
     if (!useShadow)
         return;
 
+    GpuProfileScope profileScope(gpuProfiler.get(), "shadow");
+    currentPass = "shadow";
     depthMap->bind();
     isRenderingToDepthMap = true;
+    // the orthographic light keeps standard depth, the shadow lookup compares in [0, 1] from [-1, 1]
+    _setDepthConvention(false);
     glViewport(0, 0, depthMap->width, depthMap->height);
     glClear(GL_DEPTH_BUFFER_BIT);
     terrain->render();
     // water->render();
+    _setDepthConvention(isReverseZ());
     depthMap->unbind();
     isRenderingToDepthMap = false;
 }
 
+void Context::_setDepthConvention(bool reversed) {
+    if (isReverseZSupported)
+        glClipControl(GL_LOWER_LEFT, reversed ? GL_ZERO_TO_ONE : GL_NEGATIVE_ONE_TO_ONE);
+    glDepthFunc(reversed ? GL_GREATER : GL_LESS);
+    glClearDepth(reversed ? 0.0 : 1.0);
+}
+
 void Context::_renderToWaterFramebuffer() {
+    PROFILE_ZONE("Context::_renderToWaterFramebuffer");
     if (!renderWater)
         return;
 
@@ -135,6 +506,8 @@ void Context::_renderToWaterFramebuffer() {
     bool tempShowGround = terrain->showGround;
     terrain->showGround = false;
     // reflection
+    gpuProfiler->beginPass("reflection");
+    currentPass = "reflection";
     water->reflectionBuffer->bind();
     glViewport(0, 0, water->reflectionBuffer->width, water->reflectionBuffer->height);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -149,8 +522,11 @@ void Context::_renderToWaterFramebuffer() {
     camera->position.y += distance;
     camera->invertPitch();
     water->reflectionBuffer->unbind();
+    gpuProfiler->endPass();
 
     // refraction
+    gpuProfiler->beginPass("refraction");
+    currentPass = "refraction";
     water->refractionBuffer->bind();
     glViewport(0, 0, water->refractionBuffer->width, water->refractionBuffer->height);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -158,16 +534,20 @@ void Context::_renderToWaterFramebuffer() {
     terrain->render();
     skybox->render();
     water->refractionBuffer->unbind();
+    gpuProfiler->endPass();
     glDisable(GL_CLIP_DISTANCE0);
     terrain->showGround = tempShowGround;
 }
 
 void Context::_renderToFogFramebuffer() {
+    PROFILE_ZONE("Context::_renderToFogFramebuffer");
     if (!renderFog)
         return;
 
+    GpuProfileScope profileScope(gpuProfiler.get(), "fog scene");
+    currentPass = "fog scene";
     fogScreenBuffer->bind();
-    glViewport(0, 0, width, height);
+    glViewport(0, 0, renderWidth, renderHeight);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     terrain->render();
     water->render();
@@ -175,12 +555,33 @@ void Context::_renderToFogFramebuffer() {
     fogScreenBuffer->unbind();
 }
 
+void Context::_buildHiZ() {
+    PROFILE_ZONE("Context::_buildHiZ");
+    // only the fog scene pass leaves a depth texture behind
+    if (!hiZBuffer->enabled || !renderFog) {
+        hiZBuffer->invalidate();
+        return;
+    }
+
+    GpuProfileScope profileScope(gpuProfiler.get(), "hi-z");
+    if (wireFrameMode)
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    hiZBuffer->build(fogScreenBuffer.get(), getProjectionMatrix() * getViewMatrix(), isReverseZ());
+    if (wireFrameMode)
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+}
+
 void Context::_renderToAntiAliasingScreenBuffer() {
-    if (!useAntiAliasing)
+    PROFILE_ZONE("Context::_renderToAntiAliasingScreenBuffer");
+    // without fog or FXAA, a scaled scene still needs an intermediate buffer to be upscaled from
+    bool needsUpscale = dynamicResolution->enabled && !renderFog;
+    if (!useAntiAliasing && !needsUpscale)
         return;
 
+    GpuProfileScope profileScope(gpuProfiler.get(), "anti-aliasing");
+    currentPass = "anti-aliasing";
     antiAliasingScreenBuffer->bind();
-    glViewport(0, 0, width, height);
+    glViewport(0, 0, renderWidth, renderHeight);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     if (renderFog)
         fog->render();
@@ -193,7 +594,13 @@ void Context::_renderToAntiAliasingScreenBuffer() {
 }
 
 void Context::_renderToScreen() {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    PROFILE_ZONE("Context::_renderToScreen");
+    GpuProfileScope profileScope(gpuProfiler.get(), "screen");
+    currentPass = "screen";
+    if (outputFramebuffer)
+        outputFramebuffer->bind();
+    else
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glViewport(0, 0, width, height);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -204,7 +611,7 @@ void Context::_renderToScreen() {
             glBindVertexArray(screenQuadVAO);
             FXAAShader->use();
             FXAAShader->bindTexture("screenTexture", antiAliasingScreenBuffer.get());
-            FXAAShader->setVec2("u_texelStep", glm::vec2(1.0f / width, 1.0f / height));
+            FXAAShader->setVec2("u_texelStep", glm::vec2(1.0f / renderWidth, 1.0f / renderHeight));
             FXAAShader->setFloat("u_lumaThreshold", lumaThreshold);
             FXAAShader->setFloat("u_mulReduce", mulReduce);
             FXAAShader->setFloat("u_minReduce", minReduce);
@@ -220,11 +627,47 @@ void Context::_renderToScreen() {
         return;
     }
 
+    if (dynamicResolution->enabled) {
+        // simple bilinear upscale of the scaled scene to the window
+        antiAliasingScreenBuffer->bind(BindType::READ);
+        glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        if (outputFramebuffer)
+            outputFramebuffer->bind();
+        else
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return;
+    }
+
     terrain->render();
     water->render();
     skybox->render();
 }
 
+void Context::dumpCpuTrace() {
+    CpuProfiler::dumpChromeTrace(tracePath, traceFrames);
+}
+
+void Context::takeScreenshot() {
+    char filePath[64];
+    std::time_t now = std::time(nullptr);
+    std::strftime(filePath, sizeof(filePath), "screenshot_%Y%m%d_%H%M%S.png", std::localtime(&now));
+    frameCapture->requestScreenshot(filePath);
+}
+
+void Context::toggleVideoCapture() {
+    if (frameCapture->isRecordingVideo())
+        frameCapture->stopVideo();
+    else
+        frameCapture->startVideo((FrameCapture::Format)videoFormat, videoPath, videoFrameRate);
+}
+
+void Context::toggleInputRecording() {
+    if (inputRecorder->isRecording())
+        inputRecorder->stopRecording();
+    else
+        inputRecorder->startRecording(recordingPath);
+}
+
 glm::vec4 Context::getClipPlane() {
     if (isRenderingReflection)
         return glm::vec4(0.0f, 1.0f, 0.0f, -water->waterLevel);
@@ -237,11 +680,8 @@ void Context::renderGUI() {
         if (ImGui::BeginCombo("Terrain Selection", terrainNames[currentTerrainIdx].c_str())) {
             for (int i = 0; i < terrainNames.size(); i++) {
                 bool isSelected = (currentTerrainIdx == i);
-                if (ImGui::Selectable(terrainNames[i].c_str(), isSelected)) {
-                    currentTerrainIdx = i;
-                    SPDLOG_INFO("Selected terrain: {}", terrainNames[i]);
-                    terrain->resetTerrain(terrainNames[i]);
-                }
+                if (ImGui::Selectable(terrainNames[i].c_str(), isSelected))
+                    selectTerrain(terrainNames[i]);
                 if (isSelected)
                     ImGui::SetItemDefaultFocus();
             }
@@ -264,6 +704,44 @@ void Context::renderGUI() {
                 useAntiAliasing = false;  // disable post-processing
                 glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
             }
+            if (isReverseZSupported && ImGui::Checkbox("reverse-Z depth", &useReverseZ))
+                _setDepthConvention(isReverseZ());
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Camera")) {
+            ImGui::SliderFloat("movement speed", &camera->movementSpeed, 1.0f, 100.0f);
+            ImGui::Checkbox("ground collision", &groundClamp->enabled);
+            ImGui::SameLine();
+            ImGui::Checkbox("follow terrain", &groundClamp->followTerrain);
+            ImGui::SliderFloat("ground clearance", &groundClamp->clearance, 0.1f, 20.0f);
+            ImGui::SliderFloat("ground smoothing", &groundClamp->smoothing, 1.0f, 30.0f);
+            if (groundClamp->hasGround())
+                ImGui::Text("ground %.2f, %d height cache refreshes", groundClamp->getGroundHeight(), groundClamp->getNumRefreshes());
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Dynamic Resolution")) {
+            if (ImGui::Checkbox("use dynamic resolution", &dynamicResolution->enabled) && !dynamicResolution->enabled) {
+                dynamicResolution->reset();
+                _updateRenderResolution();
+            }
+            ImGui::SliderFloat("target frame time (ms)", &dynamicResolution->targetFrameTimeMs, 4.0f, 50.0f);
+            if (ImGui::SliderFloat("min scale", &dynamicResolution->minScale, 0.25f, dynamicResolution->maxScale))
+                dynamicResolution->scale = glm::max(dynamicResolution->scale, dynamicResolution->minScale);
+            if (ImGui::SliderFloat("max scale", &dynamicResolution->maxScale, dynamicResolution->minScale, 1.0f))
+                dynamicResolution->scale = glm::min(dynamicResolution->scale, dynamicResolution->maxScale);
+            ImGui::Text("gpu frame time: %.2f ms", dynamicResolution->getGPUFrameTime());
+            ImGui::Text("render resolution: %d x %d (%.0f%%)", renderWidth, renderHeight, dynamicResolution->scale * 100.0f);
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Hi-Z")) {
+            ImGui::Checkbox("build Hi-Z pyramid", &hiZBuffer->enabled);
+            if (hiZBuffer->isValid())
+                ImGui::Text("%d x %d, %d levels", hiZBuffer->getWidth(), hiZBuffer->getHeight(), hiZBuffer->getNumLevels());
+            else
+                ImGui::Text("not built (needs the fog scene depth)");
             ImGui::TreePop();
         }
 
@@ -300,6 +778,64 @@ void Context::renderGUI() {
             ImGui::TreePop();
         }
 
+        if (ImGui::TreeNode("CPU Profiler")) {
+            bool profilingEnabled = CpuProfiler::enabled;
+            if (ImGui::Checkbox("record zones", &profilingEnabled))
+                CpuProfiler::enabled = profilingEnabled;
+            ImGui::SliderInt("trace frames", &traceFrames, 1, CpuProfiler::MAX_FRAMES - 1);
+            ImGui::InputText("trace path", tracePath, sizeof(tracePath));
+            if (ImGui::Button("dump trace (F9)"))
+                dumpCpuTrace();
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Capture")) {
+            if (ImGui::Button("screenshot (F12)"))
+                takeScreenshot();
+            if (frameCapture->isRecordingVideo()) {
+                ImGui::Text("recording %d frames (%d dropped)", frameCapture->getNumVideoFrames(), frameCapture->getNumDroppedFrames());
+                if (ImGui::Button("stop video (F11)"))
+                    toggleVideoCapture();
+            }
+            else {
+                ImGui::RadioButton("PNG sequence", &videoFormat, (int)FrameCapture::Format::PNG_SEQUENCE);
+                ImGui::SameLine();
+                ImGui::RadioButton("Y4M", &videoFormat, (int)FrameCapture::Format::Y4M);
+                ImGui::InputText("video path", videoPath, sizeof(videoPath));
+                ImGui::SliderInt("frame rate", &videoFrameRate, 1, 120);
+                if (ImGui::Button("start video (F11)"))
+                    toggleVideoCapture();
+            }
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Input Recording")) {
+            ImGui::InputText("recording path", recordingPath, sizeof(recordingPath));
+            if (inputRecorder->isReplaying()) {
+                ImGui::Text("replaying frame %d / %d", inputRecorder->getReplayFrameIndex(), inputRecorder->getNumReplayFrames());
+                if (ImGui::Button("stop replay"))
+                    inputRecorder->stopReplay();
+            }
+            else {
+                if (ImGui::Button(inputRecorder->isRecording() ? "stop recording (F10)" : "start recording (F10)"))
+                    toggleInputRecording();
+                if (inputRecorder->isRecording()) {
+                    ImGui::SameLine();
+                    ImGui::Text("%d frames", inputRecorder->getNumRecordedFrames());
+                }
+                else {
+                    ImGui::SameLine();
+                    if (ImGui::Button("replay")) {
+                        auto speed = replayAtMaximumSpeed ? InputRecorder::PlaybackSpeed::MAXIMUM : InputRecorder::PlaybackSpeed::REALTIME;
+                        inputRecorder->startReplay(recordingPath, speed);
+                    }
+                    ImGui::SameLine();
+                    ImGui::Checkbox("maximum speed", &replayAtMaximumSpeed);
+                }
+            }
+            ImGui::TreePop();
+        }
+
         if (ImGui::CollapsingHeader("Terrain")) {
             ImGui::Checkbox("render terrain", &renderTerrain);
             ImGui::Checkbox("show ground", &terrain->showGround);
@@ -307,14 +843,143 @@ void Context::renderGUI() {
             ImGui::Checkbox("use lighting", &terrain->useLighting);
             ImGui::SameLine();
             ImGui::Checkbox("show normals", &terrain->showNormals);
-            ImGui::SliderFloat("height offset", &terrain->heightOffset, -5.0f, 5.0f);
-            ImGui::SliderFloat("height scale", &terrain->heightScale, 0.0f, 100.0f);
-            ImGui::SliderFloat("horizontal scale", &terrain->horizontalScale, 1.0f, 100.0f);
+            ImGui::Checkbox("instanced patch grid", &terrain->useInstancedGrid);
+            if (terrain->isGpuCullingSupported()) {
+                ImGui::Checkbox("GPU patch culling", &terrain->useGpuCulling);
+                ImGui::SameLine();
+                ImGui::Checkbox("occlusion (Hi-Z)", &terrain->useOcclusionCulling);
+            }
+            ImGui::Checkbox("CPU horizon culling (without GPU culling)", &terrain->useHorizonCulling);
+            const HorizonCuller* horizonCuller = terrain->getHorizonCuller();
+            ImGui::Text("last CPU cull: %d frustum, %d horizon culled of %d patches",
+                horizonCuller->getNumFrustumCulled(), horizonCuller->getNumHorizonCulled(), terrain->getNumPatches());
+            if (hasPickedPosition)
+                ImGui::Text("picked: (%.2f, %.2f, %.2f)", pickedPosition.x, pickedPosition.y, pickedPosition.z);
+            else
+                ImGui::Text("picked: none (left click on the terrain)");
+            bool transformChanged = ImGui::SliderFloat("height offset", &terrain->heightOffset, -5.0f, 5.0f);
+            transformChanged |= ImGui::SliderFloat("height scale", &terrain->heightScale, 0.0f, 100.0f);
+            transformChanged |= ImGui::SliderFloat("horizontal scale", &terrain->horizontalScale, 1.0f, 100.0f);
+            if (transformChanged)
+                terrain->updateTransform();
             ImGui::SliderInt("min tess level", &terrain->minTessLevel, 2, terrain->maxTessLevel - 1);
             ImGui::SliderInt("max tess level", &terrain->maxTessLevel, terrain->minTessLevel + 1, 64);
             ImGui::SliderFloat("min distance", &terrain->minDistance, 1.0f, terrain->maxDistance);
             ImGui::SliderFloat("max distance", &terrain->maxDistance, terrain->minDistance, 100.0f);
             ImGui::SliderFloat("ambient strength", &terrain->ambientStrength, 0.0f, 1.0f);
+            TerrainExporter* exporter = terrain->getExporter();
+            ImGui::InputText("export name", exportName, sizeof(exportName));
+            ImGui::SameLine();
+            if (ImGui::Button("export") && !terrain->exportTerrain(exportName))
+                SPDLOG_ERROR("Terrain export not started");
+            if (exporter->isExporting())
+                ImGui::ProgressBar(exporter->getProgress(), ImVec2(-1.0f, 0.0f), "exporting");
+        }
+
+        if (ImGui::CollapsingHeader("Procedural Terrain")) {
+            TerrainGenerator* generator = terrain->getGenerator();
+            bool changed = false;
+            changed |= ImGui::Combo("noise", &generator->noiseType, "fBm\0ridged multifractal\0");
+            ImGui::SliderInt("resolution", &generator->resolution, 256, 4096);
+            changed |= ImGui::IsItemDeactivatedAfterEdit();  // reallocates the textures, only on release
+            changed |= ImGui::InputInt("seed", &generator->seed);
+            changed |= ImGui::SliderInt("octaves", &generator->octaves, 1, TerrainGenerator::MAX_OCTAVES);
+            changed |= ImGui::SliderFloat("frequency", &generator->frequency, 0.5f, 16.0f);
+            changed |= ImGui::SliderFloat("lacunarity", &generator->lacunarity, 1.5f, 3.0f);
+            changed |= ImGui::SliderFloat("gain", &generator->gain, 0.2f, 0.8f);
+            changed |= ImGui::SliderFloat("slope rock", &generator->slopeRock, 0.0f, 1.0f);
+            if (terrain->isGpuGeneratorSupported())
+                changed |= ImGui::Checkbox("generate on GPU", &terrain->useGpuGenerator);
+            if (terrainNames[currentTerrainIdx] != Terrain::PROCEDURAL_TERRAIN) {
+                if (ImGui::Button("generate"))
+                    selectTerrain(Terrain::PROCEDURAL_TERRAIN);
+            } else {
+                if (changed) {
+                    terrain->resetTerrain(Terrain::PROCEDURAL_TERRAIN);
+                    generatorParityError = -1.0f;
+                }
+                if (terrain->isGeneratedOnGpu()) {
+                    ImGui::Text("%d x %d generated in %.2f ms on the GPU", generator->resolution, generator->resolution,
+                        terrain->getGpuGenerationTime());
+                    if (ImGui::Button("compare with CPU"))
+                        generatorParityError = terrain->measureGeneratorParity();
+                    if (generatorParityError >= 0.0f) {
+                        ImGui::SameLine();
+                        ImGui::Text("max error %.2e", generatorParityError);
+                    }
+                }
+                else
+                    ImGui::Text("%d x %d generated in %.1f ms", generator->resolution, generator->resolution,
+                        generator->getGenerationTime());
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Sculpting")) {
+            TerrainSculptor* sculptor = terrain->getSculptor();
+            ImGui::Checkbox("sculpt with the left mouse button", &sculptor->enabled);
+            ImGui::Combo("brush", &sculptor->mode, "raise\0lower\0smooth\0flatten\0");
+            ImGui::SliderFloat("brush radius (texels)", &sculptor->radius, 1.0f, 512.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+            ImGui::SliderFloat("brush strength", &sculptor->strength, 0.001f, 0.5f, "%.3f", ImGuiSliderFlags_Logarithmic);
+            ImGui::SliderFloat("brush hardness", &sculptor->hardness, 0.0f, 1.0f);
+            TerrainHistory* history = terrain->getHistory();
+            if (ImGui::Button("undo (ctrl+z)"))
+                undoTerrainEdit();
+            ImGui::SameLine();
+            if (ImGui::Button("redo (ctrl+y)"))
+                redoTerrainEdit();
+            ImGui::SameLine();
+            ImGui::Text("%d / %d steps", history->getNumUndoSteps(), history->getNumRedoSteps());
+            ImGui::SliderInt("undo memory budget (MB)", &history->memoryBudgetMB, 1, 1024, "%d", ImGuiSliderFlags_Logarithmic);
+            ImGui::Text("undo history: %.1f MB in memory, %.1f MB spilled to disk",
+                history->getMemoryUsage() / (1024.0f * 1024.0f), history->getSpilledBytes() / (1024.0f * 1024.0f));
+        }
+
+        if (ImGui::CollapsingHeader("Erosion")) {
+            TerrainErosion* erosion = terrain->getErosion();
+            ImGui::Checkbox("run erosion", &erosion->running);
+            ImGui::SameLine();
+            if (ImGui::Button("clear water"))
+                clearErosionWater();
+            ImGui::SameLine();
+            if (ImGui::Button("restore terrain"))
+                restoreTerrain();
+            ImGui::SliderInt("iterations per frame", &erosion->iterationsPerFrame, 1, 32);
+            ImGui::Checkbox("hydraulic", &erosion->hydraulic);
+            ImGui::SameLine();
+            ImGui::Checkbox("thermal", &erosion->thermal);
+            ImGui::SliderFloat("time step", &erosion->timeStep, 0.001f, 0.05f, "%.3f");
+            ImGui::SliderFloat("rain rate", &erosion->rainRate, 0.0f, 0.1f, "%.3f");
+            ImGui::SliderFloat("evaporation", &erosion->evaporation, 0.0f, 1.0f);
+            ImGui::SliderFloat("sediment capacity", &erosion->sedimentCapacity, 0.0f, 4.0f);
+            ImGui::SliderFloat("dissolving (per s)", &erosion->dissolving, 0.0f, 50.0f);
+            ImGui::SliderFloat("deposition (per s)", &erosion->deposition, 0.0f, 50.0f);
+            ImGui::SliderFloat("min tilt", &erosion->minTilt, 0.0f, 0.5f);
+            ImGui::SliderFloat("max erosion depth", &erosion->maxErosionDepth, 0.1f, 10.0f);
+            ImGui::SliderFloat("talus angle", &erosion->talusAngle, 0.0f, 89.0f);
+            ImGui::SliderFloat("thermal rate", &erosion->thermalRate, 0.0f, 1.0f);
+            if (erosion->isReady())
+                ImGui::Text("iteration %d, last %d in %.1f ms", erosion->getIteration(), erosion->iterationsPerFrame,
+                    erosion->getStepTime());
+        }
+
+        if (ImGui::CollapsingHeader("Viewshed")) {
+            Viewshed* viewshed = terrain->getViewshed();
+            ImGui::Checkbox("show viewshed", &terrain->showViewshed);
+            ImGui::Checkbox("observer follows camera", &viewshed->followCamera);
+            if (hasPickedPosition) {
+                ImGui::SameLine();
+                if (ImGui::Button("observer at picked point")) {
+                    viewshed->followCamera = false;
+                    viewshedObserver = glm::vec2(pickedPosition.x, pickedPosition.z);
+                }
+            }
+            ImGui::SliderFloat("observer height", &viewshed->observerHeight, 0.0f, 20.0f);
+            ImGui::SliderFloat("target height", &viewshed->targetHeight, 0.0f, 10.0f);
+            if (viewshed->isValid()) {
+                glm::vec3 observer = viewshed->getObserverPosition();
+                ImGui::Text("observer (%.1f, %.1f, %.1f): %.1f%% visible, computed in %.1f ms",
+                    observer.x, observer.y, observer.z, viewshed->getVisibleFraction() * 100.0f, viewshed->getComputeTime());
+            }
         }
 
         if (ImGui::CollapsingHeader("Water")) {
@@ -332,12 +997,18 @@ void Context::renderGUI() {
             ImGui::Checkbox("render fog", &renderFog);
             ImGui::ColorEdit3("fog color", glm::value_ptr(fog->fogColor));
             ImGui::SliderFloat("fog density", &fog->fogDensity, 0.0f, 2.5f);
+            ImGui::SliderFloat("fog distance", &fog->fogDistance, 1.0f, 500.0f);
             ImGui::Checkbox("layered fog", &fog->isLayeredFog);
             ImGui::SliderFloat("fog height", &fog->fogHeight, 1.0f, 10.0f);
         }
     }
     ImGui::End();
 
+    gpuProfiler->renderGUI();
+    pipelineStatistics->renderGUI();
+
+    inputRecorder->recordParameterChanges();
+
     // ImGui::SetNextWindowCollapsed(true, ImGuiCond_FirstUseEver);
     // if (ImGui::Begin("Depth Map")) {
     //     ImVec2 contentSize = ImGui::GetContentRegionAvail();
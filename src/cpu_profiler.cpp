@@ -0,0 +1,140 @@
+#include "cpu_profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+
+namespace {
+
+struct ThreadBuffer {
+    std::vector<CpuProfiler::Event> events;
+    std::atomic<uint64_t> writeIndex{ 0 };
+    uint32_t threadId = 0;
+    std::string threadName;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    uint64_t frameStarts[CpuProfiler::MAX_FRAMES] = { 0 };
+    std::atomic<uint64_t> frameCount{ 0 };
+};
+
+Registry& getRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+ThreadBuffer& getThreadBuffer() {
+    // the registry keeps the buffer alive, so events of finished threads can still be dumped
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (!buffer) {
+        buffer = std::make_shared<ThreadBuffer>();
+        buffer->events.resize(CpuProfiler::EVENTS_PER_THREAD);
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        buffer->threadId = registry.buffers.size();
+        buffer->threadName = "thread " + std::to_string(buffer->threadId);
+        registry.buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+std::string escapeJSON(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+}  // namespace
+
+std::atomic<bool> CpuProfiler::enabled{ true };
+
+uint64_t CpuProfiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CpuProfiler::record(const char* name, uint64_t startNs, uint64_t endNs) {
+    ThreadBuffer& buffer = getThreadBuffer();
+    uint64_t index = buffer.writeIndex.load(std::memory_order_relaxed);
+    buffer.events[index % EVENTS_PER_THREAD] = Event{ name, startNs, endNs, buffer.threadId };
+    buffer.writeIndex.store(index + 1, std::memory_order_release);
+}
+
+void CpuProfiler::markFrame() {
+    Registry& registry = getRegistry();
+    uint64_t frame = registry.frameCount.load(std::memory_order_relaxed);
+    registry.frameStarts[frame % MAX_FRAMES] = now();
+    registry.frameCount.store(frame + 1, std::memory_order_release);
+}
+
+void CpuProfiler::setThreadName(const std::string& name) {
+    ThreadBuffer& buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> lock(getRegistry().mutex);
+    buffer.threadName = name;
+}
+
+std::vector<CpuProfiler::Event> CpuProfiler::getEvents(int numFrames) {
+    Registry& registry = getRegistry();
+    uint64_t frameCount = registry.frameCount.load(std::memory_order_acquire);
+    numFrames = std::min<uint64_t>({ (uint64_t)numFrames, frameCount, (uint64_t)MAX_FRAMES - 1 });
+    uint64_t windowStart = numFrames > 0 ? registry.frameStarts[(frameCount - numFrames) % MAX_FRAMES] : 0;
+
+    std::vector<Event> events;
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const auto& buffer : registry.buffers) {
+        // the owning thread may still be writing; skip the slots it could overwrite next
+        uint64_t writeIndex = buffer->writeIndex.load(std::memory_order_acquire);
+        uint64_t available = std::min<uint64_t>(writeIndex, EVENTS_PER_THREAD - 64);
+        // zones are recorded when they end, so end times only grow within a buffer
+        for (uint64_t i = writeIndex; i > writeIndex - available; i--) {
+            const Event& event = buffer->events[(i - 1) % EVENTS_PER_THREAD];
+            if (event.endNs < windowStart)
+                break;
+            if (event.startNs >= windowStart)
+                events.push_back(event);
+        }
+    }
+    std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+        return a.startNs < b.startNs;
+    });
+    return events;
+}
+
+bool CpuProfiler::dumpChromeTrace(const std::string& filePath, int numFrames) {
+    std::vector<Event> events = getEvents(numFrames);
+    std::ofstream file(filePath);
+    if (!file.is_open()) {
+        SPDLOG_ERROR("Failed to open trace file: {}", filePath);
+        return false;
+    }
+
+    // Chrome trace event format, readable by chrome://tracing and ui.perfetto.dev
+    uint64_t origin = events.empty() ? 0 : events.front().startNs;
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    const char* separator = "\n";
+    {
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (const auto& buffer : registry.buffers) {
+            file << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->threadId
+                << ",\"args\":{\"name\":\"" << escapeJSON(buffer->threadName) << "\"}}";
+            separator = ",\n";
+        }
+    }
+    for (const Event& event : events) {
+        file << separator << "{\"name\":\"" << escapeJSON(event.name) << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0"
+            << ",\"tid\":" << event.threadId
+            << ",\"ts\":" << (event.startNs - origin) / 1000.0
+            << ",\"dur\":" << (event.endNs - event.startNs) / 1000.0 << "}";
+        separator = ",\n";
+    }
+    file << "\n]}\n";
+    SPDLOG_INFO("CPU trace saved: {} ({} events)", filePath, events.size());
+    return true;
+}
@@ -0,0 +1,83 @@
+#include "dynamic_resolution.h"
+#include <cmath>
+
+std::unique_ptr<DynamicResolution> DynamicResolution::create() {
+    auto dynamicResolution = std::unique_ptr<DynamicResolution>(new DynamicResolution());
+    dynamicResolution->init();
+    return std::move(dynamicResolution);
+}
+
+DynamicResolution::~DynamicResolution() {
+    glDeleteQueries(NUM_QUERY_FRAMES, startQueries);
+    glDeleteQueries(NUM_QUERY_FRAMES, endQueries);
+}
+
+void DynamicResolution::init() {
+    glGenQueries(NUM_QUERY_FRAMES, startQueries);
+    glGenQueries(NUM_QUERY_FRAMES, endQueries);
+}
+
+void DynamicResolution::beginFrame() {
+    // the slot was used NUM_QUERY_FRAMES frames ago, so its result is usually ready by now
+    int slot = frameIndex % NUM_QUERY_FRAMES;
+    collectQueryResult(slot);
+    glQueryCounter(startQueries[slot], GL_TIMESTAMP);
+}
+
+void DynamicResolution::endFrame() {
+    int slot = frameIndex % NUM_QUERY_FRAMES;
+    glQueryCounter(endQueries[slot], GL_TIMESTAMP);
+    isQueryPending[slot] = true;
+    frameIndex++;
+}
+
+void DynamicResolution::collectQueryResult(int slot) {
+    if (!isQueryPending[slot])
+        return;
+    isQueryPending[slot] = false;
+
+    // never wait for the GPU: a result that is not ready yet is simply dropped
+    GLint available = 0;
+    glGetQueryObjectiv(endQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+
+    GLuint64 startTime = 0;
+    GLuint64 endTime = 0;
+    glGetQueryObjectui64v(startQueries[slot], GL_QUERY_RESULT, &startTime);
+    glGetQueryObjectui64v(endQueries[slot], GL_QUERY_RESULT, &endTime);
+    float frameTimeMs = (endTime - startTime) / 1000000.0f;
+
+    // exponential moving average to smooth out single slow frames
+    gpuFrameTimeMs = hasSample ? glm::mix(gpuFrameTimeMs, frameTimeMs, 0.1f) : frameTimeMs;
+    hasSample = true;
+}
+
+bool DynamicResolution::update() {
+    framesSinceAdjust++;
+    if (!enabled || !hasSample || framesSinceAdjust < adjustInterval)
+        return false;
+
+    float error = (gpuFrameTimeMs - targetFrameTimeMs) / targetFrameTimeMs;
+    if (std::abs(error) < tolerance)
+        return false;
+
+    // frame time is roughly proportional to the number of pixels, i.e. to scale^2
+    float newScale = scale * std::sqrt(targetFrameTimeMs / gpuFrameTimeMs);
+    newScale = std::round(newScale / scaleStep) * scaleStep;
+    newScale = glm::clamp(newScale, minScale, maxScale);
+    if (std::abs(newScale - scale) < 0.5f * scaleStep)
+        return false;
+
+    SPDLOG_INFO("Dynamic resolution: gpu frame time {:.2f} ms, scale {:.2f} -> {:.2f}", gpuFrameTimeMs, scale, newScale);
+    scale = newScale;
+    framesSinceAdjust = 0;
+    hasSample = false;  // wait for measurements taken at the new resolution
+    return true;
+}
+
+void DynamicResolution::reset() {
+    scale = 1.0f;
+    framesSinceAdjust = 0;
+    hasSample = false;
+}
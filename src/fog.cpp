@@ -24,8 +24,8 @@ void Fog::render() {
 
     fogShader->setVec3("fogColor", fogColor);
     fogShader->setFloat("fogDensity", fogDensity);
-    fogShader->setFloat("nearPlane", 0.1f);
-    fogShader->setFloat("farPlane", 10.0f);
+    fogShader->setFloat("fogDistance", fogDistance);
+    fogShader->setBool("reverseZ", context->isReverseZ());
 
     view = context->getViewMatrix();
     projection = context->getProjectionMatrix();
@@ -0,0 +1,166 @@
+#include "frame_capture.h"
+#include "cpu_profiler.h"
+#include <cmath>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+namespace {
+// encoded frames allowed in flight before capture waits for the encoder
+constexpr size_t MAX_QUEUED_FRAMES = 8;
+}  // namespace
+
+std::unique_ptr<FrameCapture> FrameCapture::create() {
+    auto frameCapture = std::unique_ptr<FrameCapture>(new FrameCapture());
+    frameCapture->readback = AsyncReadback::create(3);
+    frameCapture->imageEncoder = ThreadPool::create(2);
+    frameCapture->videoEncoder = ThreadPool::create(1);
+    return std::move(frameCapture);
+}
+
+FrameCapture::~FrameCapture() {
+    stopVideo();
+    readback->flush();
+    imageEncoder->wait();
+}
+
+void FrameCapture::logToStderr() {
+    // a Y4M stream owns stdout, so keep log messages out of it
+    auto logger = spdlog::get("stderr");
+    spdlog::set_default_logger(logger ? logger : spdlog::stderr_color_mt("stderr"));
+}
+
+void FrameCapture::requestScreenshot(const std::string& filePath) {
+    screenshotPath = filePath;
+}
+
+bool FrameCapture::startVideo(Format format, const std::string& path, int frameRate) {
+    if (recordingVideo)
+        stopVideo();
+
+    if (format == Format::Y4M) {
+        if (path == "-") {
+            logToStderr();  // usually done by main before anything was logged
+            videoFile = stdout;
+        }
+        else {
+            videoFile = std::fopen(path.c_str(), "wb");
+        }
+        if (!videoFile) {
+            SPDLOG_ERROR("Failed to open video output: {}", path);
+            return false;
+        }
+    }
+    videoFormat = format;
+    videoPath = path;
+    videoFrameRate = frameRate;
+    videoWidth = 0;
+    videoHeight = 0;
+    numVideoFrames = 0;
+    videoTime = 0.0;
+    numDroppedFrames = 0;
+    recordingVideo = true;
+    SPDLOG_INFO("Video capture started: {}", path);
+    return true;
+}
+
+void FrameCapture::stopVideo() {
+    if (!recordingVideo)
+        return;
+    recordingVideo = false;
+    readback->flush();
+    imageEncoder->wait();
+    videoEncoder->wait();
+    if (videoFile) {
+        std::fflush(videoFile);
+        if (videoFile != stdout)
+            std::fclose(videoFile);
+        videoFile = nullptr;
+    }
+    SPDLOG_INFO("Video capture finished: {} frames ({} dropped) -> {}", numVideoFrames, numDroppedFrames.load(), videoPath);
+}
+
+void FrameCapture::captureFrame(int width, int height, float deltaTime) {
+    PROFILE_FUNCTION();
+    if (!screenshotPath.empty()) {
+        readback->request(width, height, [this, filePath = screenshotPath](std::vector<uint8_t>&& pixels, int width, int height) {
+            imageEncoder->submit([filePath, pixels = std::move(pixels), width, height]() {
+                if (writeReadbackPNG(filePath, pixels, width, height))
+                    SPDLOG_INFO("Screenshot saved: {}", filePath);
+            });
+        });
+        screenshotPath.clear();
+    }
+
+    if (recordingVideo) {
+        // a Y4M stream has a fixed frame size, frames after a resize are dropped
+        if (videoWidth == 0) {
+            videoWidth = width;
+            videoHeight = height;
+            if (videoFormat == Format::Y4M) {
+                videoEncoder->submit([this, width, height]() {
+                    std::fprintf(videoFile, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, videoFrameRate);
+                });
+            }
+        }
+        else {
+            videoTime += deltaTime;
+        }
+        // the video frames due until now are filled with this one: none when rendering faster than the
+        // frame rate, several when slower
+        int numCopies = (int)std::floor(videoTime * videoFrameRate) + 1 - numVideoFrames;
+        if (videoFormat == Format::Y4M && (width != videoWidth || height != videoHeight)) {
+            numDroppedFrames++;
+        }
+        else if (numCopies > 0) {
+            int firstIndex = numVideoFrames;
+            numVideoFrames += numCopies;
+            readback->request(width, height, [this, firstIndex, numCopies](std::vector<uint8_t>&& pixels, int width, int height) {
+                if (videoFormat == Format::Y4M) {
+                    videoEncoder->waitForPendingBelow(MAX_QUEUED_FRAMES);
+                    videoEncoder->submit([this, pixels = std::move(pixels), width, height, numCopies]() {
+                        writeY4MFrame(pixels, width, height, numCopies);
+                    });
+                }
+                else {
+                    auto sharedPixels = std::make_shared<const std::vector<uint8_t>>(std::move(pixels));
+                    for (int i = 0; i < numCopies; i++) {
+                        char suffix[16];
+                        std::snprintf(suffix, sizeof(suffix), "_%06d.png", firstIndex + i);
+                        imageEncoder->waitForPendingBelow(MAX_QUEUED_FRAMES);
+                        imageEncoder->submit([filePath = videoPath + suffix, sharedPixels, width, height]() {
+                            writeReadbackPNG(filePath, *sharedPixels, width, height);
+                        });
+                    }
+                }
+            });
+        }
+    }
+
+    // mapping only finished slots keeps the GPU and the copy overlapped
+    readback->poll();
+}
+
+void FrameCapture::writeY4MFrame(const std::vector<uint8_t>& pixels, int width, int height, int numCopies) {
+    PROFILE_FUNCTION();
+    // BT.601 limited range, planar 4:4:4, rows top-down
+    size_t planeSize = (size_t)width * height;
+    std::vector<uint8_t> planes(planeSize * 3);
+    uint8_t* yPlane = planes.data();
+    uint8_t* uPlane = yPlane + planeSize;
+    uint8_t* vPlane = uPlane + planeSize;
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = pixels.data() + (size_t)(height - 1 - y) * width * 3;
+        size_t offset = (size_t)y * width;
+        for (int x = 0; x < width; x++) {
+            int r = row[3 * x];
+            int g = row[3 * x + 1];
+            int b = row[3 * x + 2];
+            yPlane[offset + x] = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            uPlane[offset + x] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            vPlane[offset + x] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+    for (int i = 0; i < numCopies; i++) {
+        std::fputs("FRAME\n", videoFile);
+        std::fwrite(planes.data(), 1, planes.size(), videoFile);
+    }
+}
@@ -0,0 +1,253 @@
+#include "gpu_profiler.h"
+#include <algorithm>
+#include <cfloat>
+#include <fstream>
+#include <imgui.h>
+
+std::unique_ptr<GpuProfiler> GpuProfiler::create() {
+    auto profiler = std::unique_ptr<GpuProfiler>(new GpuProfiler());
+    profiler->passes.push_back(PassHistory{ "total" });
+    profiler->passes[TOTAL_PASS_INDEX].samples.resize(profiler->historySize);
+    return std::move(profiler);
+}
+
+GpuProfiler::~GpuProfiler() {
+    for (auto& frameQueries : frames) {
+        if (!frameQueries.queries.empty())
+            glDeleteQueries(frameQueries.queries.size(), frameQueries.queries.data());
+    }
+}
+
+void GpuProfiler::beginFrame() {
+    if (!enabled)
+        return;
+
+    // read back the frame that used this slot NUM_QUERY_FRAMES frames ago
+    FrameQueries& frameQueries = frames[frameIndex % NUM_QUERY_FRAMES];
+    collectFrame(frameQueries);
+    frameQueries.numUsed = 0;
+    frameQueries.frame = frameIndex;
+    isInFrame = true;
+}
+
+void GpuProfiler::endFrame() {
+    if (!isInFrame)
+        return;
+    if (isPassActive)
+        endPass();
+
+    frames[frameIndex % NUM_QUERY_FRAMES].pending = true;
+    frameIndex++;
+    isInFrame = false;
+}
+
+void GpuProfiler::flush() {
+    // waits for the GPU; meant for the end of a benchmark, not for the render loop
+    glFinish();
+    for (int i = 0; i < NUM_QUERY_FRAMES; i++)
+        collectFrame(frames[(frameIndex + i) % NUM_QUERY_FRAMES]);
+}
+
+void GpuProfiler::setHistorySize(int size) {
+    historySize = size;
+    for (auto& pass : passes) {
+        pass.samples.assign(historySize, Sample{ 0, 0.0f });
+        pass.next = 0;
+        pass.count = 0;
+    }
+}
+
+void GpuProfiler::beginPass(const std::string& name) {
+    if (!isInFrame)
+        return;
+    if (isPassActive) {
+        SPDLOG_ERROR("GPU profiler pass '{}' started while another pass is active", name);
+        return;
+    }
+
+    int passIndex = findPass(name);
+    if (passIndex < 0) {
+        passes.push_back(PassHistory{ name });
+        passes.back().samples.resize(historySize);
+        passIndex = passes.size() - 1;
+    }
+
+    FrameQueries& frameQueries = frames[frameIndex % NUM_QUERY_FRAMES];
+    if (frameQueries.numUsed == (int)frameQueries.queries.size()) {
+        unsigned int query;
+        glGenQueries(1, &query);
+        frameQueries.queries.push_back(query);
+        frameQueries.passIndices.push_back(passIndex);
+    }
+    frameQueries.passIndices[frameQueries.numUsed] = passIndex;
+    glBeginQuery(GL_TIME_ELAPSED, frameQueries.queries[frameQueries.numUsed]);
+    frameQueries.numUsed++;
+    isPassActive = true;
+}
+
+void GpuProfiler::endPass() {
+    if (!isPassActive)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    isPassActive = false;
+}
+
+void GpuProfiler::collectFrame(FrameQueries& frameQueries) {
+    if (!frameQueries.pending)
+        return;
+    frameQueries.pending = false;
+
+    // results become available in order, so checking the last query is enough
+    GLint available = 0;
+    if (frameQueries.numUsed > 0)
+        glGetQueryObjectiv(frameQueries.queries[frameQueries.numUsed - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;  // drop the frame rather than waiting for the GPU
+
+    float totalMs = 0.0f;
+    for (int i = 0; i < frameQueries.numUsed; i++) {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(frameQueries.queries[i], GL_QUERY_RESULT, &elapsed);
+        float timeMs = elapsed / 1000000.0f;
+        addSample(frameQueries.passIndices[i], frameQueries.frame, timeMs);
+        totalMs += timeMs;
+    }
+    addSample(TOTAL_PASS_INDEX, frameQueries.frame, totalMs);
+}
+
+void GpuProfiler::addSample(int passIndex, int frame, float timeMs) {
+    PassHistory& pass = passes[passIndex];
+    // a pass may run several times per frame; accumulate into the same sample
+    int last = (pass.next + historySize - 1) % historySize;
+    if (pass.count > 0 && pass.samples[last].frame == frame) {
+        pass.samples[last].timeMs += timeMs;
+        return;
+    }
+    pass.samples[pass.next] = Sample{ frame, timeMs };
+    pass.next = (pass.next + 1) % historySize;
+    pass.count = std::min(pass.count + 1, historySize);
+}
+
+int GpuProfiler::findPass(const std::string& name) const {
+    for (int i = 0; i < (int)passes.size(); i++) {
+        if (passes[i].name == name)
+            return i;
+    }
+    return -1;
+}
+
+std::vector<float> GpuProfiler::getSortedSamples(int passIndex) const {
+    const PassHistory& pass = passes[passIndex];
+    std::vector<float> values;
+    values.reserve(pass.count);
+    for (int i = 0; i < pass.count; i++)
+        values.push_back(pass.samples[i].timeMs);
+    std::sort(values.begin(), values.end());
+    return values;
+}
+
+float GpuProfiler::getAverage(const std::string& name) const {
+    int passIndex = findPass(name);
+    if (passIndex < 0 || passes[passIndex].count == 0)
+        return 0.0f;
+    const PassHistory& pass = passes[passIndex];
+    float sum = 0.0f;
+    for (int i = 0; i < pass.count; i++)
+        sum += pass.samples[i].timeMs;
+    return sum / pass.count;
+}
+
+float GpuProfiler::getPercentile(const std::string& name, float percentile) const {
+    int passIndex = findPass(name);
+    if (passIndex < 0 || passes[passIndex].count == 0)
+        return 0.0f;
+    return getPercentileOfSorted(getSortedSamples(passIndex), percentile);
+}
+
+float GpuProfiler::getPercentileOfSorted(const std::vector<float>& values, float percentile) {
+    int rank = glm::clamp((int)(percentile / 100.0f * values.size()), 0, (int)values.size() - 1);
+    return values[rank];
+}
+
+std::vector<std::string> GpuProfiler::getPassNames() const {
+    std::vector<std::string> names;
+    for (const auto& pass : passes)
+        names.push_back(pass.name);
+    return names;
+}
+
+bool GpuProfiler::dumpCSV(const std::string& filePath) const {
+    std::ofstream file(filePath);
+    if (!file.is_open()) {
+        SPDLOG_ERROR("Failed to open GPU profile file: {}", filePath);
+        return false;
+    }
+
+    // long format: one row per frame and pass, oldest samples first
+    file << "frame,pass,gpu_ms\n";
+    for (const auto& pass : passes) {
+        int first = (pass.next - pass.count + historySize) % historySize;
+        for (int i = 0; i < pass.count; i++) {
+            const Sample& sample = pass.samples[(first + i) % historySize];
+            file << sample.frame << "," << pass.name << "," << sample.timeMs << "\n";
+        }
+    }
+    SPDLOG_INFO("GPU profile saved: {}", filePath);
+    return true;
+}
+
+void GpuProfiler::renderGUI() {
+    ImGui::SetNextWindowPos(ImVec2(420.0f, 20.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(360.0f, 0.0f), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("GPU Profiler")) {
+        ImGui::Checkbox("enable profiling", &enabled);
+
+        if (ImGui::BeginTable("passes", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("pass");
+            ImGui::TableSetupColumn("avg (ms)");
+            ImGui::TableSetupColumn("p50");
+            ImGui::TableSetupColumn("p95");
+            ImGui::TableSetupColumn("p99");
+            ImGui::TableHeadersRow();
+            for (int i = 0; i < (int)passes.size(); i++) {
+                std::vector<float> values = getSortedSamples(i);
+                if (values.empty())
+                    continue;
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                if (ImGui::Selectable(passes[i].name.c_str(), selectedPass == i, ImGuiSelectableFlags_SpanAllColumns))
+                    selectedPass = i;
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", getAverage(passes[i].name));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", getPercentileOfSorted(values, 50.0f));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", getPercentileOfSorted(values, 95.0f));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", getPercentileOfSorted(values, 99.0f));
+            }
+            ImGui::EndTable();
+        }
+
+        // distribution of the selected pass over the history window
+        std::vector<float> values = getSortedSamples(selectedPass);
+        if (!values.empty()) {
+            constexpr int NUM_BUCKETS = 24;
+            float minValue = values.front();
+            float maxValue = std::max(values.back(), minValue + 0.001f);
+            float buckets[NUM_BUCKETS] = { 0.0f };
+            for (float value : values) {
+                int bucket = (int)((value - minValue) / (maxValue - minValue) * (NUM_BUCKETS - 1));
+                buckets[bucket] += 1.0f;
+            }
+            std::string label = passes[selectedPass].name + " (" + std::to_string(minValue).substr(0, 5)
+                + " - " + std::to_string(maxValue).substr(0, 5) + " ms)";
+            ImGui::PlotHistogram("##histogram", buckets, NUM_BUCKETS, 0, label.c_str(), 0.0f, FLT_MAX, ImVec2(0.0f, 80.0f));
+        }
+
+        ImGui::InputText("csv path", csvPath, sizeof(csvPath));
+        if (ImGui::Button("dump CSV"))
+            dumpCSV(csvPath);
+    }
+    ImGui::End();
+}
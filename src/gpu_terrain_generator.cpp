@@ -0,0 +1,159 @@
+#include "gpu_terrain_generator.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+
+namespace {
+constexpr int GROUP_SIZE = 16;        // local_size_x/y of the 2D passes
+constexpr int BOUNDS_GROUP_SIZE = 64; // local_size_x of shader_terrain_bounds.comp
+
+int numGroups(int count, int groupSize) {
+    return (count + groupSize - 1) / groupSize;
+}
+}
+
+std::unique_ptr<GpuTerrainGenerator> GpuTerrainGenerator::create() {
+    // compute shaders and image load/store are core in 4.3
+    if (!GLAD_GL_VERSION_4_3) {
+        SPDLOG_INFO("GPU terrain generation needs OpenGL 4.3, generating on the CPU only");
+        return nullptr;
+    }
+    auto generator = std::unique_ptr<GpuTerrainGenerator>(new GpuTerrainGenerator());
+    if (!generator->init())
+        return nullptr;
+    return std::move(generator);
+}
+
+bool GpuTerrainGenerator::init() {
+    noiseShader = std::make_unique<Shader>("../shaders/terrain/shader_terrain_generate.comp");
+    minMaxShader = std::make_unique<Shader>("../shaders/terrain/shader_terrain_minmax.comp");
+    finalizeShader = std::make_unique<Shader>("../shaders/terrain/shader_terrain_finalize.comp");
+    gradientShader = std::make_unique<Shader>("../shaders/terrain/shader_terrain_gradient.comp");
+    boundsShader = std::make_unique<Shader>("../shaders/terrain/shader_terrain_bounds.comp");
+    glGenQueries(1, &timerQuery);
+    return true;
+}
+
+GpuTerrainGenerator::~GpuTerrainGenerator() {
+    glDeleteTextures(1, &rawHeights);
+    glDeleteTextures(1, &minMaxPyramid);
+    glDeleteQueries(1, &timerQuery);
+}
+
+void GpuTerrainGenerator::resize(int size) {
+    if (size == this->size)
+        return;
+    this->size = size;
+    glDeleteTextures(1, &rawHeights);
+    glDeleteTextures(1, &minMaxPyramid);
+
+    glGenTextures(1, &rawHeights);
+    glBindTexture(GL_TEXTURE_2D, rawHeights);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, size, size);
+
+    // halving down to 1x1, odd sizes round up
+    int levelSize = (size + 1) / 2;
+    numLevels = 1;
+    while ((levelSize >> (numLevels - 1)) > 1)
+        numLevels++;
+    glGenTextures(1, &minMaxPyramid);
+    glBindTexture(GL_TEXTURE_2D, minMaxPyramid);
+    glTexStorage2D(GL_TEXTURE_2D, numLevels, GL_RG32F, levelSize, levelSize);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GpuTerrainGenerator::generate(const TerrainGenerator& generator, unsigned int heightMap, unsigned int diffuseMap,
+    unsigned int gradientMap, unsigned int patchBounds, int gridSize) {
+    PROFILE_FUNCTION();
+    getGenerationTime();  // collects the previous timer before the query object is reused
+    bool startTimer = !timerPending;
+    if (startTimer)
+        glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+
+    resize(generator.resolution);
+    int size = generator.resolution;
+    int groups = numGroups(size, GROUP_SIZE);
+
+    noiseShader->use();
+    noiseShader->setInt("size", size);
+    noiseShader->setInt("noiseType", generator.noiseType);
+    noiseShader->setInt("seed", generator.seed);
+    noiseShader->setInt("octaves", generator.octaves);
+    noiseShader->setFloat("frequency", generator.frequency);
+    noiseShader->setFloat("lacunarity", generator.lacunarity);
+    noiseShader->setFloat("gain", generator.gain);
+    glBindImageTexture(0, rawHeights, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glDispatchCompute(groups, groups, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    // min/max pyramid; level 0 reduces the heights, every further level the one before
+    minMaxShader->use();
+    glBindImageTexture(0, rawHeights, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    int sourceSize = size;
+    for (int level = 0; level < numLevels; level++) {
+        int targetSize = (sourceSize + 1) / 2;
+        minMaxShader->setBool("fromHeights", level == 0);
+        minMaxShader->setInt("sourceSize", sourceSize);
+        minMaxShader->setInt("targetSize", targetSize);
+        glBindImageTexture(1, minMaxPyramid, std::max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+        glBindImageTexture(2, minMaxPyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+        glDispatchCompute(numGroups(targetSize, GROUP_SIZE), numGroups(targetSize, GROUP_SIZE), 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        sourceSize = targetSize;
+    }
+
+    finalizeShader->use();
+    finalizeShader->setInt("size", size);
+    finalizeShader->setFloat("slopeRock", generator.slopeRock);
+    glBindImageTexture(0, rawHeights, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, minMaxPyramid, numLevels - 1, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+    glBindImageTexture(2, heightMap, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glBindImageTexture(3, diffuseMap, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+    glDispatchCompute(groups, groups, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    gradientShader->use();
+    glBindImageTexture(0, heightMap, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, gradientMap, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16F);
+    glDispatchCompute(groups, groups, 1);
+
+    if (patchBounds != 0 && gridSize > 0) {
+        // the level where a patch spans a few texels per side
+        int patchTexels = size / gridSize + 3;
+        int level = 0;
+        while (level + 1 < numLevels && (patchTexels >> (level + 1)) > 4)
+            level++;
+        boundsShader->use();
+        boundsShader->setInt("gridSize", gridSize);
+        boundsShader->setInt("size", size);
+        boundsShader->setInt("levelShift", level + 1);
+        glBindImageTexture(0, minMaxPyramid, level, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+        glBindImageTexture(1, minMaxPyramid, numLevels - 1, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, patchBounds);
+        glDispatchCompute(numGroups(gridSize * gridSize, BOUNDS_GROUP_SIZE), 1, 1);
+    }
+
+    // the textures are sampled by the terrain passes and may be read back; the bounds feed the culler
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    glBindTexture(GL_TEXTURE_2D, diffuseMap);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (startTimer) {
+        glEndQuery(GL_TIME_ELAPSED);
+        timerPending = true;
+    }
+}
+
+float GpuTerrainGenerator::getGenerationTime() {
+    if (timerPending) {
+        GLint available = 0;
+        glGetQueryObjectiv(timerQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &elapsed);
+            generationTime = elapsed / 1000000.0f;
+            timerPending = false;
+        }
+    }
+    return generationTime;
+}
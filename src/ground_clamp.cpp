@@ -0,0 +1,76 @@
+#include "ground_clamp.h"
+#include <algorithm>
+
+namespace {
+constexpr float MIN_CLEARANCE = 0.1f;  // the near plane must stay above the unfiltered ground
+}
+
+std::unique_ptr<GroundClamp> GroundClamp::create() {
+    auto groundClamp = std::unique_ptr<GroundClamp>(new GroundClamp());
+    groundClamp->patch.resize(PATCH_SIZE * PATCH_SIZE);
+    return std::move(groundClamp);
+}
+
+bool GroundClamp::isInPatch(int x, int y) const {
+    // the bilinear footprint (x, y)..(x + 1, y + 1) keeps the margin, except towards the terrain border
+    glm::ivec2 low = glm::ivec2(patchOrigin.x == 0 ? 0 : patchOrigin.x + PATCH_MARGIN,
+        patchOrigin.y == 0 ? 0 : patchOrigin.y + PATCH_MARGIN);
+    glm::ivec2 patchEnd = patchOrigin + patchSize;
+    glm::ivec2 high = glm::ivec2(patchEnd.x == terrainSize.x ? patchEnd.x - 1 : patchEnd.x - 1 - PATCH_MARGIN,
+        patchEnd.y == terrainSize.y ? patchEnd.y - 1 : patchEnd.y - 1 - PATCH_MARGIN);
+    return x >= low.x && y >= low.y && std::min(x + 1, terrainSize.x - 1) <= high.x && std::min(y + 1, terrainSize.y - 1) <= high.y;
+}
+
+void GroundClamp::refreshPatch(const Heightfield* heightfield, int x, int y) {
+    terrainSize = glm::ivec2(heightfield->getWidth(), heightfield->getHeight());
+    patchSize = glm::min(glm::ivec2(PATCH_SIZE), terrainSize);
+    patchOrigin = glm::clamp(glm::ivec2(x, y) - PATCH_SIZE / 2, glm::ivec2(0), terrainSize - patchSize);
+    for (int row = 0; row < patchSize.y; row++) {
+        for (int column = 0; column < patchSize.x; column++)
+            patch[row * PATCH_SIZE + column] = heightfield->getSample(patchOrigin.x + column, patchOrigin.y + row);
+    }
+    patchRevision = heightfield->getRevision();
+    numRefreshes++;
+}
+
+float GroundClamp::samplePatch(float x, float y) const {
+    float localX = std::clamp(x - patchOrigin.x, 0.0f, patchSize.x - 1.0f);
+    float localY = std::clamp(y - patchOrigin.y, 0.0f, patchSize.y - 1.0f);
+    int x0 = (int)localX;
+    int y0 = (int)localY;
+    int x1 = std::min(x0 + 1, patchSize.x - 1);
+    int y1 = std::min(y0 + 1, patchSize.y - 1);
+    float h0 = glm::mix(patch[y0 * PATCH_SIZE + x0], patch[y0 * PATCH_SIZE + x1], localX - x0);
+    float h1 = glm::mix(patch[y1 * PATCH_SIZE + x0], patch[y1 * PATCH_SIZE + x1], localX - x0);
+    return glm::mix(h0, h1, localY - y0);
+}
+
+void GroundClamp::apply(Camera* camera, const Heightfield* heightfield, float deltaTime) {
+    if (!enabled || !heightfield || !heightfield->contains(camera->position.x, camera->position.z)) {
+        groundValid = false;  // start from the actual ground when it comes back
+        return;
+    }
+
+    // texel coordinates under the camera, as in Heightfield::getHeight
+    int width = heightfield->getWidth();
+    int height = heightfield->getHeight();
+    float horizontalScale = heightfield->getHorizontalScale();
+    float texelX = std::clamp(camera->position.x * width / horizontalScale + width * 0.5f - 0.5f, 0.0f, width - 1.0f);
+    float texelY = std::clamp(camera->position.z * height / horizontalScale + height * 0.5f - 0.5f, 0.0f, height - 1.0f);
+    if (patchRevision != heightfield->getRevision() || !isInPatch((int)texelX, (int)texelY))
+        refreshPatch(heightfield, (int)texelX, (int)texelY);
+    float ground = samplePatch(texelX, texelY) * heightfield->getHeightScale() + heightfield->getHeightOffset();
+
+    if (!groundValid)
+        smoothedGround = ground;
+    else {
+        // exponential filter, independent of the frame rate; climbing reacts faster than descending
+        float rate = ground > smoothedGround ? 4.0f * smoothing : smoothing;
+        smoothedGround += (ground - smoothedGround) * (1.0f - std::exp(-rate * deltaTime));
+    }
+    groundValid = true;
+
+    float minHeight = std::max(smoothedGround + clearance, ground + MIN_CLEARANCE);
+    if (followTerrain || camera->position.y < minHeight)
+        camera->position.y = minHeight;
+}
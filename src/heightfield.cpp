@@ -0,0 +1,209 @@
+#include "heightfield.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+#include <atomic>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HEIGHTFIELD_SSE
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define HEIGHTFIELD_NEON
+#endif
+
+namespace {
+// the few four-wide operations the batched queries need
+#if defined(HEIGHTFIELD_SSE)
+using float4 = __m128;
+inline float4 load4(const float* p) { return _mm_loadu_ps(p); }
+inline void store4(float* p, float4 a) { _mm_storeu_ps(p, a); }
+inline float4 set4(float a) { return _mm_set1_ps(a); }
+inline float4 add4(float4 a, float4 b) { return _mm_add_ps(a, b); }
+inline float4 sub4(float4 a, float4 b) { return _mm_sub_ps(a, b); }
+inline float4 mul4(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+inline float4 clamp4(float4 a, float4 lo, float4 hi) { return _mm_min_ps(_mm_max_ps(a, lo), hi); }
+// truncation is the floor for the non-negative texel coordinates
+inline float4 floor4(float4 a, int* ints) {
+    __m128i i = _mm_cvttps_epi32(a);
+    _mm_storeu_si128((__m128i*)ints, i);
+    return _mm_cvtepi32_ps(i);
+}
+#elif defined(HEIGHTFIELD_NEON)
+using float4 = float32x4_t;
+inline float4 load4(const float* p) { return vld1q_f32(p); }
+inline void store4(float* p, float4 a) { vst1q_f32(p, a); }
+inline float4 set4(float a) { return vdupq_n_f32(a); }
+inline float4 add4(float4 a, float4 b) { return vaddq_f32(a, b); }
+inline float4 sub4(float4 a, float4 b) { return vsubq_f32(a, b); }
+inline float4 mul4(float4 a, float4 b) { return vmulq_f32(a, b); }
+inline float4 clamp4(float4 a, float4 lo, float4 hi) { return vminq_f32(vmaxq_f32(a, lo), hi); }
+inline float4 floor4(float4 a, int* ints) {
+    int32x4_t i = vcvtq_s32_f32(a);
+    vst1q_s32(ints, i);
+    return vcvtq_f32_s32(i);
+}
+#else
+struct float4 { float v[4]; };
+inline float4 load4(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+inline void store4(float* p, float4 a) { std::copy(a.v, a.v + 4, p); }
+inline float4 set4(float a) { return { { a, a, a, a } }; }
+inline float4 add4(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+inline float4 sub4(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+inline float4 mul4(float4 a, float4 b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+inline float4 clamp4(float4 a, float4 lo, float4 hi) {
+    for (int i = 0; i < 4; i++) a.v[i] = std::min(std::max(a.v[i], lo.v[i]), hi.v[i]);
+    return a;
+}
+inline float4 floor4(float4 a, int* ints) {
+    for (int i = 0; i < 4; i++) { ints[i] = (int)a.v[i]; a.v[i] = (float)ints[i]; }
+    return a;
+}
+#endif
+}
+
+uint64_t Heightfield::nextRevision() {
+    static std::atomic<uint64_t> numRevisions(0);
+    return ++numRevisions;
+}
+
+std::unique_ptr<Heightfield> Heightfield::create(const std::vector<float>& samples, int width, int height) {
+    PROFILE_FUNCTION();
+    if (width <= 0 || height <= 0 || samples.size() < (size_t)width * height) {
+        SPDLOG_ERROR("Invalid heightfield samples: {}x{}", width, height);
+        return nullptr;
+    }
+    auto heightfield = std::unique_ptr<Heightfield>(new Heightfield());
+    heightfield->revision = nextRevision();
+    heightfield->width = width;
+    heightfield->height = height;
+    heightfield->numTilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int numTilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    // partial tiles at the right and top borders are padded, the padding is never read
+    heightfield->samples.assign((size_t)heightfield->numTilesX * numTilesY * TILE_SIZE * TILE_SIZE, 0.0f);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++)
+            heightfield->samples[heightfield->index(x, y)] = samples[(size_t)y * width + x];
+    }
+    return std::move(heightfield);
+}
+
+void Heightfield::update(const std::vector<float>& samples, const TexelRegion& region) {
+    PROFILE_FUNCTION();
+    for (int y = region.y0; y < region.y1; y++) {
+        for (int x = region.x0; x < region.x1; x++)
+            this->samples[index(x, y)] = samples[(size_t)y * width + x];
+    }
+    revision = nextRevision();
+}
+
+void Heightfield::setTransform(float horizontalScale, float heightScale, float heightOffset) {
+    this->horizontalScale = horizontalScale;
+    this->heightScale = heightScale;
+    this->heightOffset = heightOffset;
+}
+
+float Heightfield::sampleTexels(float x, float y) const {
+    x = std::clamp(x, 0.0f, width - 1.0f);
+    y = std::clamp(y, 0.0f, height - 1.0f);
+    int x0 = (int)x;
+    int y0 = (int)y;
+    int x1 = std::min(x0 + 1, width - 1);
+    int y1 = std::min(y0 + 1, height - 1);
+    float fx = x - x0;
+    float fy = y - y0;
+    float h0 = glm::mix(samples[index(x0, y0)], samples[index(x1, y0)], fx);
+    float h1 = glm::mix(samples[index(x0, y1)], samples[index(x1, y1)], fx);
+    return glm::mix(h0, h1, fy);
+}
+
+float Heightfield::getNormalizedHeight(float u, float v) const {
+    // texel centers are at (i + 0.5) / size; clamping to them avoids the repeat wrap at the borders
+    return sampleTexels(u * width - 0.5f, v * height - 0.5f);
+}
+
+float Heightfield::getHeight(float x, float z) const {
+    return getNormalizedHeight(x / horizontalScale + 0.5f, z / horizontalScale + 0.5f) * heightScale + heightOffset;
+}
+
+glm::vec3 Heightfield::getNormal(float x, float z) const {
+    // central differences one texel apart, close to the Sobel gradient the terrain shader uses
+    float dx = horizontalScale / width;
+    float dz = horizontalScale / height;
+    float slopeX = (getHeight(x + dx, z) - getHeight(x - dx, z)) / (2.0f * dx);
+    float slopeZ = (getHeight(x, z + dz) - getHeight(x, z - dz)) / (2.0f * dz);
+    return glm::normalize(glm::vec3(-slopeX, 1.0f, -slopeZ));
+}
+
+bool Heightfield::contains(float x, float z) const {
+    float halfSize = horizontalScale * 0.5f;
+    return x >= -halfSize && x <= halfSize && z >= -halfSize && z <= halfSize;
+}
+
+void Heightfield::getHeights4(const float* x, const float* z, float* heights) const {
+    // world to texel coordinates, the inverse of the model matrix of Terrain::render
+    float4 texelX = add4(mul4(load4(x), set4(width / horizontalScale)), set4(width * 0.5f - 0.5f));
+    float4 texelY = add4(mul4(load4(z), set4(height / horizontalScale)), set4(height * 0.5f - 0.5f));
+    texelX = clamp4(texelX, set4(0.0f), set4(width - 1.0f));
+    texelY = clamp4(texelY, set4(0.0f), set4(height - 1.0f));
+    alignas(16) int x0[4];
+    alignas(16) int y0[4];
+    float4 fx = sub4(texelX, floor4(texelX, x0));
+    float4 fy = sub4(texelY, floor4(texelY, y0));
+
+    // the corner loads are scattered, the interpolation is not
+    alignas(16) float h00[4], h10[4], h01[4], h11[4];
+    for (int i = 0; i < 4; i++) {
+        int x1 = std::min(x0[i] + 1, width - 1);
+        int y1 = std::min(y0[i] + 1, height - 1);
+        h00[i] = samples[index(x0[i], y0[i])];
+        h10[i] = samples[index(x1, y0[i])];
+        h01[i] = samples[index(x0[i], y1)];
+        h11[i] = samples[index(x1, y1)];
+    }
+    float4 bottom = add4(load4(h00), mul4(sub4(load4(h10), load4(h00)), fx));
+    float4 top = add4(load4(h01), mul4(sub4(load4(h11), load4(h01)), fx));
+    float4 sample = add4(bottom, mul4(sub4(top, bottom), fy));
+    store4(heights, add4(mul4(sample, set4(heightScale)), set4(heightOffset)));
+}
+
+void Heightfield::getHeights(const float* x, const float* z, float* heights, size_t count) const {
+    PROFILE_FUNCTION();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        getHeights4(x + i, z + i, heights + i);
+    if (i == count)
+        return;
+    // pad the tail to a full group
+    float tailX[4] = {}, tailZ[4] = {}, tailHeights[4];
+    std::copy(x + i, x + count, tailX);
+    std::copy(z + i, z + count, tailZ);
+    getHeights4(tailX, tailZ, tailHeights);
+    std::copy(tailHeights, tailHeights + (count - i), heights + i);
+}
+
+void Heightfield::getNormals(const float* x, const float* z, glm::vec3* normals, size_t count) const {
+    PROFILE_FUNCTION();
+    float dx = horizontalScale / width;
+    float dz = horizontalScale / height;
+    for (size_t i = 0; i < count; i += 4) {
+        size_t groupSize = std::min<size_t>(4, count - i);
+        float groupX[4] = {}, groupZ[4] = {};
+        std::copy(x + i, x + i + groupSize, groupX);
+        std::copy(z + i, z + i + groupSize, groupZ);
+        float leftX[4], rightX[4], backZ[4], frontZ[4];
+        store4(leftX, sub4(load4(groupX), set4(dx)));
+        store4(rightX, add4(load4(groupX), set4(dx)));
+        store4(backZ, sub4(load4(groupZ), set4(dz)));
+        store4(frontZ, add4(load4(groupZ), set4(dz)));
+        float left[4], right[4], back[4], front[4];
+        getHeights4(leftX, groupZ, left);
+        getHeights4(rightX, groupZ, right);
+        getHeights4(groupX, backZ, back);
+        getHeights4(groupX, frontZ, front);
+        float slopeX[4], slopeZ[4];
+        store4(slopeX, mul4(sub4(load4(right), load4(left)), set4(0.5f / dx)));
+        store4(slopeZ, mul4(sub4(load4(front), load4(back)), set4(0.5f / dz)));
+        for (size_t j = 0; j < groupSize; j++)
+            normals[i + j] = glm::normalize(glm::vec3(-slopeX[j], 1.0f, -slopeZ[j]));
+    }
+}
@@ -0,0 +1,87 @@
+#include "hiz_buffer.h"
+#include "geometry_primitives.h"
+#include "utils.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+
+std::unique_ptr<HiZBuffer> HiZBuffer::create() {
+    auto hiZBuffer = std::unique_ptr<HiZBuffer>(new HiZBuffer());
+    hiZBuffer->init();
+    return std::move(hiZBuffer);
+}
+
+void HiZBuffer::init() {
+    shader = std::make_unique<Shader>(
+        "../shaders/shader_hiz.vs",
+        "../shaders/shader_hiz.fs"
+    );
+    screenQuadVAO = generatePositionTextureVAO(screenQuadVertices, sizeof(screenQuadVertices));
+    glGenFramebuffers(1, &FBO);
+    glGenTextures(1, &texture);
+}
+
+HiZBuffer::~HiZBuffer() {
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteTextures(1, &texture);
+}
+
+void HiZBuffer::resize(int width, int height) {
+    this->width = width;
+    this->height = height;
+    numLevels = 1 + (int)std::floor(std::log2((float)std::max(width, height)));
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    int levelWidth = width;
+    int levelHeight = height;
+    for (int level = 0; level < numLevels; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, levelWidth, levelHeight, 0, GL_RED, GL_FLOAT, NULL);
+        levelWidth = std::max(1, levelWidth / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void HiZBuffer::build(const Framebuffer* sceneBuffer, const glm::mat4& viewProjection, bool reverseZ) {
+    PROFILE_FUNCTION();
+    if (sceneBuffer->width != width || sceneBuffer->height != height)
+        resize(sceneBuffer->width, sceneBuffer->height);
+    this->viewProjection = viewProjection;
+    this->reverseZ = reverseZ;
+
+    glDisable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glBindVertexArray(screenQuadVAO);
+    shader->use();
+    shader->setBool("reverseZ", reverseZ);
+
+    // level 0 copies the depth buffer; every other level reduces the one above it, which is made the
+    // only visible level of the texture so that sampling it while rendering to the next is well defined
+    int levelWidth = width;
+    int levelHeight = height;
+    for (int level = 0; level < numLevels; level++) {
+        bool copyDepth = level == 0;
+        if (copyDepth)
+            shader->bindTexture("sourceTexture", sceneBuffer->depthTexture, 0);
+        else {
+            shader->bindTexture("sourceTexture", texture, 0);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        }
+        shader->setBool("copyDepth", copyDepth);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, level);
+        glViewport(0, 0, levelWidth, levelHeight);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        levelWidth = std::max(1, levelWidth / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glEnable(GL_DEPTH_TEST);
+    valid = true;
+}
@@ -0,0 +1,148 @@
+#include "horizon_culler.h"
+#include "utils.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HORIZON_SSE
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define HORIZON_NEON
+#endif
+
+std::unique_ptr<HorizonCuller> HorizonCuller::create(int numColumns) {
+    auto culler = std::unique_ptr<HorizonCuller>(new HorizonCuller());
+    culler->numColumns = numColumns;
+    culler->horizon.resize(numColumns);
+    return std::move(culler);
+}
+
+bool HorizonCuller::_isBelowHorizon(int begin, int end, float top) const {
+    // hidden only if every covered column is at or above the chunk's top
+    int i = begin;
+#if defined(HORIZON_SSE)
+    __m128 top4 = _mm_set1_ps(top);
+    for (; i + 4 <= end; i += 4) {
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(&horizon[i]), top4)))
+            return false;
+    }
+#elif defined(HORIZON_NEON)
+    float32x4_t top4 = vdupq_n_f32(top);
+    for (; i + 4 <= end; i += 4) {
+        if (vmaxvq_u32(vcltq_f32(vld1q_f32(&horizon[i]), top4)))
+            return false;
+    }
+#endif
+    for (; i < end; i++) {
+        if (horizon[i] < top)
+            return false;
+    }
+    return true;
+}
+
+void HorizonCuller::_raiseHorizon(int begin, int end, float height) {
+    int i = begin;
+#if defined(HORIZON_SSE)
+    __m128 height4 = _mm_set1_ps(height);
+    for (; i + 4 <= end; i += 4)
+        _mm_storeu_ps(&horizon[i], _mm_max_ps(_mm_loadu_ps(&horizon[i]), height4));
+#elif defined(HORIZON_NEON)
+    float32x4_t height4 = vdupq_n_f32(height);
+    for (; i + 4 <= end; i += 4)
+        vst1q_f32(&horizon[i], vmaxq_f32(vld1q_f32(&horizon[i]), height4));
+#endif
+    for (; i < end; i++)
+        horizon[i] = std::max(horizon[i], height);
+}
+
+void HorizonCuller::cull(const std::vector<Chunk>& chunks, const glm::mat4& viewProjection, const glm::vec3& cameraPosition,
+    bool useHorizon, std::vector<unsigned int>& visibleChunks) {
+    PROFILE_FUNCTION();
+    visibleChunks.clear();
+    numFrustumCulled = 0;
+    numHorizonCulled = 0;
+    std::fill(horizon.begin(), horizon.end(), -1.0f);  // bottom of the screen
+
+    glm::vec4 planes[6];
+    extractFrustumPlanes(viewProjection, planes);
+
+    // front to back by the horizontal distance to the nearest point of each chunk
+    order.clear();
+    for (unsigned int i = 0; i < chunks.size(); i++) {
+        const Chunk& chunk = chunks[i];
+        glm::vec2 nearest = glm::clamp(glm::vec2(cameraPosition.x, cameraPosition.z),
+            glm::vec2(chunk.boundsMin.x, chunk.boundsMin.z), glm::vec2(chunk.boundsMax.x, chunk.boundsMax.z));
+        glm::vec2 offset = nearest - glm::vec2(cameraPosition.x, cameraPosition.z);
+        order.emplace_back(glm::dot(offset, offset), i);
+    }
+    std::sort(order.begin(), order.end());
+
+    for (const auto& [distance, index] : order) {
+        const Chunk& chunk = chunks[index];
+        bool isInFrustum = true;
+        for (const auto& plane : planes) {
+            // the corner farthest along the plane normal
+            glm::vec3 corner(plane.x >= 0.0f ? chunk.boundsMax.x : chunk.boundsMin.x,
+                plane.y >= 0.0f ? chunk.boundsMax.y : chunk.boundsMin.y,
+                plane.z >= 0.0f ? chunk.boundsMax.z : chunk.boundsMin.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+                isInFrustum = false;
+                break;
+            }
+        }
+        if (!isInFrustum) {
+            numFrustumCulled++;
+            continue;
+        }
+        if (!useHorizon) {
+            visibleChunks.push_back(index);
+            continue;
+        }
+
+        // screen footprint of the whole box, and of its top face at the minimum height (the occluder)
+        float left = FLT_MAX, right = -FLT_MAX, top = -FLT_MAX;
+        float occluderLeft = FLT_MAX, occluderRight = -FLT_MAX, occluderTop = FLT_MAX;
+        bool isProjectable = true;
+        for (int i = 0; i < 8; i++) {
+            glm::vec3 corner((i & 1) ? chunk.boundsMax.x : chunk.boundsMin.x,
+                (i & 2) ? chunk.boundsMax.y : chunk.boundsMin.y,
+                (i & 4) ? chunk.boundsMax.z : chunk.boundsMin.z);
+            glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+            if (clip.w <= 0.0f) {
+                isProjectable = false;  // crosses the camera plane, always visible
+                break;
+            }
+            float x = (clip.x / clip.w * 0.5f + 0.5f) * numColumns;
+            float y = clip.y / clip.w;
+            left = std::min(left, x);
+            right = std::max(right, x);
+            top = std::max(top, y);
+            if (!(i & 2)) {
+                occluderLeft = std::min(occluderLeft, x);
+                occluderRight = std::max(occluderRight, x);
+                occluderTop = std::min(occluderTop, y);
+            }
+        }
+        if (!isProjectable) {
+            visibleChunks.push_back(index);
+            continue;
+        }
+
+        // any column the box touches has to hide it
+        int begin = std::clamp((int)std::floor(left), 0, numColumns);
+        int end = std::clamp((int)std::ceil(right), 0, numColumns);
+        if (begin < end && _isBelowHorizon(begin, end, top)) {
+            numHorizonCulled++;
+            continue;
+        }
+        visibleChunks.push_back(index);
+
+        // only columns the occluder covers completely are raised
+        int occluderBegin = std::clamp((int)std::ceil(occluderLeft), 0, numColumns);
+        int occluderEnd = std::clamp((int)std::floor(occluderRight), 0, numColumns);
+        if (occluderBegin < occluderEnd)
+            _raiseHorizon(occluderBegin, occluderEnd, occluderTop);
+    }
+}
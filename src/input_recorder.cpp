@@ -0,0 +1,365 @@
+#include "input_recorder.h"
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+namespace {
+constexpr char MAGIC[4] = { 'M', 'T', 'R', 'C' };
+// 1 recorded the initial state after the first frame's input, 2 had no strings, 3 no GUI capture of the buttons
+constexpr uint32_t VERSION = 4;
+}  // namespace
+
+std::unique_ptr<InputRecorder> InputRecorder::create() {
+    return std::unique_ptr<InputRecorder>(new InputRecorder());
+}
+
+InputRecorder::~InputRecorder() {
+    stopRecording();
+}
+
+int InputRecorder::getValueSize(ParameterType type) {
+    switch (type) {
+        case ParameterType::FLOAT: return sizeof(float);
+        case ParameterType::INT: return sizeof(int32_t);
+        case ParameterType::BOOL: return sizeof(bool);
+        case ParameterType::VEC3: return 3 * sizeof(float);
+        case ParameterType::STRING: return 0;  // variable, see writeValue
+    }
+    return 0;
+}
+
+void InputRecorder::addParameter(const std::string& name, ParameterType type, void* value, std::function<void()> onReplay, bool initialOnly) {
+    Parameter parameter{ name, type, value, onReplay, initialOnly };
+    parameters.push_back(parameter);
+    updateLastValue(parameters.back());
+}
+
+bool InputRecorder::updateLastValue(Parameter& parameter) {
+    bool changed = !parameter.hasLastValue;
+    if (parameter.type == ParameterType::STRING) {
+        const std::string& value = *static_cast<const std::string*>(parameter.value);
+        changed |= value != parameter.lastString;
+        parameter.lastString = value;
+    }
+    else {
+        int size = getValueSize(parameter.type);
+        changed |= std::memcmp(parameter.lastValue, parameter.value, size) != 0;
+        std::memcpy(parameter.lastValue, parameter.value, size);
+    }
+    parameter.hasLastValue = true;
+    return changed;
+}
+
+void InputRecorder::writeValue(const Parameter& parameter) {
+    if (parameter.type == ParameterType::STRING) {
+        const std::string& value = *static_cast<const std::string*>(parameter.value);
+        write((uint16_t)value.size());
+        recordBuffer.insert(recordBuffer.end(), value.begin(), value.end());
+        return;
+    }
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(parameter.value);
+    recordBuffer.insert(recordBuffer.end(), bytes, bytes + getValueSize(parameter.type));
+}
+
+void InputRecorder::trackParameter(const std::string& name, float* value, std::function<void()> onReplay) {
+    addParameter(name, ParameterType::FLOAT, value, onReplay);
+}
+
+void InputRecorder::trackParameter(const std::string& name, int* value, std::function<void()> onReplay) {
+    addParameter(name, ParameterType::INT, value, onReplay);
+}
+
+void InputRecorder::trackParameter(const std::string& name, bool* value, std::function<void()> onReplay) {
+    addParameter(name, ParameterType::BOOL, value, onReplay);
+}
+
+void InputRecorder::trackParameter(const std::string& name, glm::vec3* value, std::function<void()> onReplay) {
+    addParameter(name, ParameterType::VEC3, glm::value_ptr(*value), onReplay);
+}
+
+void InputRecorder::trackParameter(const std::string& name, std::string* value, std::function<void()> onReplay) {
+    addParameter(name, ParameterType::STRING, value, onReplay);
+}
+
+void InputRecorder::trackInitialState(const std::string& name, float* value, std::function<void()> onReplay) {
+    addParameter(name, ParameterType::FLOAT, value, onReplay, true);
+}
+
+void InputRecorder::trackInitialState(const std::string& name, bool* value, std::function<void()> onReplay) {
+    addParameter(name, ParameterType::BOOL, value, onReplay, true);
+}
+
+void InputRecorder::trackInitialState(const std::string& name, glm::vec3* value, std::function<void()> onReplay) {
+    addParameter(name, ParameterType::VEC3, glm::value_ptr(*value), onReplay, true);
+}
+
+template <typename T>
+void InputRecorder::write(const T& value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    recordBuffer.insert(recordBuffer.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+bool InputRecorder::read(T& value) {
+    return readBytes(&value, sizeof(T));
+}
+
+bool InputRecorder::readBytes(void* data, size_t size) {
+    if (replayOffset + size > replayBuffer.size())
+        return false;
+    std::memcpy(data, replayBuffer.data() + replayOffset, size);
+    replayOffset += size;
+    return true;
+}
+
+bool InputRecorder::startRecording(const std::string& filePath) {
+    if (replaying) {
+        SPDLOG_ERROR("Cannot record input while replaying");
+        return false;
+    }
+
+    // the header lists the tracked parameters so ids can be remapped by name on replay
+    recordBuffer.clear();
+    recordBuffer.insert(recordBuffer.end(), MAGIC, MAGIC + sizeof(MAGIC));
+    write(VERSION);
+    write((uint32_t)parameters.size());
+    for (auto& parameter : parameters) {
+        write((uint16_t)parameter.name.size());
+        recordBuffer.insert(recordBuffer.end(), parameter.name.begin(), parameter.name.end());
+        write(parameter.type);
+        // the initial values are recorded as changes of the first frame
+        parameter.hasLastValue = false;
+    }
+    // the initial state precedes the first frame, before its input moves the camera
+    for (uint16_t id = 0; id < parameters.size(); id++) {
+        if (!parameters[id].initialOnly)
+            continue;
+        write(TAG_PARAMETER);
+        write(id);
+        writeValue(parameters[id]);
+    }
+
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        SPDLOG_ERROR("Failed to open input recording: {}", filePath);
+        return false;
+    }
+    recordingPath = filePath;
+    recording = true;
+    numFrames = 0;
+    SPDLOG_INFO("Input recording started: {}", filePath);
+    return true;
+}
+
+void InputRecorder::flushRecording() {
+    std::ofstream file(recordingPath, std::ios::binary | std::ios::app);
+    file.write(reinterpret_cast<const char*>(recordBuffer.data()), recordBuffer.size());
+    recordBuffer.clear();
+}
+
+void InputRecorder::stopRecording() {
+    if (!recording)
+        return;
+    write(TAG_END);
+    flushRecording();
+    recording = false;
+    SPDLOG_INFO("Input recording saved: {} ({} frames)", recordingPath, numFrames);
+}
+
+void InputRecorder::recordMouseMove(float x, float y) {
+    if (!recording)
+        return;
+    write(TAG_MOUSE_MOVE);
+    write(x);
+    write(y);
+}
+
+void InputRecorder::recordMouseButton(int button, int action, float x, float y, bool capturedByGui) {
+    if (!recording)
+        return;
+    write(TAG_MOUSE_BUTTON);
+    write((int8_t)button);
+    write((int8_t)action);
+    write(x);
+    write(y);
+    write(capturedByGui);
+}
+
+void InputRecorder::recordFrame(float deltaTime, unsigned int keyMask) {
+    if (!recording)
+        return;
+    write(TAG_FRAME);
+    write(deltaTime);
+    write((uint8_t)keyMask);
+    numFrames++;
+
+    // write to disk in chunks to keep memory bounded during long sessions
+    if (recordBuffer.size() > (1 << 20))
+        flushRecording();
+}
+
+void InputRecorder::recordParameterChanges() {
+    // changes always follow the frame record they belong to
+    if (!recording || numFrames == 0)
+        return;
+    for (uint16_t id = 0; id < parameters.size(); id++) {
+        Parameter& parameter = parameters[id];
+        if (parameter.initialOnly || !updateLastValue(parameter))
+            continue;
+        write(TAG_PARAMETER);
+        write(id);
+        writeValue(parameter);
+    }
+}
+
+bool InputRecorder::startReplay(const std::string& filePath, PlaybackSpeed speed) {
+    if (recording)
+        stopRecording();
+
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        SPDLOG_ERROR("Failed to open input recording: {}", filePath);
+        return false;
+    }
+    replayBuffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    replayOffset = 0;
+
+    char magic[4];
+    uint32_t version = 0;
+    uint32_t numParameters = 0;
+    if (!readBytes(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0
+        || !read(version) || version < 1 || version > VERSION || !read(numParameters)) {
+        SPDLOG_ERROR("Invalid input recording: {}", filePath);
+        return false;
+    }
+    replayVersion = version;
+
+    replayParameterIndices.clear();
+    replayParameterTypes.clear();
+    for (uint32_t i = 0; i < numParameters; i++) {
+        uint16_t nameLength = 0;
+        ParameterType type;
+        std::string name;
+        if (!read(nameLength)) {
+            SPDLOG_ERROR("Invalid input recording: {}", filePath);
+            return false;
+        }
+        name.resize(nameLength);
+        if (!readBytes(name.data(), nameLength) || !read(type)) {
+            SPDLOG_ERROR("Invalid input recording: {}", filePath);
+            return false;
+        }
+        int index = -1;
+        for (int j = 0; j < (int)parameters.size(); j++) {
+            if (parameters[j].name == name && parameters[j].type == type)
+                index = j;
+        }
+        if (index < 0)
+            SPDLOG_WARN("Recorded parameter is not tracked anymore: {}", name);
+        replayParameterIndices.push_back(index);
+        replayParameterTypes.push_back(type);
+    }
+
+    // count frames up front for progress reporting
+    size_t headerEnd = replayOffset;
+    numReplayFrames = 0;
+    replayFrameIndex = 0;
+    replayParameterChanges();
+    for (Frame frame; replayFrame(frame);)
+        replayParameterChanges();
+    numReplayFrames = replayFrameIndex;
+    replayOffset = headerEnd;
+
+    replaying = true;
+    playbackSpeed = speed;
+    replayFrameIndex = 0;
+    replayTime = 0.0;
+    replayParameterChanges();  // the initial state, before the first frame's input
+    replayStart = std::chrono::steady_clock::now();
+    SPDLOG_INFO("Input replay started: {} ({} frames)", filePath, numReplayFrames);
+    return true;
+}
+
+void InputRecorder::stopReplay() {
+    if (!replaying)
+        return;
+    replaying = false;
+    replayBuffer.clear();
+    SPDLOG_INFO("Input replay finished after {} frames", replayFrameIndex);
+}
+
+bool InputRecorder::replayFrame(Frame& frame) {
+    frame.mouseEvents.clear();
+    uint8_t tag;
+    while (read(tag)) {
+        if (tag == TAG_MOUSE_MOVE) {
+            MouseEvent event{ false, 0, 0 };
+            if (!read(event.x) || !read(event.y))
+                break;
+            frame.mouseEvents.push_back(event);
+        }
+        else if (tag == TAG_MOUSE_BUTTON) {
+            int8_t button, action;
+            MouseEvent event{ true };
+            event.capturedByGui = false;  // older recordings did not capture the GUI's clicks
+            if (!read(button) || !read(action) || !read(event.x) || !read(event.y)
+                || (replayVersion >= 4 && !read(event.capturedByGui)))
+                break;
+            event.button = button;
+            event.action = action;
+            frame.mouseEvents.push_back(event);
+        }
+        else if (tag == TAG_FRAME) {
+            uint8_t keyMask;
+            if (!read(frame.deltaTime) || !read(keyMask))
+                break;
+            frame.keyMask = keyMask;
+            replayFrameIndex++;
+
+            if (replaying && playbackSpeed == PlaybackSpeed::REALTIME) {
+                replayTime += frame.deltaTime;
+                std::this_thread::sleep_until(replayStart + std::chrono::duration<double>(replayTime));
+            }
+            return true;
+        }
+        else {
+            // TAG_END or a parameter record without a preceding frame
+            break;
+        }
+    }
+    return false;
+}
+
+void InputRecorder::replayParameterChanges() {
+    uint8_t tag;
+    while (replayOffset < replayBuffer.size() && replayBuffer[replayOffset] == TAG_PARAMETER) {
+        read(tag);
+        uint16_t id;
+        if (!read(id) || id >= replayParameterIndices.size())
+            return;
+        uint8_t value[12];
+        std::string string;
+        uint16_t length = 0;
+        if (replayParameterTypes[id] == ParameterType::STRING) {
+            if (!read(length))
+                return;
+            string.resize(length);
+            if (!readBytes(string.data(), length))
+                return;
+        }
+        else if (!readBytes(value, getValueSize(replayParameterTypes[id])))
+            return;
+
+        int index = replayParameterIndices[id];
+        if (index < 0 || !replaying)
+            continue;
+        Parameter& parameter = parameters[index];
+        if (parameter.type == ParameterType::STRING)
+            *static_cast<std::string*>(parameter.value) = string;
+        else
+            std::memcpy(parameter.value, value, getValueSize(parameter.type));
+        updateLastValue(parameter);
+        if (parameter.onReplay)
+            parameter.onReplay();
+    }
+}
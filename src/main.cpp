@@ -1,5 +1,7 @@
 #include "common.h"
 #include "context.h"
+#include "benchmark.h"
+#include "batch_renderer.h"
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
@@ -11,6 +13,41 @@ void OnMouseButton(GLFWwindow* window, int button, int action, int modifier);
 void OnScroll(GLFWwindow* window, double xoffset, double yoffset);
 
 int main(int argc, const char** argv) {
+    CpuProfiler::setThreadName("main");
+
+    BenchmarkOptions benchmarkOptions;
+    if (Benchmark::parseOptions(argc, argv, benchmarkOptions))
+        return Benchmark::run(benchmarkOptions);
+    BatchOptions batchOptions;
+    if (BatchRenderer::parseOptions(argc, argv, batchOptions))
+        return BatchRenderer::run(batchOptions);
+
+    // usage: make_terrain [--replay FILE] [--replay-speed realtime|max] [--replay-exit]
+    //        [--capture PATH|-] [--capture-format png|y4m] [--capture-fps N]
+    std::string replayFile;
+    auto replaySpeed = InputRecorder::PlaybackSpeed::REALTIME;
+    bool exitAfterReplay = false;
+    std::string capturePath;
+    auto captureFormat = FrameCapture::Format::PNG_SEQUENCE;
+    int captureFrameRate = 60;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--replay" && i + 1 < argc)
+            replayFile = argv[++i];
+        else if (arg == "--replay-speed" && i + 1 < argc)
+            replaySpeed = std::string(argv[++i]) == "max" ? InputRecorder::PlaybackSpeed::MAXIMUM : InputRecorder::PlaybackSpeed::REALTIME;
+        else if (arg == "--replay-exit")
+            exitAfterReplay = true;
+        else if (arg == "--capture" && i + 1 < argc)
+            capturePath = argv[++i];
+        else if (arg == "--capture-format" && i + 1 < argc)
+            captureFormat = std::string(argv[++i]) == "y4m" ? FrameCapture::Format::Y4M : FrameCapture::Format::PNG_SEQUENCE;
+        else if (arg == "--capture-fps" && i + 1 < argc)
+            captureFrameRate = std::max(1, std::atoi(argv[++i]));
+    }
+    if (capturePath == "-" && captureFormat == FrameCapture::Format::Y4M)
+        FrameCapture::logToStderr();  // the video stream starts with the first byte on stdout
+
     SPDLOG_INFO("Initialize glfw");
     if (!glfwInit()) {
         const char* description = nullptr;
@@ -18,12 +55,18 @@ int main(int argc, const char** argv) {
         SPDLOG_ERROR("failed to initialize glfw: {}", description);
         return -1;
     }
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+    // 4.3 enables GPU-driven terrain culling; macOS stops at 4.1
     SPDLOG_INFO("Create glfw window");
-    auto window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_NAME, nullptr, nullptr);
+    GLFWwindow* window = nullptr;
+    for (int minorVersion : { 3, 1 }) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minorVersion);
+        window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_NAME, nullptr, nullptr);
+        if (window)
+            break;
+    }
     if (!window) {
         SPDLOG_ERROR("failed to create glfw window");
         glfwTerminate();
@@ -63,25 +106,55 @@ int main(int argc, const char** argv) {
     glfwSetMouseButtonCallback(window, OnMouseButton);
     glfwSetScrollCallback(window, OnScroll);
 
-    glPatchParameteri(GL_PATCH_VERTICES, 4);  // use quad patches
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
-    glCullFace(GL_BACK);
+    auto gpuProfiler = context->getGpuProfiler();
+    auto inputRecorder = context->getInputRecorder();
+    if (!replayFile.empty() && !inputRecorder->startReplay(replayFile, replaySpeed)) {
+        context.reset();
+        glfwTerminate();
+        return -1;
+    }
+    if (replaySpeed == InputRecorder::PlaybackSpeed::MAXIMUM)
+        glfwSwapInterval(0);
+    if (!capturePath.empty() && !context->getFrameCapture()->startVideo(captureFormat, capturePath, captureFrameRate)) {
+        context.reset();
+        glfwTerminate();
+        return -1;
+    }
 
     SPDLOG_INFO("Start main loop");
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        CpuProfiler::markFrame();
+        PROFILE_ZONE("frame");
+        {
+            PROFILE_ZONE("glfwPollEvents");
+            glfwPollEvents();
+        }
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
-        context->updateDeltaTime();
-        context->processInput(window);
-        context->renderGUI();
+        bool wasReplaying = inputRecorder->isReplaying();
+        context->update(window);
+        if (exitAfterReplay && wasReplaying && !inputRecorder->isReplaying())
+            glfwSetWindowShouldClose(window, true);
+        {
+            PROFILE_ZONE("Context::renderGUI");
+            context->renderGUI();
+        }
+        gpuProfiler->beginFrame();
         context->render();
 
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-        glfwSwapBuffers(window);
+        {
+            PROFILE_ZONE("ImGui::Render");
+            ImGui::Render();
+            gpuProfiler->beginPass("gui");
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            gpuProfiler->endPass();
+        }
+        gpuProfiler->endFrame();
+        {
+            PROFILE_ZONE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
     }
     context.reset();
 
@@ -115,6 +188,33 @@ void OnKeyEvent(GLFWwindow* window,
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, true);
     }
+    if (key == GLFW_KEY_F9 && action == GLFW_PRESS) {
+        auto context = (Context*)glfwGetWindowUserPointer(window);
+        context->dumpCpuTrace();
+    }
+    if (key == GLFW_KEY_F10 && action == GLFW_PRESS) {
+        auto context = (Context*)glfwGetWindowUserPointer(window);
+        context->toggleInputRecording();
+    }
+    if (key == GLFW_KEY_F11 && action == GLFW_PRESS) {
+        auto context = (Context*)glfwGetWindowUserPointer(window);
+        context->toggleVideoCapture();
+    }
+    if (key == GLFW_KEY_F12 && action == GLFW_PRESS) {
+        auto context = (Context*)glfwGetWindowUserPointer(window);
+        context->takeScreenshot();
+    }
+    if (key == GLFW_KEY_Z && action != GLFW_RELEASE && (mods & GLFW_MOD_CONTROL) && !ImGui::GetIO().WantCaptureKeyboard) {
+        auto context = (Context*)glfwGetWindowUserPointer(window);
+        if (mods & GLFW_MOD_SHIFT)
+            context->redoTerrainEdit();
+        else
+            context->undoTerrainEdit();
+    }
+    if (key == GLFW_KEY_Y && action != GLFW_RELEASE && (mods & GLFW_MOD_CONTROL) && !ImGui::GetIO().WantCaptureKeyboard) {
+        auto context = (Context*)glfwGetWindowUserPointer(window);
+        context->redoTerrainEdit();
+    }
 }
 
 void OnCharEvent(GLFWwindow* window, unsigned int ch) {
@@ -0,0 +1,197 @@
+#include "pipeline_statistics.h"
+#include <imgui.h>
+
+const GLenum PipelineStatistics::QUERY_TARGETS[NUM_COUNTERS] = {
+    GL_PRIMITIVES_GENERATED,
+    GL_PRIMITIVES_SUBMITTED_ARB,
+    GL_TESS_CONTROL_SHADER_PATCHES_ARB,
+    GL_TESS_EVALUATION_SHADER_INVOCATIONS_ARB,
+    GL_GEOMETRY_SHADER_INVOCATIONS,
+    GL_GEOMETRY_SHADER_PRIMITIVES_EMITTED_ARB,
+    GL_CLIPPING_INPUT_PRIMITIVES_ARB,
+    GL_CLIPPING_OUTPUT_PRIMITIVES_ARB,
+    GL_FRAGMENT_SHADER_INVOCATIONS_ARB,
+};
+
+std::unique_ptr<PipelineStatistics> PipelineStatistics::create() {
+    auto statistics = std::unique_ptr<PipelineStatistics>(new PipelineStatistics());
+    statistics->init();
+    return std::move(statistics);
+}
+
+PipelineStatistics::~PipelineStatistics() {
+    for (auto& frameQueries : frames) {
+        for (auto& passQueries : frameQueries.passQueries)
+            glDeleteQueries(NUM_COUNTERS, passQueries.queries);
+    }
+}
+
+void PipelineStatistics::init() {
+    isPipelineStatisticsSupported = GLAD_GL_ARB_pipeline_statistics_query || GLAD_GL_VERSION_4_6;
+    if (!isPipelineStatisticsSupported)
+        SPDLOG_INFO("ARB_pipeline_statistics_query is not supported, only primitives generated are counted");
+}
+
+bool PipelineStatistics::isCounterSupported(int counter) const {
+    return counter == PRIMITIVES_GENERATED || isPipelineStatisticsSupported;
+}
+
+void PipelineStatistics::beginFrame() {
+    if (!enabled)
+        return;
+
+    FrameQueries& frameQueries = frames[frameIndex % NUM_QUERY_FRAMES];
+    collectFrame(frameQueries);
+    frameQueries.numUsed = 0;
+    isInFrame = true;
+}
+
+void PipelineStatistics::endFrame() {
+    if (!isInFrame)
+        return;
+    if (isQueryActive)
+        endQuery();
+
+    frames[frameIndex % NUM_QUERY_FRAMES].pending = true;
+    frameIndex++;
+    isInFrame = false;
+}
+
+void PipelineStatistics::beginQuery(const std::string& passName) {
+    if (!isInFrame || isQueryActive)
+        return;
+
+    int passIndex = findPass(passName);
+    if (passIndex < 0) {
+        passes.push_back(PassCounters{ passName });
+        passIndex = passes.size() - 1;
+    }
+
+    FrameQueries& frameQueries = frames[frameIndex % NUM_QUERY_FRAMES];
+    if (frameQueries.numUsed == (int)frameQueries.passQueries.size()) {
+        PassQueries passQueries;
+        glGenQueries(NUM_COUNTERS, passQueries.queries);
+        frameQueries.passQueries.push_back(passQueries);
+    }
+    PassQueries& passQueries = frameQueries.passQueries[frameQueries.numUsed++];
+    passQueries.passIndex = passIndex;
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        if (isCounterSupported(i))
+            glBeginQuery(QUERY_TARGETS[i], passQueries.queries[i]);
+    }
+    isQueryActive = true;
+}
+
+void PipelineStatistics::endQuery() {
+    if (!isQueryActive)
+        return;
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        if (isCounterSupported(i))
+            glEndQuery(QUERY_TARGETS[i]);
+    }
+    isQueryActive = false;
+}
+
+void PipelineStatistics::collectFrame(FrameQueries& frameQueries) {
+    if (!frameQueries.pending)
+        return;
+    frameQueries.pending = false;
+    if (frameQueries.numUsed == 0)
+        return;
+
+    // results become available in order, so checking the last query is enough
+    GLint available = 0;
+    glGetQueryObjectiv(frameQueries.passQueries[frameQueries.numUsed - 1].queries[PRIMITIVES_GENERATED], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+
+    // a pass may draw the terrain several times; sum up its queries
+    for (auto& pass : passes) {
+        pass.latest = Counters();
+        pass.hasLatest = false;
+    }
+    for (int i = 0; i < frameQueries.numUsed; i++) {
+        PassQueries& passQueries = frameQueries.passQueries[i];
+        PassCounters& pass = passes[passQueries.passIndex];
+        for (int j = 0; j < NUM_COUNTERS; j++) {
+            if (!isCounterSupported(j))
+                continue;
+            GLuint64 value = 0;
+            glGetQueryObjectui64v(passQueries.queries[j], GL_QUERY_RESULT, &value);
+            pass.latest.values[j] += value;
+        }
+        pass.hasLatest = true;
+    }
+}
+
+int PipelineStatistics::findPass(const std::string& name) const {
+    for (int i = 0; i < (int)passes.size(); i++) {
+        if (passes[i].name == name)
+            return i;
+    }
+    return -1;
+}
+
+bool PipelineStatistics::getCounters(const std::string& passName, Counters& counters) const {
+    int passIndex = findPass(passName);
+    if (passIndex < 0 || !passes[passIndex].hasLatest)
+        return false;
+    counters = passes[passIndex].latest;
+    return true;
+}
+
+void PipelineStatistics::renderGUI() {
+    ImGui::SetNextWindowPos(ImVec2(420.0f, 360.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(520.0f, 0.0f), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Terrain Pipeline Statistics")) {
+        ImGui::Checkbox("collect statistics", &enabled);
+        if (!isPipelineStatisticsSupported)
+            ImGui::TextDisabled("ARB_pipeline_statistics_query unavailable: only generated primitives are counted");
+
+        ImGui::SameLine();
+        if (ImGui::Button("set baseline")) {
+            for (auto& pass : passes) {
+                pass.baseline = pass.latest;
+                pass.hasBaseline = pass.hasLatest;
+            }
+        }
+
+        // counters shown per pass; the percentage compares against the stored baseline
+        const struct {
+            const char* label;
+            Counter counter;
+        } columns[] = {
+            { "patches", PATCHES_SUBMITTED },
+            { "TES invocations", TESS_EVALUATION_INVOCATIONS },
+            { "primitives", PRIMITIVES_GENERATED },
+            { "fragments", FRAGMENT_SHADER_INVOCATIONS },
+        };
+        if (ImGui::BeginTable("statistics", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("pass");
+            for (const auto& column : columns)
+                ImGui::TableSetupColumn(column.label);
+            ImGui::TableHeadersRow();
+            for (const auto& pass : passes) {
+                if (!pass.hasLatest)
+                    continue;
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(pass.name.c_str());
+                for (const auto& column : columns) {
+                    ImGui::TableNextColumn();
+                    if (!isCounterSupported(column.counter)) {
+                        ImGui::TextDisabled("-");
+                        continue;
+                    }
+                    GLuint64 value = pass.latest.values[column.counter];
+                    ImGui::Text("%llu", (unsigned long long)value);
+                    GLuint64 baseline = pass.baseline.values[column.counter];
+                    if (pass.hasBaseline && baseline > 0)
+                        ImGui::TextDisabled("%+.1f%%", 100.0 * ((double)value - (double)baseline) / (double)baseline);
+                }
+            }
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
+}
@@ -0,0 +1,115 @@
+#include "readback.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+#include <cstring>
+#include <stb/stb_image_write.h>
+
+std::unique_ptr<AsyncReadback> AsyncReadback::create(int numBuffers) {
+    auto readback = std::unique_ptr<AsyncReadback>(new AsyncReadback());
+    readback->slots.resize(std::max(1, numBuffers));
+    for (auto& slot : readback->slots)
+        glGenBuffers(1, &slot.PBO);
+    return std::move(readback);
+}
+
+AsyncReadback::~AsyncReadback() {
+    for (auto& slot : slots) {
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+        glDeleteBuffers(1, &slot.PBO);
+    }
+}
+
+void AsyncReadback::request(int width, int height, Callback callback) {
+    PROFILE_FUNCTION();
+    // the ring is full: the oldest readback has to be completed first
+    if (numPending == slots.size())
+        complete(slots[nextSlot], true);
+
+    Slot& slot = slots[nextSlot];
+    nextSlot = (nextSlot + 1) % slots.size();
+    numPending++;
+
+    size_t size = (size_t)width * height * 3;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+    if (slot.capacity < size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        slot.capacity = size;
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.width = width;
+    slot.height = height;
+    slot.callback = std::move(callback);
+}
+
+bool AsyncReadback::complete(Slot& slot, bool wait) {
+    // flush on the first check so the fence is guaranteed to reach the GPU
+    GLuint64 timeout = wait ? 1000000000 : 0;
+    GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    while (wait && status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(slot.fence, 0, timeout);
+    if (status == GL_TIMEOUT_EXPIRED)
+        return false;
+    if (status == GL_WAIT_FAILED)
+        SPDLOG_ERROR("Failed to wait for readback fence");
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    size_t size = (size_t)slot.width * slot.height * 3;
+    std::vector<uint8_t> pixels(size);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+    void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (data) {
+        std::memcpy(pixels.data(), data, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    else {
+        SPDLOG_ERROR("Failed to map readback buffer");
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    auto callback = std::move(slot.callback);
+    slot.callback = nullptr;
+    numPending--;
+    if (data && callback)
+        callback(std::move(pixels), slot.width, slot.height);
+    return true;
+}
+
+int AsyncReadback::poll() {
+    PROFILE_FUNCTION();
+    int numCompleted = 0;
+    while (numPending > 0) {
+        int oldestSlot = (nextSlot - numPending + slots.size()) % slots.size();
+        if (!complete(slots[oldestSlot], false))
+            break;
+        numCompleted++;
+    }
+    return numCompleted;
+}
+
+void AsyncReadback::flush() {
+    while (numPending > 0) {
+        int oldestSlot = (nextSlot - numPending + slots.size()) % slots.size();
+        complete(slots[oldestSlot], true);
+    }
+}
+
+bool writeReadbackPNG(const std::string& filePath, const std::vector<uint8_t>& pixels, int width, int height) {
+    PROFILE_ZONE("encode png");
+    // OpenGL rows start at the bottom
+    size_t stride = (size_t)width * 3;
+    std::vector<uint8_t> flipped(pixels.size());
+    for (int y = 0; y < height; y++)
+        std::copy_n(pixels.data() + (height - 1 - y) * stride, stride, flipped.data() + y * stride);
+    if (!stbi_write_png(filePath.c_str(), width, height, 3, flipped.data(), (int)stride)) {
+        SPDLOG_ERROR("Failed to write {}", filePath);
+        return false;
+    }
+    return true;
+}
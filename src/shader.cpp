@@ -1,9 +1,11 @@
 #include "shader.h"
+#include "cpu_profiler.h"
 #include <fstream>
 #include <sstream>
 
 Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const char* tcsPath, const char* tesPath)
 {
+    PROFILE_ZONE("Shader::Shader");
     // Create the shader program
     ID = glCreateProgram();
 
@@ -39,6 +41,16 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geo
         glDeleteShader(tesShader);
 }
 
+Shader::Shader(const char* computePath)
+{
+    PROFILE_ZONE("Shader::Shader");
+    ID = glCreateProgram();
+    unsigned int computeShader = loadShader(computePath, GL_COMPUTE_SHADER);
+    glLinkProgram(ID);
+    checkCompileErrors(ID, "PROGRAM");
+    glDeleteShader(computeShader);
+}
+
 void Shader::use()
 {
     glUseProgram(ID);
@@ -275,6 +287,7 @@ void Shader::checkCompileErrors(GLuint shader, std::string type)
 // Loads and compiles individual shaders
 unsigned int Shader::loadShader(std::string path, unsigned int shaderType)
 {
+    PROFILE_ZONE("Shader::loadShader");
     std::string code;
     std::ifstream file;
     file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
@@ -321,6 +334,9 @@ unsigned int Shader::loadShader(std::string path, unsigned int shaderType)
         case GL_TESS_EVALUATION_SHADER:
             type = "TESS_EVALUATION";
             break;
+        case GL_COMPUTE_SHADER:
+            type = "COMPUTE";
+            break;
         default:
             type = "UNKNOWN";
     }
@@ -20,14 +20,17 @@ Skybox::Skybox(Context* context) : context(context) {
 }
 
 void Skybox::render() {
-    glDepthFunc(GL_LEQUAL);
+    // drawn at the far plane, which passes against the cleared depth
+    bool reverseZ = context->isReverseZ();
+    glDepthFunc(reverseZ ? GL_GEQUAL : GL_LEQUAL);
     glBindVertexArray(VAO);
     glm::mat4 view = glm::mat4(glm::mat3(context->getViewMatrix()));
     glm::mat4 projection = context->getProjectionMatrix();
     shader->use();
     shader->setMat4("view", view);
     shader->setMat4("projection", projection);
+    shader->setBool("reverseZ", reverseZ);
     shader->bindCubemapTexture("skyboxTexture1", texture.get());
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glDepthFunc(GL_LESS);
+    glDepthFunc(reverseZ ? GL_GREATER : GL_LESS);
 }
\ No newline at end of file
@@ -2,8 +2,21 @@
 #include "utils.h"
 #include "terrain.h"
 #include "context.h"
+#include "cpu_profiler.h"
+#include "thread_pool.h"
 #include <stb/stb_image.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 
+namespace {
+// regenerating at the same size overwrites a texture in place
+bool isReusable(const std::unique_ptr<Texture>& texture, int width, int height, unsigned int dataType, int channels) {
+    return texture && texture->width == width && texture->height == height
+        && texture->dataType == dataType && texture->channels == channels;
+}
+}
 
 std::unique_ptr<Terrain> Terrain::createWithTessellation(Context* context) {
     auto terrain = std::unique_ptr<Terrain>(new Terrain(context));
@@ -21,10 +34,14 @@ void Terrain::init() {
     shader = std::make_unique<Shader>(
         "../shaders/terrain/shader_terrain.vs",
         "../shaders/terrain/shader_terrain.fs",
-        "../shaders/terrain/shader_terrain.gs",
+        nullptr,
         "../shaders/terrain/shader_terrain.tesc",
         "../shaders/terrain/shader_terrain.tese"
     );
+    skirtShader = std::make_unique<Shader>(
+        "../shaders/terrain/shader_terrain_skirt.vs",
+        "../shaders/terrain/shader_terrain_skirt.fs"
+    );
     normalShader = std::make_unique<Shader>(
         "../shaders/terrain/shader_terrain.vs",
         "../shaders/debug/shader_terrain_normal.fs",
@@ -33,23 +50,181 @@ void Terrain::init() {
         "../shaders/terrain/shader_terrain.tese"
     );
 
+    glGenVertexArrays(1, &gridVAO);  // attributeless, positions come from gl_InstanceID
+    culler = TerrainCuller::create();
+    horizonCuller = HorizonCuller::create();
+    viewshed = Viewshed::create();
+    generator = TerrainGenerator::create();
+    gpuGenerator = GpuTerrainGenerator::create();
+    erosion = TerrainErosion::create();
+    sculptor = TerrainSculptor::create();
+    history = TerrainHistory::create();
+    exporter = TerrainExporter::create();
+
+    // location 2 of shader_terrain.vs, like the GPU culler's output
+    glGenVertexArrays(1, &cpuCulledVAO);
+    glGenBuffers(1, &cpuCulledVBO);
+    glBindVertexArray(cpuCulledVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, cpuCulledVBO);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glBindVertexArray(0);
+
     resetTerrain(initTerrain);
     SPDLOG_INFO("Terrain initialized");
 }
 
 void Terrain::resetTerrain(const std::string& terrainName) {
-    if (VAO != 0) {
-        glDeleteVertexArrays(1, &VAO);
+    PROFILE_ZONE("Terrain::resetTerrain");
+    this->terrainName = terrainName;
+    raycaster.reset();
+    heightfield.reset();
+    viewshed->invalidate();
+    erosion->invalidate();
+    erodedFrames = 0;
+    history->clear();
+    isRecordingErosion = false;
+    generatedOnGpu = false;
+    heightsPendingReadback = false;
+    if (heightsReadbackFence) {
+        glDeleteSync(heightsReadbackFence);
+        heightsReadbackFence = nullptr;
+    }
+    bool hasHeights = true;
+    if (terrainName == PROCEDURAL_TERRAIN && useGpuGenerator && gpuGenerator) {
+        generateTerrainOnGpu();
+        hasHeights = false;  // read back by syncGeneratedHeights
+    }
+    else if (terrainName == PROCEDURAL_TERRAIN)
+        generateTerrain();
+    else {
+        std::string heightMapPath = "../assets/Terrain/" + terrainName + "/converted/Height Map.png";
+        diffuseMap = std::make_unique<Texture>(("../assets/Terrain/" + terrainName + "/converted/Diffuse Map.png").c_str());
+        hasHeights = loadHeights(heightMapPath);
+        // built from the decoded samples instead of decoding the image again; a float texture keeps the
+        // precision of 16-bit height maps and is the one sculpting updates
+        if (hasHeights && isReusable(heightMap, heightsWidth, heightsHeight, GL_FLOAT, 1))
+            heightMap->update(heights.data());
+        else if (hasHeights)
+            heightMap = std::make_unique<Texture>(heightsWidth, heightsHeight, heights.data());
+        else
+            heightMap = std::make_unique<Texture>(heightMapPath.c_str());
+    }
+    if (hasHeights) {
+        heightfield = Heightfield::create(heights, heightsWidth, heightsHeight);
+        updateTransform();
+        raycaster = TerrainRaycaster::create(heightfield.get(), context->threadPool.get());
+        computeGradientMap();
+        buildSkirt();
     }
-
-    heightMap = std::make_unique<Texture>(("../assets/Terrain/" + terrainName + "/converted/Height Map.png").c_str());
-    diffuseMap = std::make_unique<Texture>(("../assets/Terrain/" + terrainName + "/converted/Diffuse Map.png").c_str());
 
     int width = heightMap->width;
     int height = heightMap->height;
     numStrips = width / 50;
+    if (!generatedOnGpu) {  // the GPU generator has written the culler's bounds
+        computePatchBounds();
+        if (culler)
+            culler->updatePatchBounds(patchHeightRanges, numStrips);
+    }
 
-    vertices.clear();
+    // the instanced grid only depends on uniforms; the vertex buffer is rebuilt for the new size
+    releasePatchBuffer();
+    if (!useInstancedGrid)
+        buildPatchBuffer();
+    SPDLOG_INFO("Terrain reset: {}", terrainName);
+    SPDLOG_INFO("Terrain width: {}, height: {}, numStrips: {}", width, height, numStrips);
+}
+
+void Terrain::computePatchBounds() {
+    PROFILE_FUNCTION();
+    patchHeightRanges.clear();
+    if (heights.empty())
+        return;
+    patchHeightRanges.resize((size_t)numStrips * numStrips);
+    computePatchBounds({ 0, 0, heightsWidth, heightsHeight });
+}
+
+glm::ivec4 Terrain::computePatchBounds(const TexelRegion& region) {
+    // patch (i, j) spans u in [i, i + 1] / numStrips and v in [j, j + 1] / numStrips, indexed i * numStrips + j
+    // like gl_InstanceID in shader_terrain.vs; one texel of margin covers the bilinear filter
+    int width = heightsWidth;
+    int height = heightsHeight;
+    auto patchX0 = [&](int i) { return std::max(0, i * width / numStrips - 1); };
+    auto patchX1 = [&](int i) { return std::min(width - 1, (i + 1) * width / numStrips + 1); };
+    auto patchY0 = [&](int j) { return std::max(0, j * height / numStrips - 1); };
+    auto patchY1 = [&](int j) { return std::min(height - 1, (j + 1) * height / numStrips + 1); };
+    glm::ivec4 patches(numStrips, numStrips, -1, -1);  // first i, first j, last i, last j over the region
+    for (int i = 0; i < numStrips; i++) {
+        if (patchX1(i) >= region.x0 && patchX0(i) < region.x1) {
+            patches.x = std::min(patches.x, i);
+            patches.z = i;
+        }
+    }
+    for (int j = 0; j < numStrips; j++) {
+        if (patchY1(j) >= region.y0 && patchY0(j) < region.y1) {
+            patches.y = std::min(patches.y, j);
+            patches.w = j;
+        }
+    }
+
+    for (int i = patches.x; i <= patches.z; i++) {
+        int x0 = patchX0(i);
+        int x1 = patchX1(i);
+        for (int j = patches.y; j <= patches.w; j++) {
+            float minHeight = 1.0f;
+            float maxHeight = 0.0f;
+            for (int y = patchY0(j); y <= patchY1(j); y++) {
+                auto [rowMin, rowMax] = std::minmax_element(heights.begin() + (size_t)y * width + x0,
+                    heights.begin() + (size_t)y * width + x1 + 1);
+                minHeight = std::min(minHeight, *rowMin);
+                maxHeight = std::max(maxHeight, *rowMax);
+            }
+            patchHeightRanges[(size_t)i * numStrips + j] = glm::vec2(minHeight, maxHeight);
+        }
+    }
+    return patches;
+}
+
+bool Terrain::isGpuCullingActive() const {
+    return culler && useGpuCulling && useInstancedGrid && culler->getGridSize() == numStrips;
+}
+
+bool Terrain::isCpuCullingActive() const {
+    return useHorizonCulling && useInstancedGrid && patchHeightRanges.size() == (size_t)numStrips * numStrips;
+}
+
+void Terrain::cullPatchesOnCPU(const glm::mat4& model, const glm::mat4& viewProjection) {
+    PROFILE_FUNCTION();
+    // world-space bounds; the model matrix only scales
+    glm::vec2 terrainSize(heightMap->width, heightMap->height);
+    patchChunks.resize(patchHeightRanges.size());
+    for (int i = 0; i < numStrips; i++) {
+        for (int j = 0; j < numStrips; j++) {
+            size_t index = (size_t)i * numStrips + j;
+            glm::vec2 heightRange = patchHeightRanges[index] * heightScale + heightOffset;
+            glm::vec3 localMin(terrainSize.x * (i / (float)numStrips - 0.5f), std::min(heightRange.x, heightRange.y),
+                terrainSize.y * (j / (float)numStrips - 0.5f));
+            glm::vec3 localMax(terrainSize.x * ((i + 1) / (float)numStrips - 0.5f), std::max(heightRange.x, heightRange.y),
+                terrainSize.y * ((j + 1) / (float)numStrips - 0.5f));
+            patchChunks[index].boundsMin = glm::vec3(model * glm::vec4(localMin, 1.0f));
+            patchChunks[index].boundsMax = glm::vec3(model * glm::vec4(localMax, 1.0f));
+        }
+    }
+
+    // the horizon needs the upright main camera: not the light, not the mirrored reflection camera
+    bool useHorizon = !context->isRenderingToDepthMap && !context->isRenderingReflection;
+    horizonCuller->cull(patchChunks, viewProjection, context->getCameraPosition(), useHorizon, cpuVisiblePatches);
+    glBindBuffer(GL_ARRAY_BUFFER, cpuCulledVBO);
+    glBufferData(GL_ARRAY_BUFFER, cpuVisiblePatches.size() * sizeof(unsigned int), cpuVisiblePatches.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Terrain::buildPatchBuffer() {
+    int width = heightMap->width;
+    int height = heightMap->height;
+    std::vector<float> vertices;
+    vertices.reserve(numStrips * numStrips * 4 * 5);
     for (unsigned i = 0; i < numStrips; i++)
     {
         for (unsigned j = 0; j < numStrips; j++)
@@ -83,12 +258,503 @@ void Terrain::resetTerrain(const std::string& terrainName) {
             vertices.push_back((j + 1) / (float)numStrips); // v
         }
     }
-
     VAO = generatePositionTextureVAO(vertices);
-    SPDLOG_INFO("Terrain reset: {}", terrainName);
-    SPDLOG_INFO("Terrain width: {}, height: {}, numStrips: {}", width, height, numStrips);
+    patchBufferStrips = numStrips;
+}
+
+void Terrain::releasePatchBuffer() {
+    if (VAO == 0)
+        return;
+    // the VBO is only referenced by the VAO
+    GLint VBO = 0;
+    glBindVertexArray(VAO);
+    glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &VBO);
+    glBindVertexArray(0);
+    GLuint buffer = VBO;
+    glDeleteBuffers(1, &buffer);
+    glDeleteVertexArrays(1, &VAO);
+    VAO = 0;
+}
+
+bool Terrain::loadHeights(const std::string& filePath) {
+    PROFILE_FUNCTION();
+    int channels;
+    stbi_set_flip_vertically_on_load(true);  // match the orientation of the height map texture
+    bool is16Bit = stbi_is_16_bit(filePath.c_str());
+    void* data = is16Bit ? (void*)stbi_load_16(filePath.c_str(), &heightsWidth, &heightsHeight, &channels, 0)
+        : (void*)stbi_load(filePath.c_str(), &heightsWidth, &heightsHeight, &channels, 0);
+    if (!data) {
+        SPDLOG_ERROR("Failed to load heights: {}", filePath);
+        heights.clear();
+        heightsWidth = heightsHeight = 0;
+        return false;
+    }
+
+    // the shaders read the green channel
+    int channel = channels > 1 ? 1 : 0;
+    heights.resize((size_t)heightsWidth * heightsHeight);
+    for (size_t i = 0; i < heights.size(); i++) {
+        heights[i] = is16Bit ? ((const unsigned short*)data)[i * channels + channel] / 65535.0f
+            : ((const unsigned char*)data)[i * channels + channel] / 255.0f;
+    }
+    stbi_image_free(data);
+    return true;
+}
+
+void Terrain::generateTerrain() {
+    PROFILE_FUNCTION();
+    generator->generate(context->threadPool.get(), heights, generatedColors);
+    heightsWidth = heightsHeight = generator->resolution;
+    if (isReusable(heightMap, heightsWidth, heightsHeight, GL_FLOAT, 1))
+        heightMap->update(heights.data());
+    else
+        heightMap = std::make_unique<Texture>(heightsWidth, heightsHeight, heights.data());
+    if (isReusable(diffuseMap, heightsWidth, heightsHeight, GL_UNSIGNED_BYTE, 3))
+        diffuseMap->update(generatedColors.data());
+    else
+        diffuseMap = std::make_unique<Texture>(heightsWidth, heightsHeight, 3, generatedColors.data());
+    SPDLOG_INFO("Terrain generated: {}x{} in {:.1f} ms", heightsWidth, heightsHeight, generator->getGenerationTime());
+}
+
+void Terrain::generateTerrainOnGpu() {
+    PROFILE_FUNCTION();
+    generator->clampParameters();
+    int size = generator->resolution;
+    heights.clear();
+    heightsWidth = heightsHeight = size;
+    if (!isReusable(heightMap, size, size, GL_FLOAT, 1))
+        heightMap = std::make_unique<Texture>(size, size, nullptr);
+    if (!isReusable(diffuseMap, size, size, GL_UNSIGNED_BYTE, 4))
+        diffuseMap = std::make_unique<Texture>(size, size, 4, nullptr);
+    uploadGradientMap(size, size, nullptr);
+
+    // the CPU culling keeps whole-height patches and the ground has no walls until the heights are read back
+    numStrips = size / 50;
+    patchHeightRanges.assign((size_t)numStrips * numStrips, glm::vec2(0.0f, 1.0f));
+    numSkirtIndices = 0;
+    unsigned int patchBounds = 0;
+    if (culler) {
+        culler->updatePatchBounds(patchHeightRanges, numStrips);
+        patchBounds = culler->getBoundsBuffer();
+    }
+    gpuGenerator->generate(*generator, heightMap->ID, diffuseMap->ID, gradientMap, patchBounds, numStrips);
+    generatedOnGpu = true;
+    requestHeightsReadback();
+}
+
+void Terrain::requestHeightsReadback() {
+    // the copy into the pixel buffer is queued behind the generator's dispatches, nothing waits for it here
+    if (!heightsReadbackPBO)
+        glGenBuffers(1, &heightsReadbackPBO);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, heightsReadbackPBO);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)heightsWidth * heightsHeight * sizeof(float), nullptr, GL_STREAM_READ);
+    glBindTexture(GL_TEXTURE_2D, heightMap->ID);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (heightsReadbackFence)
+        glDeleteSync(heightsReadbackFence);
+    heightsReadbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    heightsPendingReadback = true;
+}
+
+void Terrain::syncGeneratedHeights() {
+    // polled every frame, the heights are mapped once the GPU has finished writing them; recorded input
+    // expects them a frame after the generation, whatever the GPU's pace
+    if (!heightsPendingReadback)
+        return;
+    InputRecorder* inputRecorder = context->getInputRecorder();
+    readBackHeights(inputRecorder->isRecording() || inputRecorder->isReplaying());
+}
+
+bool Terrain::readBackHeights(bool wait) {
+    // a poll that never flushed could wait on a fence the driver has not submitted yet
+    GLuint64 timeout = wait ? 1000000000 : 0;
+    GLenum status = glClientWaitSync(heightsReadbackFence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    while (wait && status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(heightsReadbackFence, 0, timeout);
+    if (status == GL_TIMEOUT_EXPIRED)
+        return false;
+    PROFILE_FUNCTION();
+    if (status == GL_WAIT_FAILED)
+        SPDLOG_ERROR("Failed to wait for the generated heights");
+    glDeleteSync(heightsReadbackFence);
+    heightsReadbackFence = nullptr;
+    heightsPendingReadback = false;
+
+    size_t size = (size_t)heightsWidth * heightsHeight * sizeof(float);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, heightsReadbackPBO);
+    const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (data) {
+        heights.resize((size_t)heightsWidth * heightsHeight);
+        std::memcpy(heights.data(), data, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!data) {
+        SPDLOG_ERROR("Failed to map the generated heights");
+        return false;
+    }
+
+    heightfield = Heightfield::create(heights, heightsWidth, heightsHeight);
+    updateTransform();
+    raycaster = TerrainRaycaster::create(heightfield.get(), context->threadPool.get());
+    viewshed->invalidate();
+    buildSkirt();
+    computePatchBounds();  // exact bounds for the CPU culling, the culler keeps the GPU's
+    return true;
+}
+
+float Terrain::measureGeneratorParity() {
+    PROFILE_FUNCTION();
+    if (!generatedOnGpu)
+        return -1.0f;
+    if (heightsPendingReadback)
+        readBackHeights(true);  // the comparison needs the heights now
+
+    std::vector<float> cpuHeights;
+    std::vector<unsigned char> cpuColors;
+    generator->generate(context->threadPool.get(), cpuHeights, cpuColors);
+    if (cpuHeights.size() != heights.size())
+        return std::numeric_limits<float>::max();
+    float error = 0.0f;
+    for (size_t i = 0; i < heights.size(); i++)
+        error = std::max(error, std::abs(cpuHeights[i] - heights[i]));
+
+    // the GPU bounds are gathered from whole pyramid texels, they may be wider but must contain the exact ones
+    if (culler && culler->getGridSize() == numStrips && !patchHeightRanges.empty()) {
+        std::vector<glm::vec2> gpuBounds(patchHeightRanges.size());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler->getBoundsBuffer());
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, gpuBounds.size() * sizeof(glm::vec2), gpuBounds.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        for (size_t i = 0; i < gpuBounds.size(); i++) {
+            error = std::max(error, gpuBounds[i].x - patchHeightRanges[i].x);
+            error = std::max(error, patchHeightRanges[i].y - gpuBounds[i].y);
+        }
+    }
+    return error;
+}
+
+void Terrain::computeGradientMap() {
+    PROFILE_FUNCTION();
+    std::vector<float> gradients;
+    computeGradients(0, 0, heightsWidth, heightsHeight, gradients);
+    uploadGradientMap(heightsWidth, heightsHeight, gradients.data());
+}
+
+void Terrain::computeGradients(int x0, int y0, int x1, int y1, std::vector<float>& gradients) {
+    int width = heightsWidth;
+    int height = heightsHeight;
+    int regionWidth = x1 - x0;
+    gradients.resize((size_t)regionWidth * (y1 - y0) * 2);
+
+    // 3x3 Sobel with clamped borders, normalized to height units per texel.
+    // Rows are split across the workers; the inner loop has no branches so it vectorizes.
+    context->threadPool->parallelFor(y1 - y0, [&](int rowBegin, int rowEnd) {
+        std::vector<float> paddedRows[3];
+        for (auto& row : paddedRows)
+            row.resize(regionWidth + 2);
+        auto loadRow = [&](std::vector<float>& padded, int y) {
+            const float* row = heights.data() + (size_t)std::clamp(y, 0, height - 1) * width;
+            std::copy(row + x0, row + x1, padded.begin() + 1);
+            padded[0] = row[std::max(x0 - 1, 0)];
+            padded[regionWidth + 1] = row[std::min(x1, width - 1)];
+        };
+        for (int y = y0 + rowBegin; y < y0 + rowEnd; y++) {
+            loadRow(paddedRows[0], y - 1);
+            loadRow(paddedRows[1], y);
+            loadRow(paddedRows[2], y + 1);
+            const float* above = paddedRows[0].data() + 1;
+            const float* center = paddedRows[1].data() + 1;
+            const float* below = paddedRows[2].data() + 1;
+            float* out = gradients.data() + (size_t)(y - y0) * regionWidth * 2;
+            for (int x = 0; x < regionWidth; x++) {
+                float dx = (above[x + 1] + 2.0f * center[x + 1] + below[x + 1])
+                    - (above[x - 1] + 2.0f * center[x - 1] + below[x - 1]);
+                float dy = (below[x - 1] + 2.0f * below[x] + below[x + 1])
+                    - (above[x - 1] + 2.0f * above[x] + above[x + 1]);
+                out[2 * x] = dx / 8.0f;
+                out[2 * x + 1] = dy / 8.0f;
+            }
+        }
+    });
+}
+
+void Terrain::uploadGradientMap(int width, int height, const float* gradients) {
+    if (gradientMap == 0) {
+        glGenTextures(1, &gradientMap);
+        glBindTexture(GL_TEXTURE_2D, gradientMap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    glBindTexture(GL_TEXTURE_2D, gradientMap);
+    // null gradients only allocate, for the GPU generator
+    if (width != gradientMapWidth || height != gradientMapHeight) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, width, height, 0, GL_RG, GL_FLOAT, gradients);
+        gradientMapWidth = width;
+        gradientMapHeight = height;
+    }
+    else if (gradients)
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RG, GL_FLOAT, gradients);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Terrain::updateTransform() {
+    // the raycaster's queries read the transform from the heightfield too
+    if (heightfield)
+        heightfield->setTransform(horizontalScale, heightScale, heightOffset);
+}
+
+void Terrain::updateViewshed(const glm::vec2& observer) {
+    viewshed->compute(getHeightfield(), observer);
+}
+
+void Terrain::updateErosion() {
+    if (!erosion->running || heights.empty()) {
+        if (erodedFrames > 0)
+            syncErodedHeights();  // the queries catch up once the simulation pauses
+        if (isRecordingErosion && !heights.empty())
+            history->endEdit(heights);
+        isRecordingErosion = false;
+        return;
+    }
+    PROFILE_FUNCTION();
+    ThreadPool* threadPool = context->threadPool.get();
+    if (!erosion->isReady()) {
+        // heights in texel units: heightScale over the world size of a texel
+        erosion->reset(heights, heightsWidth, heightsHeight, heightScale * heightsWidth / horizontalScale);
+        useFloatHeightMap();
+    }
+    erosion->step(threadPool, erosion->iterationsPerFrame);
+    erosion->collectDirtyRegions(erosionRegions);
+    if (erosionRegions.empty())
+        return;
+    // the run is one undo step that keeps only the tiles it changed, recorded before their heights are replaced
+    for (const auto& region : erosionRegions)
+        history->recordBefore(heights, heightsWidth, heightsHeight, region);
+    isRecordingErosion = true;
+    erosion->copyHeights(threadPool, erosionRegions, heights);
+    for (const auto& region : erosionRegions)
+        uploadHeightRegion(region);
+    // the CPU queries are rebuilt every few frames, refitting them per tile would cost as much
+    if (++erodedFrames >= ERODED_FRAMES_PER_SYNC)
+        syncErodedHeights();
+}
+
+bool Terrain::sculpt(const glm::vec3& position, float deltaTime, bool beginStroke) {
+    if (heights.empty() || !heightfield || !raycaster)
+        return false;
+    PROFILE_FUNCTION();
+    // world position to texel coordinates, as in Heightfield::getHeight
+    glm::vec2 center(position.x * heightsWidth / horizontalScale + heightsWidth * 0.5f - 0.5f,
+        position.z * heightsHeight / horizontalScale + heightsHeight * 0.5f - 0.5f);
+    if (beginStroke) {
+        history->endEdit(heights);
+        isRecordingErosion = false;
+        sculptor->beginStroke(heights, heightsWidth, heightsHeight, center);
+    }
+    history->recordBefore(heights, heightsWidth, heightsHeight, sculptor->getStampRegion(center, heightsWidth, heightsHeight));
+    TexelRegion region = sculptor->stamp(context->threadPool.get(), heights, heightsWidth, heightsHeight, center, deltaTime);
+    if (region.x0 >= region.x1 || region.y0 >= region.y1)
+        return false;
+    applyHeightEdits({ region });
+    return true;
+}
+
+void Terrain::endSculptStroke() {
+    if (!heights.empty())
+        history->endEdit(heights);
+}
+
+bool Terrain::undoEdit() {
+    if (heights.empty() || !heightfield || !raycaster)
+        return false;
+    PROFILE_FUNCTION();
+    history->endEdit(heights);
+    isRecordingErosion = false;
+    if (!history->undo(context->threadPool.get(), heights, historyRegions))
+        return false;
+    applyHeightEdits(historyRegions);
+    return true;
+}
+
+bool Terrain::redoEdit() {
+    if (heights.empty() || !heightfield || !raycaster)
+        return false;
+    PROFILE_FUNCTION();
+    history->endEdit(heights);
+    isRecordingErosion = false;
+    if (!history->redo(context->threadPool.get(), heights, historyRegions))
+        return false;
+    applyHeightEdits(historyRegions);
+    return true;
+}
+
+void Terrain::applyHeightEdits(const std::vector<TexelRegion>& regions) {
+    useFloatHeightMap();
+    bool touchesBorder = false;
+    for (const auto& region : regions) {
+        uploadHeightRegion(region);
+        heightfield->update(heights, region);
+        raycaster->update(region);
+        touchesBorder |= region.x0 == 0 || region.y0 == 0 || region.x1 == heightsWidth || region.y1 == heightsHeight;
+    }
+    viewshed->invalidate();
+    erosion->invalidate();  // the simulation restarts from the edited heights
+    if (touchesBorder)
+        buildSkirt();
+}
+
+bool Terrain::exportTerrain(const std::string& name) {
+    // a single directory name under the assets, and not the entry the scan adds for the generator
+    if (name.empty() || name == "." || name == ".." || name == PROCEDURAL_TERRAIN
+        || name.find_first_of("/\\:") != std::string::npos) {
+        SPDLOG_ERROR("Invalid terrain export name: {}", name);
+        return false;
+    }
+    if (heights.empty() || exporter->isExporting())
+        return false;
+    PROFILE_FUNCTION();
+    // snapshots, so editing goes on during the export; heights are quantized to 16 bits on the way
+    TerrainExporter::Job job;
+    job.directory = "../assets/Terrain/" + name + "/converted";
+    job.width = heightsWidth;
+    job.height = heightsHeight;
+    job.heights.resize(heights.size());
+    context->threadPool->parallelFor(heightsHeight, [&](int rowBegin, int rowEnd) {
+        for (size_t i = (size_t)rowBegin * heightsWidth; i < (size_t)rowEnd * heightsWidth; i++)
+            job.heights[i] = (uint16_t)std::lround(std::clamp(heights[i], 0.0f, 1.0f) * 65535.0f);
+    });
+    if (terrainName != PROCEDURAL_TERRAIN)
+        job.diffuseSource = "../assets/Terrain/" + terrainName + "/converted/Diffuse Map.png";  // sculpting keeps it
+    else if (!generatedOnGpu)
+        job.colors = generatedColors;
+    else {
+        // the GPU generator's colors only exist in the texture
+        job.colors.resize(heights.size() * 4);
+        job.colorChannels = 4;
+        glBindTexture(GL_TEXTURE_2D, diffuseMap->ID);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, job.colors.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    return exporter->start(std::move(job));
+}
+
+void Terrain::useFloatHeightMap() {
+    // byte height maps become float, so small edits are not lost in the quantization
+    if (!isReusable(heightMap, heightsWidth, heightsHeight, GL_FLOAT, 1))
+        heightMap = std::make_unique<Texture>(heightsWidth, heightsHeight, heights.data());
 }
 
+void Terrain::uploadHeightRegion(const TexelRegion& region) {
+    heightMap->updateRegion(region.x0, region.y0, region.x1 - region.x0, region.y1 - region.y0, heights.data());
+
+    // the Sobel gradients of the texels around the region read it too
+    TexelRegion border = { std::max(region.x0 - 1, 0), std::max(region.y0 - 1, 0),
+        std::min(region.x1 + 1, heightsWidth), std::min(region.y1 + 1, heightsHeight) };
+    computeGradients(border.x0, border.y0, border.x1, border.y1, regionGradients);
+    glBindTexture(GL_TEXTURE_2D, gradientMap);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, border.x0, border.y0, border.x1 - border.x0, border.y1 - border.y0,
+        GL_RG, GL_FLOAT, regionGradients.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // bounds of the patches over the region, uploaded per grid column
+    if (patchHeightRanges.size() != (size_t)numStrips * numStrips)
+        return;
+    glm::ivec4 patches = computePatchBounds(region);
+    if (culler && culler->getGridSize() == numStrips) {
+        for (int i = patches.x; i <= patches.z; i++)
+            culler->updatePatchBounds(patchHeightRanges, (size_t)i * numStrips + patches.y, patches.w - patches.y + 1);
+    }
+}
+
+void Terrain::syncErodedHeights() {
+    PROFILE_FUNCTION();
+    erodedFrames = 0;
+    heightfield = Heightfield::create(heights, heightsWidth, heightsHeight);
+    updateTransform();
+    raycaster = TerrainRaycaster::create(heightfield.get(), context->threadPool.get());
+    viewshed->invalidate();
+    buildSkirt();
+}
+
+void Terrain::buildSkirt() {
+    PROFILE_FUNCTION();
+    // vertex: x, raw height, z, normal, texCoord, isTop (see shader_terrain_skirt.vs)
+    std::vector<float> skirtVertices;
+    std::vector<unsigned int> skirtIndices;
+    float width = heightMap->width;
+    float height = heightMap->height;
+    auto addVertex = [&](float u, float v, float rawHeight, glm::vec3 normal, float isTop) {
+        skirtVertices.insert(skirtVertices.end(), {
+            -width / 2.0f + width * u, rawHeight, -height / 2.0f + height * v,
+            normal.x, normal.y, normal.z,
+            u, v,
+            isTop
+        });
+    };
+
+    // one wall per border: a strip of quads from the terrain surface down to the ground plane
+    const struct {
+        glm::vec2 start;
+        glm::vec2 end;
+        glm::vec3 normal;
+        int numSegments;
+    } walls[] = {
+        { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, heightsWidth },
+        { { 1.0f, 1.0f }, { 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }, heightsWidth },
+        { { 0.0f, 1.0f }, { 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, heightsHeight },
+        { { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }, heightsHeight },
+    };
+    for (const auto& wall : walls) {
+        unsigned int first = skirtVertices.size() / 9;
+        for (int k = 0; k <= wall.numSegments; k++) {
+            glm::vec2 uv = glm::mix(wall.start, wall.end, k / (float)wall.numSegments);
+            addVertex(uv.x, uv.y, heightfield->getNormalizedHeight(uv.x, uv.y), wall.normal, 1.0f);
+            addVertex(uv.x, uv.y, 0.0f, wall.normal, 0.0f);
+        }
+        for (int k = 0; k < wall.numSegments; k++) {
+            unsigned int top0 = first + 2 * k;
+            unsigned int bottom0 = top0 + 1;
+            unsigned int top1 = top0 + 2;
+            unsigned int bottom1 = top0 + 3;
+            skirtIndices.insert(skirtIndices.end(), { top0, bottom0, top1, top1, bottom0, bottom1 });
+        }
+    }
+
+    // bottom plane
+    unsigned int first = skirtVertices.size() / 9;
+    glm::vec3 down(0.0f, -1.0f, 0.0f);
+    addVertex(0.0f, 0.0f, 0.0f, down, 0.0f);
+    addVertex(1.0f, 0.0f, 0.0f, down, 0.0f);
+    addVertex(1.0f, 1.0f, 0.0f, down, 0.0f);
+    addVertex(0.0f, 1.0f, 0.0f, down, 0.0f);
+    skirtIndices.insert(skirtIndices.end(), { first, first + 2, first + 1, first, first + 3, first + 2 });
+    numSkirtIndices = skirtIndices.size();
+
+    if (skirtVAO == 0) {
+        glGenVertexArrays(1, &skirtVAO);
+        glGenBuffers(1, &skirtVBO);
+        glGenBuffers(1, &skirtEBO);
+    }
+    glBindVertexArray(skirtVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, skirtVBO);
+    glBufferData(GL_ARRAY_BUFFER, skirtVertices.size() * sizeof(float), skirtVertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, skirtEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, skirtIndices.size() * sizeof(unsigned int), skirtIndices.data(), GL_STATIC_DRAW);
+    GLsizei stride = 9 * sizeof(float);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, (void*)(8 * sizeof(float)));
+    glEnableVertexAttribArray(3);
+    glBindVertexArray(0);
+}
 
 void Terrain::render() {
     if (!context->renderTerrain)
@@ -102,6 +768,21 @@ void Terrain::render() {
     );
     glm::mat4 view = context->getViewMatrix();
     glm::mat4 projection = context->getProjectionMatrix();
+    glm::vec2 terrainSize(heightMap->width, heightMap->height);
+
+    glm::mat4 viewProjection = context->isRenderingToDepthMap ? context->light->getLightSpaceMatrix() : projection * view;
+    bool useCulledPatches = false;
+    if (isGpuCullingActive()) {
+        // only the main scene pass matches the camera the Hi-Z pyramid was built from
+        const HiZBuffer* hiZ = context->hiZBuffer.get();
+        bool useOcclusion = useOcclusionCulling && context->currentPass == "fog scene" && hiZ->isValid();
+        culler->cull(model, viewProjection, terrainSize, heightScale, heightOffset, useOcclusion ? hiZ : nullptr);
+        useCulledPatches = true;
+    }
+    else if (isCpuCullingActive()) {
+        cullPatchesOnCPU(model, viewProjection);
+        useCulledPatches = true;
+    }
 
     shader->use();
     shader->setMat4("model", model);
@@ -111,13 +792,14 @@ void Terrain::render() {
     // terrain
     shader->bindTexture("heightMap", heightMap.get(), 0);
     shader->bindTexture("diffuseMap", diffuseMap.get(), 1);
+    shader->bindTexture("gradientMap", gradientMap, 3);
+    shader->setVec2("texelWorldSize", glm::vec2(horizontalScale / heightMap->width, horizontalScale / heightMap->height));
     shader->setFloat("heightScale", heightScale);
     shader->setFloat("heightOffset", heightOffset);
     shader->setInt("minTessLevel", minTessLevel);
     shader->setInt("maxTessLevel", maxTessLevel);
     shader->setFloat("minDistance", minDistance);
     shader->setFloat("maxDistance", maxDistance);
-    shader->setBool("showGround", showGround);
 
     // light
     shader->setBool("useLighting", useLighting);
@@ -125,6 +807,13 @@ void Terrain::render() {
     shader->setVec3("lightDir", context->light->direction);
     shader->setMat4("lightSpaceMatrix", context->light->getLightSpaceMatrix());
 
+    // viewshed overlay
+    bool useViewshed = showViewshed && viewshed->isValid();
+    shader->setBool("showViewshed", useViewshed);
+    shader->setFloat("horizontalScale", horizontalScale);
+    if (useViewshed)
+        shader->bindTexture("viewshedMap", viewshed->getTexture(), 4);
+
     // shadow
     shader->bindTexture("depthMap", context->depthMap.get(), 2);
     shader->setBool("renderToDepthMap", context->isRenderingToDepthMap);
@@ -138,8 +827,30 @@ void Terrain::render() {
     // clip plane
     shader->setVec4("clipPlane", context->getClipPlane());
 
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_PATCHES, 0, 4 * numStrips * numStrips);
+    shader->setBool("useInstancedGrid", useInstancedGrid);
+    shader->setBool("useCulledPatches", useCulledPatches);
+    shader->setInt("gridSize", numStrips);
+    shader->setVec2("terrainSize", terrainSize);
+
+    context->pipelineStatistics->beginQuery(context->currentPass);
+    drawPatches(useCulledPatches);
+    context->pipelineStatistics->endQuery();
+
+    // ground walls and bottom, not casting shadows
+    if (showGround && !context->isRenderingToDepthMap && numSkirtIndices > 0) {
+        skirtShader->use();
+        skirtShader->setMat4("model", model);
+        skirtShader->setMat4("view", view);
+        skirtShader->setMat4("projection", projection);
+        skirtShader->bindTexture("diffuseMap", diffuseMap.get(), 0);
+        skirtShader->setFloat("heightScale", heightScale);
+        skirtShader->setFloat("heightOffset", heightOffset);
+        skirtShader->setBool("useLighting", useLighting);
+        skirtShader->setFloat("ambientStrength", ambientStrength);
+        skirtShader->setVec3("lightDir", context->light->direction);
+        glBindVertexArray(skirtVAO);
+        glDrawElements(GL_TRIANGLES, numSkirtIndices, GL_UNSIGNED_INT, 0);
+    }
 
     // debug: show normals or light direction
     if (showNormals || context->showLightDirection) {
@@ -148,6 +859,8 @@ void Terrain::render() {
         normalShader->setMat4("view", view);
         normalShader->setMat4("projection", projection);
         normalShader->bindTexture("heightMap", heightMap.get(), 0);
+        normalShader->bindTexture("gradientMap", gradientMap, 1);
+        normalShader->setVec2("texelWorldSize", glm::vec2(horizontalScale / heightMap->width, horizontalScale / heightMap->height));
         normalShader->setFloat("heightScale", heightScale);
         normalShader->setFloat("heightOffset", heightOffset);
         normalShader->setInt("minTessLevel", minTessLevel);
@@ -157,7 +870,39 @@ void Terrain::render() {
         normalShader->setBool("showNormals", showNormals);
         normalShader->setBool("showLightDirection", context->showLightDirection);
         normalShader->setVec3("lightDir", context->light->direction);
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_PATCHES, 0, 4 * numStrips * numStrips);
+        normalShader->setBool("useInstancedGrid", useInstancedGrid);
+        normalShader->setBool("useCulledPatches", useCulledPatches);
+        normalShader->setInt("gridSize", numStrips);
+        normalShader->setVec2("terrainSize", terrainSize);
+        drawPatches(useCulledPatches);
+    }
+}
+
+void Terrain::drawPatches(bool useCulledPatches) {
+    if (useCulledPatches) {
+        // instance count and patch indices come from the culling pass
+        releasePatchBuffer();
+        if (isGpuCullingActive())
+            culler->draw();
+        else {
+            glBindVertexArray(cpuCulledVAO);
+            glDrawArraysInstanced(GL_PATCHES, 0, 4, cpuVisiblePatches.size());
+        }
+        return;
+    }
+    if (useInstancedGrid) {
+        releasePatchBuffer();
+        // a single 4-vertex patch, one instance per grid cell
+        glBindVertexArray(gridVAO);
+        glDrawArraysInstanced(GL_PATCHES, 0, 4, numStrips * numStrips);
+        return;
     }
+
+    // the per-vertex grid is built on first use after switching modes
+    if (VAO == 0 || patchBufferStrips != numStrips) {
+        releasePatchBuffer();
+        buildPatchBuffer();
+    }
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_PATCHES, 0, 4 * numStrips * numStrips);
 }
\ No newline at end of file
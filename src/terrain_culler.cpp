@@ -0,0 +1,119 @@
+#include "terrain_culler.h"
+#include "cpu_profiler.h"
+#include "utils.h"
+
+namespace {
+
+constexpr int CULL_GROUP_SIZE = 64;  // local_size_x of shader_terrain_cull.comp
+
+struct DrawArraysIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;
+};
+
+}  // namespace
+
+std::unique_ptr<TerrainCuller> TerrainCuller::create() {
+    // compute shaders, SSBOs and indirect draws with a base instance are all core in 4.3
+    if (!GLAD_GL_VERSION_4_3) {
+        SPDLOG_INFO("GPU terrain culling needs OpenGL 4.3, using the plain instanced draw");
+        return nullptr;
+    }
+    auto culler = std::unique_ptr<TerrainCuller>(new TerrainCuller());
+    if (!culler->init())
+        return nullptr;
+    return std::move(culler);
+}
+
+bool TerrainCuller::init() {
+    cullShader = std::make_unique<Shader>("../shaders/terrain/shader_terrain_cull.comp");
+
+    glGenBuffers(1, &boundsBuffer);
+    glGenBuffers(1, &visibleBuffer);
+    glGenBuffers(1, &commandBuffer);
+    DrawArraysIndirectCommand command = { 4, 0, 0, 0 };
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(command), &command, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    // location 2 of shader_terrain.vs, one patch index per instance
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+TerrainCuller::~TerrainCuller() {
+    glDeleteBuffers(1, &boundsBuffer);
+    glDeleteBuffers(1, &visibleBuffer);
+    glDeleteBuffers(1, &commandBuffer);
+    glDeleteVertexArrays(1, &VAO);
+}
+
+void TerrainCuller::updatePatchBounds(const std::vector<glm::vec2>& patchHeightRanges, int gridSize) {
+    if (patchHeightRanges.size() != (size_t)gridSize * gridSize || gridSize <= 0) {
+        this->gridSize = 0;
+        return;
+    }
+    this->gridSize = gridSize;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, patchHeightRanges.size() * sizeof(glm::vec2), patchHeightRanges.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, patchHeightRanges.size() * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void TerrainCuller::updatePatchBounds(const std::vector<glm::vec2>& patchHeightRanges, size_t first, size_t count) {
+    if (patchHeightRanges.size() != (size_t)gridSize * gridSize || first + count > patchHeightRanges.size())
+        return;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, first * sizeof(glm::vec2), count * sizeof(glm::vec2), patchHeightRanges.data() + first);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void TerrainCuller::cull(const glm::mat4& model, const glm::mat4& viewProjection, glm::vec2 terrainSize,
+    float heightScale, float heightOffset, const HiZBuffer* hiZ) {
+    PROFILE_FUNCTION();
+    // the GPU counts the survivors from zero every pass
+    DrawArraysIndirectCommand command = { 4, 0, 0, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(command), &command);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // frustum planes in the terrain's local space, the bounds never leave it
+    glm::vec4 planes[6];
+    extractFrustumPlanes(viewProjection * model, planes);
+
+    cullShader->use();
+    cullShader->setInt("gridSize", gridSize);
+    cullShader->setVec2("terrainSize", terrainSize);
+    cullShader->setFloat("heightScale", heightScale);
+    cullShader->setFloat("heightOffset", heightOffset);
+    for (int i = 0; i < 6; i++)
+        cullShader->setVec4("frustumPlanes[" + std::to_string(i) + "]", planes[i]);
+    cullShader->setBool("useOcclusion", hiZ != nullptr);
+    cullShader->setMat4("hiZMatrix", hiZ ? hiZ->getViewProjection() * model : glm::mat4(1.0f));
+    cullShader->setBool("hiZReverseZ", hiZ && hiZ->isReverseZ());
+    cullShader->bindTexture("hiZ", hiZ ? hiZ->getTexture() : 0, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, boundsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+    int numPatches = gridSize * gridSize;
+    glDispatchCompute((numPatches + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void TerrainCuller::draw() {
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glDrawArraysIndirect(GL_PATCHES, (void*)0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
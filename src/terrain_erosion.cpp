@@ -0,0 +1,306 @@
+#include "terrain_erosion.h"
+#include "cpu_profiler.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+namespace {
+constexpr int TILE_SIZE = 64;
+constexpr int HALO = 3;  // stencil radius of one iteration: flux, water update, transport and thermal
+constexpr int LOCAL_SIZE = TILE_SIZE + 2 * HALO;
+constexpr int LOCAL_AREA = LOCAL_SIZE * LOCAL_SIZE;
+constexpr float GRAVITY = 9.81f;
+constexpr float MIN_DEPTH = 1e-4f;          // shallower water does not move sediment
+constexpr float MAX_DISPLACEMENT = 0.99f;   // texels per iteration, keeps the transport inside the halo
+constexpr float SQRT2 = 1.41421356f;
+
+enum Direction { LEFT, RIGHT, DOWN, UP };
+
+// signed excess of the height difference to a neighbour over the talus limit, zero across a closed border
+inline float slide(float neighbour, float height, float limit, float isOpen) {
+    float difference = neighbour - height;
+    return isOpen * std::copysign(std::max(std::abs(difference) - limit, 0.0f), difference);
+}
+
+// one tile and its halo, allocated once per thread; index = y * LOCAL_SIZE + x
+struct TileFields {
+    float terrain[LOCAL_AREA];
+    float water[LOCAL_AREA];
+    float sediment[LOCAL_AREA];
+    float flux[4][LOCAL_AREA];
+    float newFlux[4][LOCAL_AREA];
+    float newWater[LOCAL_AREA];
+    float velocityX[LOCAL_AREA];
+    float velocityY[LOCAL_AREA];
+    float erodedTerrain[LOCAL_AREA];
+    float erodedSediment[LOCAL_AREA];
+};
+}
+
+std::unique_ptr<TerrainErosion> TerrainErosion::create() {
+    return std::unique_ptr<TerrainErosion>(new TerrainErosion());
+}
+
+void TerrainErosion::reset(const std::vector<float>& heights, int width, int height, float relief) {
+    PROFILE_FUNCTION();
+    this->width = width;
+    this->height = height;
+    this->relief = relief;
+    numTilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    numTilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    size_t size = (size_t)width * height;
+    for (auto& state : states) {
+        state.terrain.resize(size);
+        state.water.assign(size, 0.0f);
+        state.sediment.assign(size, 0.0f);
+        for (auto& flux : state.flux)
+            flux.assign(size, 0.0f);
+    }
+    std::transform(heights.begin(), heights.begin() + size, states[0].terrain.begin(),
+        [relief](float h) { return h * relief; });
+    states[1].terrain = states[0].terrain;
+    dirtyTiles.assign((size_t)numTilesX * numTilesY, 0);
+    current = 0;
+    iteration = 0;
+    ready = true;
+}
+
+void TerrainErosion::step(ThreadPool* threadPool, int numIterations) {
+    PROFILE_FUNCTION();
+    if (!ready)
+        return;
+    auto start = std::chrono::steady_clock::now();
+    int numTiles = numTilesX * numTilesY;
+    for (int i = 0; i < numIterations; i++) {
+        // every iteration reads one state and writes the other, tiles only share the read one
+        threadPool->parallelFor(numTiles, [this](int tileBegin, int tileEnd) { stepTiles(tileBegin, tileEnd); });
+        current ^= 1;
+        iteration++;
+    }
+    stepTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void TerrainErosion::stepTiles(int tileBegin, int tileEnd) {
+    thread_local std::unique_ptr<TileFields> fields;
+    if (!fields)
+        fields = std::make_unique<TileFields>();
+    TileFields& f = *fields;
+    const State& in = states[current];
+    State& out = states[current ^ 1];
+
+    const float dt = timeStep;
+    const float rain = hydraulic ? rainRate * dt : 0.0f;
+    const float maxSpeed = MAX_DISPLACEMENT / dt;
+    const float evaporationFactor = std::max(0.0f, 1.0f - evaporation * dt);
+    const float dissolveFactor = std::clamp(dissolving * dt, 0.0f, 1.0f);  // rates per second to this iteration
+    const float depositFactor = std::clamp(deposition * dt, 0.0f, 1.0f);
+    const float talus = std::tan(glm::radians(std::clamp(talusAngle, 0.0f, 89.0f)));
+    const float diagonalTalus = talus * SQRT2;
+    const float thermalWeight = thermal ? std::clamp(thermalRate, 0.0f, 1.0f) / 16.0f : 0.0f;  // stable up to 1/16
+
+    for (int tile = tileBegin; tile < tileEnd; tile++) {
+        // local (0, 0) is texel (originX, originY); texels outside the map are clamped copies that never exchange
+        int tileX = tile % numTilesX;
+        int tileY = tile / numTilesX;
+        int originX = tileX * TILE_SIZE - HALO;
+        int originY = tileY * TILE_SIZE - HALO;
+        int validX0 = std::max(0, -originX);
+        int validY0 = std::max(0, -originY);
+        int validX1 = std::min(LOCAL_SIZE, width - originX);
+        int validY1 = std::min(LOCAL_SIZE, height - originY);
+        int interiorX1 = std::min(HALO + TILE_SIZE, validX1);
+        int interiorY1 = std::min(HALO + TILE_SIZE, validY1);
+        // 1 where the left or right neighbour is inside the map; arrays keep the inner loops branch-free
+        float isLeftOpen[LOCAL_SIZE], isRightOpen[LOCAL_SIZE];
+        for (int x = 0; x < LOCAL_SIZE; x++) {
+            isLeftOpen[x] = x - 1 >= validX0 && x < validX1 ? 1.0f : 0.0f;
+            isRightOpen[x] = x + 1 < validX1 && x >= validX0 ? 1.0f : 0.0f;
+        }
+
+        // halo exchange: the tile and its neighbours' border texels of the current state
+        auto loadRow = [&](float* local, const std::vector<float>& global, size_t row, float offset) {
+            const float* source = global.data() + row;
+            for (int x = 0; x < validX0; x++)
+                local[x] = source[0] + offset;
+            for (int x = validX0; x < validX1; x++)
+                local[x] = source[originX + x] + offset;
+            for (int x = validX1; x < LOCAL_SIZE; x++)
+                local[x] = source[width - 1] + offset;
+        };
+        for (int y = 0; y < LOCAL_SIZE; y++) {
+            size_t row = (size_t)std::clamp(originY + y, 0, height - 1) * width;
+            int i = y * LOCAL_SIZE;
+            loadRow(f.terrain + i, in.terrain, row, 0.0f);
+            loadRow(f.water + i, in.water, row, rain);
+            loadRow(f.sediment + i, in.sediment, row, 0.0f);
+            for (int d = 0; d < 4; d++)
+                loadRow(f.flux[d] + i, in.flux[d], row, 0.0f);
+        }
+
+        if (hydraulic) {
+            // outflow flux through the four pipes, scaled so a texel never loses more water than it has;
+            // no flux leaves the map
+            for (int y = 1; y < LOCAL_SIZE - 1; y++) {
+                int row = y * LOCAL_SIZE;
+                for (int d = 0; d < 4; d++)
+                    std::fill(f.newFlux[d] + row, f.newFlux[d] + row + LOCAL_SIZE, 0.0f);
+                if (y < validY0 || y >= validY1)
+                    continue;
+                float isDownOpen = y - 1 >= validY0 ? 1.0f : 0.0f;
+                float isUpOpen = y + 1 < validY1 ? 1.0f : 0.0f;
+                for (int x = std::max(1, validX0); x < std::min(LOCAL_SIZE - 1, validX1); x++) {
+                    int i = row + x;
+                    float level = f.terrain[i] + f.water[i];
+                    auto outflow = [&](int d, int n, float isOpen) {
+                        return isOpen * std::max(0.0f, f.flux[d][i] + dt * GRAVITY * (level - f.terrain[n] - f.water[n]));
+                    };
+                    float left = outflow(LEFT, i - 1, isLeftOpen[x]);
+                    float right = outflow(RIGHT, i + 1, isRightOpen[x]);
+                    float down = outflow(DOWN, i - LOCAL_SIZE, isDownOpen);
+                    float up = outflow(UP, i + LOCAL_SIZE, isUpOpen);
+                    float total = (left + right + down + up) * dt;
+                    float scale = f.water[i] / std::max(total, f.water[i] + FLT_MIN);  // 1 unless the outflow exceeds the water
+                    f.newFlux[LEFT][i] = left * scale;
+                    f.newFlux[RIGHT][i] = right * scale;
+                    f.newFlux[DOWN][i] = down * scale;
+                    f.newFlux[UP][i] = up * scale;
+                }
+            }
+
+            // water update, velocity from the flux through the texel, then erosion or deposition
+            for (int y = std::max(2, validY0); y < std::min(LOCAL_SIZE - 2, validY1); y++) {
+                for (int x = std::max(2, validX0); x < std::min(LOCAL_SIZE - 2, validX1); x++) {
+                    int i = y * LOCAL_SIZE + x;
+                    float inflow = f.newFlux[RIGHT][i - 1] + f.newFlux[LEFT][i + 1]
+                        + f.newFlux[UP][i - LOCAL_SIZE] + f.newFlux[DOWN][i + LOCAL_SIZE];
+                    float outflow = f.newFlux[LEFT][i] + f.newFlux[RIGHT][i] + f.newFlux[DOWN][i] + f.newFlux[UP][i];
+                    float water = std::max(0.0f, f.water[i] + dt * (inflow - outflow));
+                    float meanDepth = std::max(0.5f * (f.water[i] + water), MIN_DEPTH);
+                    float flowX = 0.5f * (f.newFlux[RIGHT][i - 1] - f.newFlux[LEFT][i] + f.newFlux[RIGHT][i] - f.newFlux[LEFT][i + 1]);
+                    float flowY = 0.5f * (f.newFlux[UP][i - LOCAL_SIZE] - f.newFlux[DOWN][i]
+                        + f.newFlux[UP][i] - f.newFlux[DOWN][i + LOCAL_SIZE]);
+                    float velocityX = std::clamp(flowX / meanDepth, -maxSpeed, maxSpeed);
+                    float velocityY = std::clamp(flowY / meanDepth, -maxSpeed, maxSpeed);
+                    f.newWater[i] = water;
+                    f.velocityX[i] = velocityX;
+                    f.velocityY[i] = velocityY;
+
+                    // capacity grows with speed, slope and depth up to maxErosionDepth
+                    float slopeX = 0.5f * (f.terrain[i + 1] - f.terrain[i - 1]);
+                    float slopeY = 0.5f * (f.terrain[i + LOCAL_SIZE] - f.terrain[i - LOCAL_SIZE]);
+                    float slope2 = slopeX * slopeX + slopeY * slopeY;
+                    float sinTilt = std::sqrt(slope2 / (1.0f + slope2));
+                    float speed = std::sqrt(velocityX * velocityX + velocityY * velocityY);
+                    float depthFactor = std::min(water / maxErosionDepth, 1.0f);
+                    float capacity = sedimentCapacity * std::max(sinTilt, minTilt) * speed * depthFactor;
+                    float sediment = f.sediment[i];
+                    float change = (capacity > sediment ? dissolveFactor : depositFactor) * (capacity - sediment);
+                    f.erodedTerrain[i] = f.terrain[i] - change;
+                    f.erodedSediment[i] = sediment + change;
+                }
+            }
+        }
+        else {
+            for (int d = 0; d < 4; d++)
+                std::copy(f.flux[d], f.flux[d] + LOCAL_AREA, f.newFlux[d]);
+            std::copy(f.water, f.water + LOCAL_AREA, f.newWater);
+            std::fill(f.velocityX, f.velocityX + LOCAL_AREA, 0.0f);
+            std::fill(f.velocityY, f.velocityY + LOCAL_AREA, 0.0f);
+            std::copy(f.terrain, f.terrain + LOCAL_AREA, f.erodedTerrain);
+            std::copy(f.sediment, f.sediment + LOCAL_AREA, f.erodedSediment);
+        }
+
+        // semi-Lagrangian transport: the sediment arriving at a texel left the upstream point one step ago
+        int stepX = width > 1 ? 1 : 0;
+        int stepY = height > 1 ? LOCAL_SIZE : 0;
+        for (int y = HALO; y < interiorY1; y++) {
+            float* target = out.sediment.data() + (size_t)(originY + y) * width + originX;
+            for (int x = HALO; x < interiorX1; x++) {
+                int i = y * LOCAL_SIZE + x;
+                float sourceX = std::clamp(originX + x - f.velocityX[i] * dt, 0.0f, width - 1.0f);
+                float sourceY = std::clamp(originY + y - f.velocityY[i] * dt, 0.0f, height - 1.0f);
+                int cellX = std::min((int)sourceX, std::max(width - 2, 0));
+                int cellY = std::min((int)sourceY, std::max(height - 2, 0));
+                float fx = sourceX - cellX;
+                float fy = sourceY - cellY;
+                const float* corner = f.erodedSediment + (cellY - originY) * LOCAL_SIZE + (cellX - originX);
+                float bottom = corner[0] + (corner[stepX] - corner[0]) * fx;
+                float top = corner[stepY] + (corner[stepY + stepX] - corner[stepY]) * fx;
+                target[x] = bottom + (top - bottom) * fy;
+            }
+        }
+
+        // thermal: material slides across every neighbour pair steeper than the talus, symmetric so it is
+        // conserved; the masks close the map borders
+        int changed = 0;
+        for (int y = HALO; y < interiorY1; y++) {
+            size_t targetRow = (size_t)(originY + y) * width + originX;
+            const float* __restrict center = f.erodedTerrain + y * LOCAL_SIZE;
+            const float* __restrict below = center - LOCAL_SIZE;
+            const float* __restrict above = center + LOCAL_SIZE;
+            const float* __restrict water = f.newWater + y * LOCAL_SIZE;
+            const float* __restrict previous = in.terrain.data() + targetRow;
+            float* __restrict terrainOut = out.terrain.data() + targetRow;
+            float* __restrict waterOut = out.water.data() + targetRow;
+            float isDownOpen = y - 1 >= validY0 ? 1.0f : 0.0f;
+            float isUpOpen = y + 1 < validY1 ? 1.0f : 0.0f;
+            for (int x = HALO; x < interiorX1; x++) {
+                float h = center[x];
+                float transfer = slide(center[x - 1], h, talus, isLeftOpen[x]) + slide(center[x + 1], h, talus, isRightOpen[x])
+                    + slide(below[x], h, talus, isDownOpen) + slide(above[x], h, talus, isUpOpen)
+                    + slide(below[x - 1], h, diagonalTalus, isDownOpen * isLeftOpen[x])
+                    + slide(below[x + 1], h, diagonalTalus, isDownOpen * isRightOpen[x])
+                    + slide(above[x - 1], h, diagonalTalus, isUpOpen * isLeftOpen[x])
+                    + slide(above[x + 1], h, diagonalTalus, isUpOpen * isRightOpen[x]);
+                float terrain = h + thermalWeight * transfer;
+                changed |= terrain != previous[x];
+                terrainOut[x] = terrain;
+                waterOut[x] = water[x] * evaporationFactor;
+            }
+            for (int d = 0; d < 4; d++)
+                std::copy(f.newFlux[d] + y * LOCAL_SIZE + HALO, f.newFlux[d] + y * LOCAL_SIZE + interiorX1,
+                    out.flux[d].begin() + targetRow + HALO);
+        }
+        if (changed)
+            dirtyTiles[tile] = 1;
+    }
+}
+
+void TerrainErosion::collectDirtyRegions(std::vector<TexelRegion>& regions) {
+    regions.clear();
+    if (!ready)
+        return;
+
+    // runs of dirty tiles along each tile row, so an upload covers several tiles
+    for (int tileY = 0; tileY < numTilesY; tileY++) {
+        for (int tileX = 0; tileX < numTilesX; tileX++) {
+            if (!dirtyTiles[(size_t)tileY * numTilesX + tileX])
+                continue;
+            int runEnd = tileX;
+            while (runEnd < numTilesX && dirtyTiles[(size_t)tileY * numTilesX + runEnd])
+                dirtyTiles[(size_t)tileY * numTilesX + runEnd++] = 0;
+            regions.push_back({ tileX * TILE_SIZE, tileY * TILE_SIZE,
+                std::min(runEnd * TILE_SIZE, width), std::min((tileY + 1) * TILE_SIZE, height) });
+            tileX = runEnd;
+        }
+    }
+}
+
+void TerrainErosion::copyHeights(ThreadPool* threadPool, const std::vector<TexelRegion>& regions, std::vector<float>& heights) const {
+    PROFILE_FUNCTION();
+    if (!ready)
+        return;
+    const std::vector<float>& terrain = states[current].terrain;
+    float scale = 1.0f / relief;
+    threadPool->parallelFor(regions.size(), [&](int begin, int end) {
+        for (int r = begin; r < end; r++) {
+            for (int y = regions[r].y0; y < regions[r].y1; y++) {
+                size_t row = (size_t)y * width;
+                for (int x = regions[r].x0; x < regions[r].x1; x++)
+                    heights[row + x] = terrain[row + x] * scale;
+            }
+        }
+    });
+}
@@ -0,0 +1,357 @@
+#include "terrain_exporter.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr int BAND_ROWS = 32;           // rows per IDAT chunk, compressed as one unit
+constexpr int HASH_BITS = 15;
+constexpr size_t WINDOW_SIZE = 32768;
+constexpr int MIN_MATCH = 3;
+constexpr int MAX_MATCH = 258;
+constexpr uint32_t ADLER_BASE = 65521;
+
+constexpr uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83,
+    99, 115, 131, 163, 195, 227, 258 };
+constexpr uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+constexpr uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+constexpr uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+    12, 12, 13, 13 };
+
+// deflate streams are packed from the least significant bit, Huffman codes from their most significant one
+class BitWriter {
+public:
+    BitWriter(std::vector<uint8_t>& out) : out(out) {}
+    void write(uint32_t value, int numBits) {
+        bits |= value << count;
+        count += numBits;
+        for (; count >= 8; count -= 8, bits >>= 8)
+            out.push_back((uint8_t)bits);
+    }
+    void writeCode(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; i++)
+            reversed |= (code >> i & 1) << (length - 1 - i);
+        write(reversed, length);
+    }
+    void align() {
+        if (count > 0)
+            out.push_back((uint8_t)bits);
+        bits = 0;
+        count = 0;
+    }
+
+private:
+    std::vector<uint8_t>& out;
+    uint32_t bits = 0;
+    int count = 0;
+};
+
+void writeSymbol(BitWriter& writer, int symbol) {
+    // the fixed literal/length code of RFC 1951
+    if (symbol < 144)
+        writer.writeCode(0x30 + symbol, 8);
+    else if (symbol < 256)
+        writer.writeCode(0x190 + symbol - 144, 9);
+    else if (symbol < 280)
+        writer.writeCode(symbol - 256, 7);
+    else
+        writer.writeCode(0xc0 + symbol - 280, 8);
+}
+
+void writeMatch(BitWriter& writer, int length, int distance) {
+    int lengthCode = 28;
+    while (LENGTH_BASE[lengthCode] > length)
+        lengthCode--;
+    writeSymbol(writer, 257 + lengthCode);
+    writer.write(length - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode]);
+    int distanceCode = 29;
+    while (DISTANCE_BASE[distanceCode] > distance)
+        distanceCode--;
+    writer.writeCode(distanceCode, 5);
+    writer.write(distance - DISTANCE_BASE[distanceCode], DISTANCE_EXTRA[distanceCode]);
+}
+
+// One non-final fixed-Huffman block with greedy LZ77 matches, followed by an empty stored block so the output
+// ends on a byte boundary. Independently deflated bands concatenate into one valid stream this way.
+void deflateBand(const uint8_t* in, size_t size, std::vector<uint8_t>& out) {
+    BitWriter writer(out);
+    writer.write(0, 1);  // BFINAL
+    writer.write(1, 2);  // BTYPE fixed Huffman
+    std::vector<int32_t> table((size_t)1 << HASH_BITS, -1);
+    auto hash = [in](size_t position) {
+        uint32_t value = in[position] | (uint32_t)in[position + 1] << 8 | (uint32_t)in[position + 2] << 16;
+        return (value * 2654435761u) >> (32 - HASH_BITS);
+    };
+    size_t position = 0;
+    while (position < size) {
+        if (position + MIN_MATCH <= size) {
+            int32_t& entry = table[hash(position)];
+            int32_t candidate = entry;
+            entry = (int32_t)position;
+            if (candidate >= 0 && position - candidate <= WINDOW_SIZE) {
+                size_t maxLength = std::min<size_t>(MAX_MATCH, size - position);
+                size_t length = 0;
+                while (length < maxLength && in[candidate + length] == in[position + length])
+                    length++;
+                if (length >= MIN_MATCH) {
+                    writeMatch(writer, (int)length, (int)(position - candidate));
+                    position += length;
+                    continue;
+                }
+            }
+        }
+        writeSymbol(writer, in[position++]);
+    }
+    writeSymbol(writer, 256);  // end of block
+    writer.write(0, 3);        // empty stored block: BFINAL 0, BTYPE 0, then LEN and NLEN on a byte boundary
+    writer.align();
+    out.insert(out.end(), { 0x00, 0x00, 0xff, 0xff });
+}
+
+uint32_t computeAdler32(const uint8_t* data, size_t size) {
+    uint32_t a = 1;
+    uint32_t b = 0;
+    while (size > 0) {
+        size_t block = std::min<size_t>(size, 5552);  // the largest run without overflowing b
+        for (size_t i = 0; i < block; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+        data += block;
+        size -= block;
+    }
+    return b << 16 | a;
+}
+
+// checksum of two concatenated inputs from their checksums, as adler32_combine of zlib
+uint32_t combineAdler32(uint32_t first, uint32_t second, size_t secondSize) {
+    uint64_t remainder = secondSize % ADLER_BASE;
+    uint64_t a = (first & 0xffff) + (second & 0xffff) + ADLER_BASE - 1;
+    uint64_t b = remainder * (first & 0xffff) % ADLER_BASE + (first >> 16) + (second >> 16) + ADLER_BASE - remainder;
+    return (uint32_t)(b % ADLER_BASE << 16 | a % ADLER_BASE);
+}
+
+uint32_t computeCrc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    static const std::array<uint32_t, 256> table = []() {
+        std::array<uint32_t, 256> table;
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++)
+                value = value & 1 ? 0xedb88320u ^ (value >> 1) : value >> 1;
+            table[i] = value;
+        }
+        return table;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+    out.insert(out.end(), { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value });
+}
+
+void appendChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size) {
+    appendBigEndian(out, (uint32_t)size);
+    size_t typeOffset = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    appendBigEndian(out, computeCrc32(out.data() + typeOffset, size + 4));
+}
+
+uint8_t paeth(uint8_t left, uint8_t up, uint8_t upLeft) {
+    int estimate = left + up - upLeft;
+    int distanceLeft = std::abs(estimate - left);
+    int distanceUp = std::abs(estimate - up);
+    int distanceUpLeft = std::abs(estimate - upLeft);
+    if (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft)
+        return left;
+    return distanceUp <= distanceUpLeft ? up : upLeft;
+}
+
+// fills a row of the image, top row first, in PNG byte order (16-bit samples big-endian)
+using RowSource = std::function<void(int y, uint8_t* row)>;
+
+struct Band {
+    std::vector<uint8_t> chunk;  // complete IDAT chunk
+    uint32_t adler = 1;          // of the filtered rows
+    size_t filteredSize = 0;
+};
+
+void encodeBand(const RowSource& getRow, int y0, int y1, size_t rowBytes, int bytesPerPixel, Band& band) {
+    // every row is Paeth-filtered against the one above, which the band reads again for its first row
+    std::vector<uint8_t> previous(rowBytes, 0);
+    std::vector<uint8_t> current(rowBytes);
+    if (y0 > 0)
+        getRow(y0 - 1, previous.data());
+    std::vector<uint8_t> filtered;
+    filtered.reserve((rowBytes + 1) * (y1 - y0));
+    for (int y = y0; y < y1; y++) {
+        getRow(y, current.data());
+        filtered.push_back(4);  // filter type Paeth
+        for (size_t i = 0; i < rowBytes; i++) {
+            uint8_t left = i >= (size_t)bytesPerPixel ? current[i - bytesPerPixel] : 0;
+            uint8_t upLeft = i >= (size_t)bytesPerPixel ? previous[i - bytesPerPixel] : 0;
+            filtered.push_back(current[i] - paeth(left, previous[i], upLeft));
+        }
+        std::swap(previous, current);
+    }
+    band.adler = computeAdler32(filtered.data(), filtered.size());
+    band.filteredSize = filtered.size();
+    std::vector<uint8_t> deflated;
+    deflated.reserve(filtered.size() / 2);
+    deflateBand(filtered.data(), filtered.size(), deflated);
+    band.chunk.clear();
+    appendChunk(band.chunk, "IDAT", deflated.data(), deflated.size());
+}
+
+// PNG with one zlib stream split over an IDAT chunk per band; batches of bands are encoded in parallel and
+// written in order, then released
+bool writePNG(ThreadPool* encoders, const std::string& filePath, int width, int height, int channels, int bitDepth,
+    const RowSource& getRow, std::atomic<int>& rowsWritten) {
+    PROFILE_FUNCTION();
+    std::string partialPath = filePath + ".part";
+    FILE* file = std::fopen(partialPath.c_str(), "wb");
+    if (!file) {
+        SPDLOG_ERROR("Failed to open {}", partialPath);
+        return false;
+    }
+    std::vector<uint8_t> header = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    std::vector<uint8_t> fields;
+    appendBigEndian(fields, width);
+    appendBigEndian(fields, height);
+    uint8_t colorType = channels == 1 ? 0 : channels == 3 ? 2 : 6;
+    fields.insert(fields.end(), { (uint8_t)bitDepth, colorType, 0, 0, 0 });
+    appendChunk(header, "IHDR", fields.data(), fields.size());
+    const uint8_t zlibHeader[2] = { 0x78, 0x01 };  // deflate with a 32K window, no dictionary
+    appendChunk(header, "IDAT", zlibHeader, 2);
+    bool written = std::fwrite(header.data(), 1, header.size(), file) == header.size();
+
+    int bytesPerPixel = channels * bitDepth / 8;
+    size_t rowBytes = (size_t)width * bytesPerPixel;
+    int numBands = (height + BAND_ROWS - 1) / BAND_ROWS;
+    int bandsPerBatch = 2 * (encoders->getNumThreads() + 1);
+    std::vector<Band> bands(bandsPerBatch);
+    uint32_t adler = 1;
+    for (int firstBand = 0; firstBand < numBands && written; firstBand += bandsPerBatch) {
+        int count = std::min(bandsPerBatch, numBands - firstBand);
+        encoders->parallelFor(count, [&](int begin, int end) {
+            for (int b = begin; b < end; b++) {
+                int y0 = (firstBand + b) * BAND_ROWS;
+                encodeBand(getRow, y0, std::min(y0 + BAND_ROWS, height), rowBytes, bytesPerPixel, bands[b]);
+            }
+        });
+        for (int b = 0; b < count && written; b++) {
+            written = std::fwrite(bands[b].chunk.data(), 1, bands[b].chunk.size(), file) == bands[b].chunk.size();
+            adler = combineAdler32(adler, bands[b].adler, bands[b].filteredSize);
+        }
+        rowsWritten += std::min((firstBand + count) * BAND_ROWS, height) - firstBand * BAND_ROWS;
+    }
+
+    // an empty final stored block and the checksum end the stream
+    std::vector<uint8_t> trailer;
+    std::vector<uint8_t> streamEnd = { 0x01, 0x00, 0x00, 0xff, 0xff };
+    appendBigEndian(streamEnd, adler);
+    appendChunk(trailer, "IDAT", streamEnd.data(), streamEnd.size());
+    appendChunk(trailer, "IEND", nullptr, 0);
+    if (written)
+        written = std::fwrite(trailer.data(), 1, trailer.size(), file) == trailer.size();
+    written &= std::fclose(file) == 0;
+
+    std::error_code error;
+    if (written)
+        fs::rename(partialPath, filePath, error);
+    if (!written || error) {
+        SPDLOG_ERROR("Failed to write {}", filePath);
+        fs::remove(partialPath, error);
+        return false;
+    }
+    return true;
+}
+}
+
+std::unique_ptr<TerrainExporter> TerrainExporter::create() {
+    auto exporter = std::unique_ptr<TerrainExporter>(new TerrainExporter());
+    exporter->writer = ThreadPool::create(1);
+    // half of the cores, the frame's own work keeps the rest
+    exporter->encoders = ThreadPool::create(std::max(1, (int)std::thread::hardware_concurrency() / 2 - 1));
+    return std::move(exporter);
+}
+
+TerrainExporter::~TerrainExporter() {
+    writer->wait();  // a half-written terrain would still be listed
+}
+
+bool TerrainExporter::start(Job&& job) {
+    if (exporting)
+        return false;
+    exporting = true;
+    rowsWritten = 0;
+    totalRows = job.colors.empty() ? job.height : 2 * job.height;
+    directory = job.directory;
+    SPDLOG_INFO("Exporting terrain ({} x {}) to {}", job.width, job.height, directory);
+    writer->submit([this, job = std::move(job)]() {
+        run(job);
+        exporting = false;
+    });
+    return true;
+}
+
+float TerrainExporter::getProgress() const {
+    return totalRows > 0 ? std::min((float)rowsWritten / totalRows, 1.0f) : 0.0f;
+}
+
+void TerrainExporter::run(const Job& job) {
+    PROFILE_FUNCTION();
+    std::error_code error;
+    fs::create_directories(job.directory, error);
+    if (error) {
+        SPDLOG_ERROR("Failed to create {}: {}", job.directory, error.message());
+        return;
+    }
+
+    // rows are in texture order, bottom first, and PNGs are stored top first
+    int width = job.width;
+    int height = job.height;
+    bool succeeded = writePNG(encoders.get(), job.directory + "/Height Map.png", width, height, 1, 16,
+        [&](int y, uint8_t* row) {
+            const uint16_t* samples = job.heights.data() + (size_t)(height - 1 - y) * width;
+            for (int x = 0; x < width; x++) {
+                row[2 * x] = (uint8_t)(samples[x] >> 8);
+                row[2 * x + 1] = (uint8_t)samples[x];
+            }
+        }, rowsWritten);
+
+    std::string diffusePath = job.directory + "/Diffuse Map.png";
+    if (succeeded && !job.colors.empty()) {
+        int channels = job.colorChannels;
+        succeeded = writePNG(encoders.get(), diffusePath, width, height, 3, 8,
+            [&](int y, uint8_t* row) {
+                const uint8_t* texels = job.colors.data() + (size_t)(height - 1 - y) * width * channels;
+                for (int x = 0; x < width; x++, texels += channels) {
+                    row[3 * x] = texels[0];
+                    row[3 * x + 1] = texels[1];
+                    row[3 * x + 2] = texels[2];
+                }
+            }, rowsWritten);
+    }
+    else if (succeeded && !job.diffuseSource.empty() && !fs::equivalent(job.diffuseSource, diffusePath, error)) {
+        fs::copy_file(job.diffuseSource, diffusePath, fs::copy_options::overwrite_existing, error);
+        if (error) {
+            SPDLOG_ERROR("Failed to copy {}: {}", job.diffuseSource, error.message());
+            succeeded = false;
+        }
+    }
+    if (succeeded)
+        SPDLOG_INFO("Terrain exported to {}, listed from the next start", job.directory);
+}
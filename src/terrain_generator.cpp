@@ -0,0 +1,422 @@
+#include "terrain_generator.h"
+#include "thread_pool.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+
+// the row kernel uses GCC/Clang vector extensions: eight lanes, two SSE2 or NEON registers per operation.
+// On x86-64 Linux it is also compiled for AVX2 and the loader picks the variant the CPU supports.
+// Other x86 compilers (MSVC) get a four-lane SSE2 kernel written with intrinsics.
+#if defined(__GNUC__)
+#define GENERATOR_VECTOR
+#define GENERATOR_INLINE inline __attribute__((always_inline))
+#if defined(__x86_64__) && defined(__linux__)
+#define GENERATOR_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define GENERATOR_CLONES
+#endif
+#elif defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GENERATOR_SSE
+#include <emmintrin.h>
+#endif
+
+namespace {
+constexpr uint32_t HASH_X = 0x8da6b343u;
+constexpr uint32_t HASH_Y = 0xd8163841u;
+constexpr uint32_t HASH_SEED = 0xcb1ab31fu;
+constexpr float GRADIENT_RANGE = 1.5f;  // gradient components in [-1.5, 1.5], the noise then spans about [-1, 1]
+constexpr float GRADIENT_SCALE = 2.0f * GRADIENT_RANGE / 65535.0f;
+constexpr float NOMINAL_RELIEF = 0.3f;  // height over horizontal scale of the default terrain, for the slope ramp
+
+// lattice hash: the corner products are combined before an integer finalizer, so the neighbor at
+// x + 1 is the product plus HASH_X and every corner costs the finalizer only
+inline uint32_t finalizeHash(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+// gradient from the low and high half of the hash
+inline float gradientDot(uint32_t h, float x, float y) {
+    return ((float)(h & 0xffffu) * GRADIENT_SCALE - GRADIENT_RANGE) * x + ((float)(h >> 16) * GRADIENT_SCALE - GRADIENT_RANGE) * y;
+}
+
+inline float fade(float t) {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+// 2D gradient noise, roughly in [-1, 1]; the reference for the vector kernel
+float gradientNoise(float x, float y, uint32_t seed) {
+    int ix = (int)x;
+    int iy = (int)y;
+    ix -= (float)ix > x ? 1 : 0;
+    iy -= (float)iy > y ? 1 : 0;
+    float fx = x - (float)ix;
+    float fy = y - (float)iy;
+    uint32_t hx = (uint32_t)ix * HASH_X;
+    uint32_t hy = (uint32_t)iy * HASH_Y ^ seed * HASH_SEED;
+    float n00 = gradientDot(finalizeHash(hx ^ hy), fx, fy);
+    float n10 = gradientDot(finalizeHash((hx + HASH_X) ^ hy), fx - 1.0f, fy);
+    hy = (uint32_t)(iy + 1) * HASH_Y ^ seed * HASH_SEED;
+    float n01 = gradientDot(finalizeHash(hx ^ hy), fx, fy - 1.0f);
+    float n11 = gradientDot(finalizeHash((hx + HASH_X) ^ hy), fx - 1.0f, fy - 1.0f);
+    float u = fade(fx);
+    float v = fade(fy);
+    float bottom = n00 + (n10 - n00) * u;
+    float top = n01 + (n11 - n01) * u;
+    return bottom + (top - bottom) * v;
+}
+
+float fractalNoise(const TerrainGenerator& generator, float x, float y) {
+    float sum = 0.0f;
+    float scale = 1.0f;
+    float amplitude = 1.0f;
+    float weight = 1.0f;
+    for (int octave = 0; octave < generator.octaves; octave++) {
+        float n = gradientNoise(x * scale, y * scale, (uint32_t)(generator.seed + octave));
+        if (generator.noiseType == TerrainGenerator::RIDGED) {
+            // sharp crests where the noise crosses zero; each octave is damped where the previous one was low
+            n = 1.0f - std::abs(n);
+            n = n * n * weight;
+            weight = std::min(n * 2.0f, 1.0f);
+        }
+        sum += n * amplitude;
+        scale *= generator.lacunarity;
+        amplitude *= generator.gain;
+    }
+    return sum;
+}
+
+#if defined(GENERATOR_VECTOR) || defined(GENERATOR_SSE)
+// lattice row of one octave: every lane of a row shares it
+struct LatticeRow {
+    uint32_t hash0;  // y and seed part of the hash below and above the sample
+    uint32_t hash1;
+    float fy;
+    float v;
+};
+
+LatticeRow latticeRow(float y, uint32_t seed) {
+    int iy = (int)y;
+    iy -= (float)iy > y ? 1 : 0;
+    LatticeRow row;
+    row.hash0 = (uint32_t)iy * HASH_Y ^ seed * HASH_SEED;
+    row.hash1 = (uint32_t)(iy + 1) * HASH_Y ^ seed * HASH_SEED;
+    row.fy = y - (float)iy;
+    row.v = fade(row.fy);
+    return row;
+}
+#endif
+
+#if defined(GENERATOR_VECTOR)
+constexpr int LANES = 8;
+typedef float floatv __attribute__((vector_size(32)));
+typedef int32_t intv __attribute__((vector_size(32)));
+typedef uint32_t uintv __attribute__((vector_size(32)));
+
+// the helpers take and return vectors by reference: a 32-byte vector passed by value changes the ABI
+// without AVX, which GCC reports even though every call is inlined
+GENERATOR_INLINE void finalizeHash(uintv& h) {
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+}
+
+GENERATOR_INLINE void gradientDot(const uintv& h, const floatv& x, const floatv& y, floatv& dot) {
+    floatv gradientX = __builtin_convertvector((intv)(h & 0xffffu), floatv) * GRADIENT_SCALE - GRADIENT_RANGE;
+    floatv gradientY = __builtin_convertvector((intv)(h >> 16), floatv) * GRADIENT_SCALE - GRADIENT_RANGE;
+    dot = gradientX * x + gradientY * y;
+}
+
+GENERATOR_INLINE void gradientNoise(const floatv& x, const LatticeRow& row, floatv& noise) {
+    intv ix = __builtin_convertvector(x, intv);  // truncation, then floor: comparisons are -1 where true
+    ix += (intv)(__builtin_convertvector(ix, floatv) > x);
+    floatv fx = x - __builtin_convertvector(ix, floatv);
+    floatv fx1 = fx - 1.0f;
+    floatv fy = floatv{} + row.fy;
+    floatv fy1 = fy - 1.0f;
+    uintv hx = (uintv)ix * HASH_X;
+    uintv h00 = hx ^ row.hash0;
+    uintv h10 = (hx + HASH_X) ^ row.hash0;
+    uintv h01 = hx ^ row.hash1;
+    uintv h11 = (hx + HASH_X) ^ row.hash1;
+    finalizeHash(h00);
+    finalizeHash(h10);
+    finalizeHash(h01);
+    finalizeHash(h11);
+    floatv n00, n10, n01, n11;
+    gradientDot(h00, fx, fy, n00);
+    gradientDot(h10, fx1, fy, n10);
+    gradientDot(h01, fx, fy1, n01);
+    gradientDot(h11, fx1, fy1, n11);
+    floatv u = fx * fx * fx * (fx * (fx * 6.0f - 15.0f) + 10.0f);  // fade
+    floatv bottom = n00 + (n10 - n00) * u;
+    floatv top = n01 + (n11 - n01) * u;
+    noise = bottom + (top - bottom) * row.v;
+}
+
+// fractal values of width texels of a row, eight at a time; the tail goes through the scalar reference
+GENERATOR_CLONES void fractalRow(const TerrainGenerator& generator, float y, float step, int width, float* out) {
+    LatticeRow rows[TerrainGenerator::MAX_OCTAVES];
+    float scales[TerrainGenerator::MAX_OCTAVES];
+    float amplitudes[TerrainGenerator::MAX_OCTAVES];
+    float scale = 1.0f;
+    float amplitude = 1.0f;
+    for (int octave = 0; octave < generator.octaves; octave++) {
+        rows[octave] = latticeRow(y * scale, (uint32_t)(generator.seed + octave));
+        scales[octave] = scale;
+        amplitudes[octave] = amplitude;
+        scale *= generator.lacunarity;
+        amplitude *= generator.gain;
+    }
+
+    floatv laneOffsets;
+    for (int lane = 0; lane < LANES; lane++)
+        laneOffsets[lane] = (float)lane;
+    bool ridged = generator.noiseType == TerrainGenerator::RIDGED;
+    int x = 0;
+    for (; x + LANES <= width; x += LANES) {
+        floatv sampleX = ((float)x + laneOffsets + 0.5f) * step;
+        floatv sum = {};
+        floatv weight = floatv{} + 1.0f;
+        for (int octave = 0; octave < generator.octaves; octave++) {
+            floatv n;
+            gradientNoise(sampleX * scales[octave], rows[octave], n);
+            if (ridged) {
+                n = 1.0f - (floatv)((intv)n & 0x7fffffff);
+                n = n * n * weight;
+                floatv doubled = n * 2.0f;
+                intv isAbove = (intv)(doubled > 1.0f);
+                weight = (floatv)((isAbove & (intv)(floatv{} + 1.0f)) | (~isAbove & (intv)doubled));
+            }
+            sum += n * amplitudes[octave];
+        }
+        std::copy((const float*)&sum, (const float*)&sum + LANES, out + x);
+    }
+    for (; x < width; x++)
+        out[x] = fractalNoise(generator, ((float)x + 0.5f) * step, y);
+}
+#elif defined(GENERATOR_SSE)
+constexpr int LANES = 4;
+
+// SSE2 has no 32-bit low multiply, the even and odd lanes go through the 64-bit one
+inline __m128i multiply(__m128i a, uint32_t b) {
+    __m128i factor = _mm_set1_epi32((int)b);
+    __m128i even = _mm_mul_epu32(a, factor);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), factor);
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+inline __m128i finalizeHash(__m128i h) {
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+    h = multiply(h, 0x7feb352du);
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    h = multiply(h, 0x846ca68bu);
+    return _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+}
+
+inline __m128 gradientDot(__m128i h, __m128 x, __m128 y) {
+    __m128 gradientX = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(h, _mm_set1_epi32(0xffff))),
+        _mm_set1_ps(GRADIENT_SCALE)), _mm_set1_ps(GRADIENT_RANGE));
+    __m128 gradientY = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(h, 16)), _mm_set1_ps(GRADIENT_SCALE)),
+        _mm_set1_ps(GRADIENT_RANGE));
+    return _mm_add_ps(_mm_mul_ps(gradientX, x), _mm_mul_ps(gradientY, y));
+}
+
+inline __m128 fade(__m128 t) {
+    __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))),
+        _mm_set1_ps(10.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+inline __m128 gradientNoise(__m128 x, const LatticeRow& row) {
+    __m128i ix = _mm_cvttps_epi32(x);
+    ix = _mm_add_epi32(ix, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(ix), x)));  // floor: -1 where truncated up
+    __m128 fx = _mm_sub_ps(x, _mm_cvtepi32_ps(ix));
+    __m128 fx1 = _mm_sub_ps(fx, _mm_set1_ps(1.0f));
+    __m128 fy = _mm_set1_ps(row.fy);
+    __m128 fy1 = _mm_set1_ps(row.fy - 1.0f);
+    __m128i hash0 = _mm_set1_epi32((int)row.hash0);
+    __m128i hash1 = _mm_set1_epi32((int)row.hash1);
+    __m128i hx = multiply(ix, HASH_X);
+    __m128i hx1 = _mm_add_epi32(hx, _mm_set1_epi32((int)HASH_X));
+    __m128 n00 = gradientDot(finalizeHash(_mm_xor_si128(hx, hash0)), fx, fy);
+    __m128 n10 = gradientDot(finalizeHash(_mm_xor_si128(hx1, hash0)), fx1, fy);
+    __m128 n01 = gradientDot(finalizeHash(_mm_xor_si128(hx, hash1)), fx, fy1);
+    __m128 n11 = gradientDot(finalizeHash(_mm_xor_si128(hx1, hash1)), fx1, fy1);
+    __m128 u = fade(fx);
+    __m128 bottom = _mm_add_ps(n00, _mm_mul_ps(_mm_sub_ps(n10, n00), u));
+    __m128 top = _mm_add_ps(n01, _mm_mul_ps(_mm_sub_ps(n11, n01), u));
+    return _mm_add_ps(bottom, _mm_mul_ps(_mm_sub_ps(top, bottom), _mm_set1_ps(row.v)));
+}
+
+// fractal values of width texels of a row, four at a time; the tail goes through the scalar reference
+void fractalRow(const TerrainGenerator& generator, float y, float step, int width, float* out) {
+    LatticeRow rows[TerrainGenerator::MAX_OCTAVES];
+    float scales[TerrainGenerator::MAX_OCTAVES];
+    float amplitudes[TerrainGenerator::MAX_OCTAVES];
+    float scale = 1.0f;
+    float amplitude = 1.0f;
+    for (int octave = 0; octave < generator.octaves; octave++) {
+        rows[octave] = latticeRow(y * scale, (uint32_t)(generator.seed + octave));
+        scales[octave] = scale;
+        amplitudes[octave] = amplitude;
+        scale *= generator.lacunarity;
+        amplitude *= generator.gain;
+    }
+
+    const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 one = _mm_set1_ps(1.0f);
+    bool ridged = generator.noiseType == TerrainGenerator::RIDGED;
+    int x = 0;
+    for (; x + LANES <= width; x += LANES) {
+        __m128 sampleX = _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)x), laneOffsets), _mm_set1_ps(step));
+        __m128 sum = _mm_setzero_ps();
+        __m128 weight = one;
+        for (int octave = 0; octave < generator.octaves; octave++) {
+            __m128 n = gradientNoise(_mm_mul_ps(sampleX, _mm_set1_ps(scales[octave])), rows[octave]);
+            if (ridged) {
+                n = _mm_sub_ps(one, _mm_and_ps(n, absMask));
+                n = _mm_mul_ps(_mm_mul_ps(n, n), weight);
+                weight = _mm_min_ps(_mm_add_ps(n, n), one);
+            }
+            sum = _mm_add_ps(sum, _mm_mul_ps(n, _mm_set1_ps(amplitudes[octave])));
+        }
+        _mm_storeu_ps(out + x, sum);
+    }
+    for (; x < width; x++)
+        out[x] = fractalNoise(generator, ((float)x + 0.5f) * step, y);
+}
+#else
+void fractalRow(const TerrainGenerator& generator, float y, float step, int width, float* out) {
+    for (int x = 0; x < width; x++)
+        out[x] = fractalNoise(generator, ((float)x + 0.5f) * step, y);
+}
+#endif
+
+struct RampStop {
+    float height;
+    glm::vec3 color;
+};
+const RampStop HEIGHT_RAMP[] = {
+    { 0.00f, glm::vec3(0.36f, 0.31f, 0.22f) },  // dirt in the valleys
+    { 0.20f, glm::vec3(0.33f, 0.45f, 0.20f) },  // grass
+    { 0.50f, glm::vec3(0.23f, 0.35f, 0.16f) },  // forest
+    { 0.72f, glm::vec3(0.45f, 0.42f, 0.38f) },  // rock
+    { 0.86f, glm::vec3(0.93f, 0.94f, 0.96f) },  // snow
+};
+const glm::vec3 ROCK_COLOR(0.42f, 0.39f, 0.36f);
+constexpr int RAMP_SIZE = 1024;  // entries of the height ramp table
+constexpr int ROCK_SIZE = 256;   // entries of the rock weight table, over the squared slope in [0, 1]
+
+glm::vec3 rampColor(float height) {
+    const int numStops = sizeof(HEIGHT_RAMP) / sizeof(HEIGHT_RAMP[0]);
+    for (int i = 1; i < numStops; i++) {
+        if (height < HEIGHT_RAMP[i].height) {
+            float t = (height - HEIGHT_RAMP[i - 1].height) / (HEIGHT_RAMP[i].height - HEIGHT_RAMP[i - 1].height);
+            return glm::mix(HEIGHT_RAMP[i - 1].color, HEIGHT_RAMP[i].color, t);
+        }
+    }
+    return HEIGHT_RAMP[numStops - 1].color;
+}
+}
+
+std::unique_ptr<TerrainGenerator> TerrainGenerator::create() {
+    return std::unique_ptr<TerrainGenerator>(new TerrainGenerator());
+}
+
+void TerrainGenerator::clampParameters() {
+    resolution = std::max(resolution, 2);
+    octaves = std::clamp(octaves, 1, MAX_OCTAVES);
+}
+
+float TerrainGenerator::evaluate(float u, float v) const {
+    return fractalNoise(*this, u * frequency, v * frequency);
+}
+
+void TerrainGenerator::generate(ThreadPool* threadPool, std::vector<float>& heights, std::vector<unsigned char>& colors) {
+    PROFILE_FUNCTION();
+    auto start = std::chrono::steady_clock::now();
+    clampParameters();
+    int size = resolution;
+    heights.resize((size_t)size * size);
+    colors.resize((size_t)size * size * 3);
+    auto forEachRow = [&](const std::function<void(int begin, int end)>& body) {
+        if (threadPool)
+            threadPool->parallelFor(size, body);
+        else
+            body(0, size);
+    };
+
+    // raw fractal values and the range of every row
+    std::vector<glm::vec2> rowRanges(size);
+    float step = frequency / size;
+    forEachRow([&](int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            float* row = heights.data() + (size_t)y * size;
+            fractalRow(*this, ((float)y + 0.5f) * step, step, size, row);
+            auto range = std::minmax_element(row, row + size);
+            rowRanges[y] = glm::vec2(*range.first, *range.second);
+        }
+    });
+    float minValue = FLT_MAX;
+    float maxValue = -FLT_MAX;
+    for (const auto& range : rowRanges) {
+        minValue = std::min(minValue, range.x);
+        maxValue = std::max(maxValue, range.y);
+    }
+    float scale = maxValue > minValue ? 1.0f / (maxValue - minValue) : 0.0f;
+
+    // colors by normalized height, steep ground turns to rock. Both go through tables so the loop is
+    // integer only; it reads the raw values, so the rows are independent.
+    uint8_t ramp[RAMP_SIZE][3];
+    for (int i = 0; i < RAMP_SIZE; i++) {
+        glm::vec3 color = rampColor(i / (RAMP_SIZE - 1.0f));
+        for (int c = 0; c < 3; c++)
+            ramp[i][c] = (uint8_t)(std::clamp(color[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+    uint8_t rock[3];
+    for (int c = 0; c < 3; c++)
+        rock[c] = (uint8_t)(ROCK_COLOR[c] * 255.0f + 0.5f);
+    int rockWeights[ROCK_SIZE + 1];  // 0..256
+    for (int i = 0; i <= ROCK_SIZE; i++) {
+        float slope = std::sqrt(i / (float)ROCK_SIZE);
+        rockWeights[i] = (int)(glm::smoothstep(0.4f, 1.0f, slope) * std::clamp(slopeRock, 0.0f, 1.0f) * 256.0f + 0.5f);
+    }
+    forEachRow([&](int begin, int end) {
+        // slopes at the default terrain scales over a baseline of a few texels, so the finest octaves do
+        // not speckle the rock; squared and mapped to the rock table
+        int baseline = std::max(size / 256, 1);
+        float slopeScale = scale * size * NOMINAL_RELIEF * 0.5f / baseline;
+        float slopeToIndex = slopeScale * slopeScale * ROCK_SIZE;
+        float heightToIndex = scale * (RAMP_SIZE - 1);
+        for (int y = begin; y < end; y++) {
+            const float* row = heights.data() + (size_t)y * size;
+            const float* above = heights.data() + (size_t)std::max(y - baseline, 0) * size;
+            const float* below = heights.data() + (size_t)std::min(y + baseline, size - 1) * size;
+            unsigned char* out = colors.data() + (size_t)y * size * 3;
+            for (int x = 0; x < size; x++) {
+                float slopeX = row[std::min(x + baseline, size - 1)] - row[std::max(x - baseline, 0)];
+                float slopeY = below[x] - above[x];
+                int rockIndex = (int)std::min((slopeX * slopeX + slopeY * slopeY) * slopeToIndex, (float)ROCK_SIZE);
+                int weight = rockWeights[rockIndex];
+                const uint8_t* color = ramp[std::clamp((int)((row[x] - minValue) * heightToIndex + 0.5f), 0, RAMP_SIZE - 1)];
+                for (int c = 0; c < 3; c++)
+                    out[x * 3 + c] = (unsigned char)((color[c] * (256 - weight) + rock[c] * weight) >> 8);
+            }
+        }
+    });
+
+    forEachRow([&](int begin, int end) {
+        for (float* h = heights.data() + (size_t)begin * size; h < heights.data() + (size_t)end * size; h++)
+            *h = (*h - minValue) * scale;
+    });
+    generationTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,432 @@
+#include "terrain_history.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr int TILE_SIZE = 64;
+constexpr int TILE_AREA = TILE_SIZE * TILE_SIZE;
+constexpr int MIN_MATCH = 4;
+constexpr int HASH_BITS = 12;
+constexpr size_t MAX_OFFSET = 65535;
+
+void writeLength(std::vector<uint8_t>& out, size_t length) {
+    for (; length >= 255; length -= 255)
+        out.push_back(255);
+    out.push_back((uint8_t)length);
+}
+
+bool readLength(const uint8_t* in, size_t size, size_t& position, size_t& length) {
+    uint8_t byte;
+    do {
+        if (position >= size)
+            return false;
+        byte = in[position++];
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// LZ77 in the block layout of LZ4: a token with the literal and match lengths (4 bits each, longer ones
+// continue in extra bytes), the literals, a 16-bit match offset; the last sequence has literals only.
+// Matches may overlap their source, so a run of zeros costs a few bytes.
+void compressBlock(const uint8_t* in, size_t size, std::vector<uint8_t>& out) {
+    out.clear();
+    std::vector<uint32_t> table(1 << HASH_BITS, 0);  // last position + 1 per hash of 4 bytes
+    auto hash = [in](size_t position) {
+        uint32_t value;
+        std::memcpy(&value, in + position, 4);
+        return (value * 2654435761u) >> (32 - HASH_BITS);
+    };
+    auto emit = [&](size_t literalBegin, size_t literalEnd, size_t matchLength, size_t offset) {
+        size_t literalLength = literalEnd - literalBegin;
+        size_t extraMatch = matchLength > 0 ? matchLength - MIN_MATCH : 0;
+        out.push_back((uint8_t)(std::min<size_t>(literalLength, 15) << 4 | std::min<size_t>(extraMatch, 15)));
+        if (literalLength >= 15)
+            writeLength(out, literalLength - 15);
+        out.insert(out.end(), in + literalBegin, in + literalEnd);
+        if (matchLength == 0)
+            return;
+        out.push_back((uint8_t)(offset & 0xff));
+        out.push_back((uint8_t)(offset >> 8));
+        if (extraMatch >= 15)
+            writeLength(out, extraMatch - 15);
+    };
+
+    size_t anchor = 0;
+    size_t position = 0;
+    while (position + MIN_MATCH <= size) {
+        uint32_t& entry = table[hash(position)];
+        size_t candidate = entry;
+        entry = (uint32_t)(position + 1);
+        if (candidate == 0 || position - (candidate - 1) > MAX_OFFSET
+            || std::memcmp(in + candidate - 1, in + position, MIN_MATCH) != 0) {
+            position++;
+            continue;
+        }
+        size_t match = candidate - 1;
+        size_t length = MIN_MATCH;
+        while (position + length < size && in[match + length] == in[position + length])
+            length++;
+        emit(anchor, position, length, position - match);
+        position += length;
+        anchor = position;
+    }
+    emit(anchor, size, 0, 0);
+}
+
+bool decompressBlock(const uint8_t* in, size_t size, uint8_t* out, size_t outSize) {
+    size_t position = 0;
+    size_t written = 0;
+    while (position < size) {
+        uint8_t token = in[position++];
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(in, size, position, literalLength))
+            return false;
+        if (position + literalLength > size || written + literalLength > outSize)
+            return false;
+        std::memcpy(out + written, in + position, literalLength);
+        position += literalLength;
+        written += literalLength;
+        if (position == size)
+            break;  // the last sequence
+
+        if (position + 2 > size)
+            return false;
+        size_t offset = in[position] | (size_t)in[position + 1] << 8;
+        position += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(in, size, position, matchLength))
+            return false;
+        matchLength += MIN_MATCH;
+        if (offset == 0 || offset > written || written + matchLength > outSize)
+            return false;
+        for (size_t i = 0; i < matchLength; i++, written++)
+            out[written] = out[written - offset];
+    }
+    return written == outSize;
+}
+
+// the high bytes of a float's XOR are mostly zero even where the low ones are noise; grouping every byte
+// position into its own plane turns them into long runs
+void splitBytePlanes(const uint32_t* values, uint8_t* planes) {
+    for (int i = 0; i < TILE_AREA; i++) {
+        for (int plane = 0; plane < 4; plane++)
+            planes[plane * TILE_AREA + i] = (uint8_t)(values[i] >> (8 * plane));
+    }
+}
+
+void joinBytePlanes(const uint8_t* planes, uint32_t* values) {
+    for (int i = 0; i < TILE_AREA; i++) {
+        values[i] = 0;
+        for (int plane = 0; plane < 4; plane++)
+            values[i] |= (uint32_t)planes[plane * TILE_AREA + i] << (8 * plane);
+    }
+}
+}
+
+std::unique_ptr<TerrainHistory> TerrainHistory::create() {
+    auto history = std::unique_ptr<TerrainHistory>(new TerrainHistory());
+    history->compressor = ThreadPool::create(1);
+    return std::move(history);
+}
+
+TerrainHistory::~TerrainHistory() {
+    clear();
+}
+
+void TerrainHistory::clear() {
+    compressor->wait();
+    std::lock_guard<std::mutex> lock(stepsMutex);
+    undoSteps.clear();
+    redoSteps.clear();
+    pendingTiles.clear();
+    isTilePending.clear();
+    width = height = numTilesX = 0;
+    memoryUsage = 0;
+    spilledBytes = 0;
+    std::lock_guard<std::mutex> spillLock(spillMutex);
+    if (spillFile) {
+        std::fclose(spillFile);
+        std::remove(spillPath.c_str());
+        spillFile = nullptr;
+    }
+    spillEnd = 0;
+}
+
+TexelRegion TerrainHistory::getTileRegion(int tile) const {
+    int x0 = tile % numTilesX * TILE_SIZE;
+    int y0 = tile / numTilesX * TILE_SIZE;
+    return { x0, y0, std::min(x0 + TILE_SIZE, width), std::min(y0 + TILE_SIZE, height) };
+}
+
+void TerrainHistory::recordBefore(const std::vector<float>& heights, int width, int height, const TexelRegion& region) {
+    PROFILE_FUNCTION();
+    if (width != this->width || height != this->height) {
+        // the steps are only valid for the size they were recorded at
+        if (this->width != 0)
+            clear();
+        this->width = width;
+        this->height = height;
+        numTilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        isTilePending.assign((size_t)numTilesX * ((height + TILE_SIZE - 1) / TILE_SIZE), 0);
+    }
+    if (region.x0 >= region.x1 || region.y0 >= region.y1)
+        return;
+    for (int tileY = region.y0 / TILE_SIZE; tileY <= (region.y1 - 1) / TILE_SIZE; tileY++) {
+        for (int tileX = region.x0 / TILE_SIZE; tileX <= (region.x1 - 1) / TILE_SIZE; tileX++) {
+            int tile = tileY * numTilesX + tileX;
+            if (isTilePending[tile])
+                continue;
+            isTilePending[tile] = 1;
+            // rows of TILE_SIZE samples, partial tiles at the borders are padded
+            TexelRegion texels = getTileRegion(tile);
+            std::vector<float> before(TILE_AREA, 0.0f);
+            for (int y = texels.y0; y < texels.y1; y++) {
+                const float* row = heights.data() + (size_t)y * width;
+                std::copy(row + texels.x0, row + texels.x1, before.begin() + (y - texels.y0) * TILE_SIZE);
+            }
+            pendingTiles.emplace_back(tile, std::move(before));
+        }
+    }
+}
+
+void TerrainHistory::endEdit(const std::vector<float>& heights) {
+    if (pendingTiles.empty())
+        return;
+    PROFILE_FUNCTION();
+    auto step = std::make_shared<Step>();
+    std::sort(pendingTiles.begin(), pendingTiles.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (const auto& [tile, before] : pendingTiles) {
+        isTilePending[tile] = 0;
+        TexelRegion texels = getTileRegion(tile);
+        TileDelta delta;
+        delta.tile = tile;
+        delta.raw.assign(TILE_AREA, 0);
+        uint32_t changed = 0;
+        for (int y = texels.y0; y < texels.y1; y++) {
+            for (int x = texels.x0; x < texels.x1; x++) {
+                int i = (y - texels.y0) * TILE_SIZE + (x - texels.x0);
+                uint32_t a, b;
+                std::memcpy(&a, &before[i], 4);
+                std::memcpy(&b, &heights[(size_t)y * width + x], 4);
+                delta.raw[i] = a ^ b;
+                changed |= a ^ b;
+            }
+        }
+        if (changed)
+            step->tiles.push_back(std::move(delta));
+    }
+    pendingTiles.clear();
+    if (step->tiles.empty())
+        return;
+
+    memoryUsage += step->tiles.size() * TILE_AREA * sizeof(uint32_t);
+    {
+        // a new step replaces the redo branch
+        std::lock_guard<std::mutex> lock(stepsMutex);
+        bool droppedSpilled = false;
+        for (auto& dropped : redoSteps) {
+            std::lock_guard<std::mutex> stepLock(dropped->mutex);
+            for (auto& tile : dropped->tiles) {
+                memoryUsage -= tile.raw.size() * sizeof(uint32_t) + tile.compressed.size();
+                if (dropped->spilled)
+                    spilledBytes -= tile.compressedSize;
+            }
+            droppedSpilled |= dropped->spilled;
+            dropped->tiles.clear();
+        }
+        redoSteps.clear();
+        if (droppedSpilled) {
+            // the file grows at spillEnd, so the space after the last spilled undo step is reused; a step is
+            // marked spilled under spillMutex, and its offset and sizes no longer change after that
+            std::lock_guard<std::mutex> spillLock(spillMutex);
+            long end = 0;
+            for (const auto& kept : undoSteps) {
+                if (!kept->spilled)
+                    continue;
+                long stepEnd = kept->spillOffset;
+                for (const auto& tile : kept->tiles)
+                    stepEnd += (long)tile.compressedSize;
+                end = std::max(end, stepEnd);
+            }
+            spillEnd = end;
+        }
+        undoSteps.push_back(step);
+    }
+    compressor->submit([this, step]() { compress(step); });
+}
+
+void TerrainHistory::compress(const std::shared_ptr<Step>& step) {
+    PROFILE_FUNCTION();
+    {
+        std::lock_guard<std::mutex> lock(step->mutex);
+        std::vector<uint8_t> planes((size_t)TILE_AREA * 4);
+        for (auto& tile : step->tiles) {
+            splitBytePlanes(tile.raw.data(), planes.data());
+            compressBlock(planes.data(), planes.size(), tile.compressed);
+            tile.compressed.shrink_to_fit();
+            tile.compressedSize = tile.compressed.size();
+            memoryUsage += tile.compressed.size();
+            memoryUsage -= tile.raw.size() * sizeof(uint32_t);
+            std::vector<uint32_t>().swap(tile.raw);
+        }
+        step->compressed = true;
+    }
+    spillOverBudget();
+}
+
+void TerrainHistory::spillOverBudget() {
+    size_t budget = (size_t)std::max(memoryBudgetMB, 0) << 20;
+    if (memoryUsage <= budget)
+        return;
+    // the oldest undo steps go first, then the redo steps furthest from the current state
+    std::vector<std::shared_ptr<Step>> steps;
+    {
+        std::lock_guard<std::mutex> lock(stepsMutex);
+        steps = undoSteps;
+        steps.insert(steps.end(), redoSteps.begin(), redoSteps.end());
+    }
+    for (auto& step : steps) {
+        if (memoryUsage <= budget)
+            break;
+        std::lock_guard<std::mutex> lock(step->mutex);
+        if (!step->compressed || step->spilled || step->tiles.empty())
+            continue;
+        std::lock_guard<std::mutex> spillLock(spillMutex);
+        if (!spillFile)
+            spillFile = std::fopen(spillPath.c_str(), "w+b");
+        if (!spillFile || std::fseek(spillFile, spillEnd, SEEK_SET) != 0) {
+            SPDLOG_ERROR("Failed to open the terrain history spill file: {}", spillPath);
+            return;
+        }
+        size_t bytes = 0;
+        bool written = true;
+        for (const auto& tile : step->tiles) {
+            written &= std::fwrite(tile.compressed.data(), 1, tile.compressed.size(), spillFile) == tile.compressed.size();
+            bytes += tile.compressed.size();
+        }
+        if (!written) {
+            SPDLOG_ERROR("Failed to write the terrain history spill file: {}", spillPath);
+            return;  // the step stays in memory
+        }
+        step->spillOffset = spillEnd;
+        spillEnd += (long)bytes;
+        for (auto& tile : step->tiles)
+            std::vector<uint8_t>().swap(tile.compressed);
+        step->spilled = true;
+        memoryUsage -= bytes;
+        spilledBytes += bytes;
+    }
+}
+
+bool TerrainHistory::undo(ThreadPool* threadPool, std::vector<float>& heights, std::vector<TexelRegion>& regions) {
+    std::shared_ptr<Step> step;
+    {
+        std::lock_guard<std::mutex> lock(stepsMutex);
+        if (undoSteps.empty())
+            return false;
+        step = undoSteps.back();
+    }
+    if (!apply(threadPool, *step, heights, regions))
+        return false;
+    std::lock_guard<std::mutex> lock(stepsMutex);
+    undoSteps.pop_back();
+    redoSteps.push_back(step);
+    return true;
+}
+
+bool TerrainHistory::redo(ThreadPool* threadPool, std::vector<float>& heights, std::vector<TexelRegion>& regions) {
+    std::shared_ptr<Step> step;
+    {
+        std::lock_guard<std::mutex> lock(stepsMutex);
+        if (redoSteps.empty())
+            return false;
+        step = redoSteps.back();
+    }
+    if (!apply(threadPool, *step, heights, regions))
+        return false;
+    std::lock_guard<std::mutex> lock(stepsMutex);
+    redoSteps.pop_back();
+    undoSteps.push_back(step);
+    return true;
+}
+
+bool TerrainHistory::apply(ThreadPool* threadPool, Step& step, std::vector<float>& heights, std::vector<TexelRegion>& regions) {
+    PROFILE_FUNCTION();
+    regions.clear();
+    if (heights.size() != (size_t)width * height)
+        return false;
+    // waits for the compressor if it is working on this step
+    std::lock_guard<std::mutex> lock(step.mutex);
+
+    // spilled steps are read back in one piece, kept only for this call
+    std::vector<uint8_t> spilled;
+    std::vector<size_t> spilledOffsets;
+    if (step.spilled) {
+        size_t bytes = 0;
+        for (const auto& tile : step.tiles) {
+            spilledOffsets.push_back(bytes);
+            bytes += tile.compressedSize;
+        }
+        spilled.resize(bytes);
+        std::lock_guard<std::mutex> spillLock(spillMutex);
+        if (!spillFile || std::fseek(spillFile, step.spillOffset, SEEK_SET) != 0
+            || std::fread(spilled.data(), 1, bytes, spillFile) != bytes) {
+            SPDLOG_ERROR("Failed to read the terrain history spill file: {}", spillPath);
+            return false;
+        }
+    }
+
+    // every tile is decoded before any is applied, so a corrupt step leaves the heights untouched and can be
+    // retried; the compressor handles whole steps, so either all tiles are raw or none
+    std::vector<uint32_t> decoded;
+    if (step.compressed) {
+        decoded.resize(step.tiles.size() * TILE_AREA);
+        std::atomic<bool> failed = false;
+        threadPool->parallelFor((int)step.tiles.size(), [&](int begin, int end) {
+            std::vector<uint8_t> planes((size_t)TILE_AREA * 4);
+            for (int t = begin; t < end && !failed; t++) {
+                const TileDelta& tile = step.tiles[t];
+                const uint8_t* data = step.spilled ? spilled.data() + spilledOffsets[t] : tile.compressed.data();
+                if (!decompressBlock(data, tile.compressedSize, planes.data(), planes.size()))
+                    failed = true;
+                else
+                    joinBytePlanes(planes.data(), decoded.data() + (size_t)t * TILE_AREA);
+            }
+        });
+        if (failed) {
+            SPDLOG_ERROR("Corrupt terrain history step, not applied");
+            return false;
+        }
+    }
+
+    // tiles are disjoint, so they are applied in parallel
+    threadPool->parallelFor((int)step.tiles.size(), [&](int begin, int end) {
+        for (int t = begin; t < end; t++) {
+            const TileDelta& tile = step.tiles[t];
+            const uint32_t* delta = step.compressed ? decoded.data() + (size_t)t * TILE_AREA : tile.raw.data();
+            TexelRegion texels = getTileRegion(tile.tile);
+            for (int y = texels.y0; y < texels.y1; y++) {
+                for (int x = texels.x0; x < texels.x1; x++) {
+                    float& sample = heights[(size_t)y * width + x];
+                    uint32_t bits;
+                    std::memcpy(&bits, &sample, 4);
+                    bits ^= delta[(y - texels.y0) * TILE_SIZE + (x - texels.x0)];
+                    std::memcpy(&sample, &bits, 4);
+                }
+            }
+        }
+    });
+
+    // runs of consecutive tiles along a tile row share one upload
+    for (const auto& tile : step.tiles) {
+        TexelRegion texels = getTileRegion(tile.tile);
+        if (!regions.empty() && regions.back().x1 == texels.x0 && regions.back().y0 == texels.y0)
+            regions.back().x1 = texels.x1;
+        else
+            regions.push_back(texels);
+    }
+    return true;
+}
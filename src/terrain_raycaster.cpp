@@ -0,0 +1,294 @@
+#include "terrain_raycaster.h"
+#include "thread_pool.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+
+namespace {
+// grid space: x and z in texel units (texel centers at integers), y as the raw height sample
+struct GridRay {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    glm::vec3 inverseDirection;
+};
+
+float safeInverse(float value) {
+    // axis-parallel rays divide by a tiny value instead of zero, keeping the slab test free of NaNs
+    return 1.0f / (std::abs(value) > 1e-12f ? value : std::copysign(1e-12f, value));
+}
+
+bool intersectBox(const GridRay& ray, const glm::vec3& boxMin, const glm::vec3& boxMax, float& tMin, float& tMax) {
+    for (int axis = 0; axis < 3; axis++) {
+        float t0 = (boxMin[axis] - ray.origin[axis]) * ray.inverseDirection[axis];
+        float t1 = (boxMax[axis] - ray.origin[axis]) * ray.inverseDirection[axis];
+        tMin = std::max(tMin, std::min(t0, t1));
+        tMax = std::min(tMax, std::max(t0, t1));
+    }
+    return tMin <= tMax;
+}
+}
+
+std::unique_ptr<TerrainRaycaster> TerrainRaycaster::create(const Heightfield* heightfield, ThreadPool* threadPool) {
+    if (!heightfield || heightfield->getWidth() < 2 || heightfield->getHeight() < 2) {
+        SPDLOG_ERROR("Terrain raycaster needs a heightfield of at least 2x2 samples");
+        return nullptr;
+    }
+    auto raycaster = std::unique_ptr<TerrainRaycaster>(new TerrainRaycaster());
+    raycaster->heightfield = heightfield;
+    raycaster->build(threadPool);
+    return std::move(raycaster);
+}
+
+void TerrainRaycaster::build(ThreadPool* threadPool) {
+    PROFILE_FUNCTION();
+    numCellsX = heightfield->getWidth() - 1;
+    numCellsY = heightfield->getHeight() - 1;
+    int leafSize = 1 << LEAF_SHIFT;
+
+    // leaves: highest sample at the corners of their cells
+    Level leaves;
+    leaves.width = (numCellsX + leafSize - 1) / leafSize;
+    leaves.height = (numCellsY + leafSize - 1) / leafSize;
+    leaves.maxHeights.resize((size_t)leaves.width * leaves.height);
+    auto buildLeafRows = [&](int rowBegin, int rowEnd) {
+        for (int leafY = rowBegin; leafY < rowEnd; leafY++) {
+            for (int leafX = 0; leafX < leaves.width; leafX++)
+                leaves.maxHeights[(size_t)leafY * leaves.width + leafX] = computeLeafMax(leafX, leafY);
+        }
+    };
+    if (threadPool)
+        threadPool->parallelFor(leaves.height, buildLeafRows);
+    else
+        buildLeafRows(0, leaves.height);
+
+    levels.clear();
+    levels.push_back(std::move(leaves));
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const Level& below = levels.back();
+        Level level;
+        level.width = (below.width + 1) / 2;
+        level.height = (below.height + 1) / 2;
+        level.maxHeights.resize((size_t)level.width * level.height);
+        for (int y = 0; y < level.height; y++) {
+            for (int x = 0; x < level.width; x++)
+                level.maxHeights[(size_t)y * level.width + x] = computeNodeMax(below, x, y);
+        }
+        levels.push_back(std::move(level));
+    }
+}
+
+void TerrainRaycaster::update(const TexelRegion& region) {
+    PROFILE_FUNCTION();
+    if (region.x0 >= region.x1 || region.y0 >= region.y1)
+        return;
+    // a sample is a corner of the cells on both sides of it
+    int leafX0 = std::max(region.x0 - 1, 0) >> LEAF_SHIFT;
+    int leafY0 = std::max(region.y0 - 1, 0) >> LEAF_SHIFT;
+    int leafX1 = std::min((region.x1 - 1) >> LEAF_SHIFT, levels[0].width - 1);
+    int leafY1 = std::min((region.y1 - 1) >> LEAF_SHIFT, levels[0].height - 1);
+    for (int leafY = leafY0; leafY <= leafY1; leafY++) {
+        for (int leafX = leafX0; leafX <= leafX1; leafX++)
+            levels[0].maxHeights[(size_t)leafY * levels[0].width + leafX] = computeLeafMax(leafX, leafY);
+    }
+    // the parents of the refitted nodes, up to the root
+    for (size_t i = 1; i < levels.size(); i++) {
+        leafX0 >>= 1;
+        leafY0 >>= 1;
+        leafX1 >>= 1;
+        leafY1 >>= 1;
+        Level& level = levels[i];
+        for (int y = leafY0; y <= leafY1; y++) {
+            for (int x = leafX0; x <= leafX1; x++)
+                level.maxHeights[(size_t)y * level.width + x] = computeNodeMax(levels[i - 1], x, y);
+        }
+    }
+}
+
+float TerrainRaycaster::computeLeafMax(int leafX, int leafY) const {
+    int leafSize = 1 << LEAF_SHIFT;
+    int x0 = leafX * leafSize;
+    int y0 = leafY * leafSize;
+    int x1 = std::min(x0 + leafSize, numCellsX);
+    int y1 = std::min(y0 + leafSize, numCellsY);
+    float top = -FLT_MAX;
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++)
+            top = std::max(top, heightfield->getSample(x, y));
+    }
+    return top;
+}
+
+float TerrainRaycaster::computeNodeMax(const Level& below, int x, int y) const {
+    float top = -FLT_MAX;
+    for (int childY = 2 * y; childY < std::min(2 * y + 2, below.height); childY++) {
+        for (int childX = 2 * x; childX < std::min(2 * x + 2, below.width); childX++)
+            top = std::max(top, below.maxHeights[(size_t)childY * below.width + childX]);
+    }
+    return top;
+}
+
+float TerrainRaycaster::intersectLeaf(int leafX, int leafY, const glm::vec3& origin, const glm::vec3& direction,
+    float tMin, float tMax) const {
+    GridRay ray = { origin, direction, glm::vec3(safeInverse(direction.x), safeInverse(direction.y), safeInverse(direction.z)) };
+    int leafSize = 1 << LEAF_SHIFT;
+    float nearest = -1.0f;
+    for (int cellY = leafY * leafSize; cellY < std::min((leafY + 1) * leafSize, numCellsY); cellY++) {
+        for (int cellX = leafX * leafSize; cellX < std::min((leafX + 1) * leafSize, numCellsX); cellX++) {
+            float h00 = heightfield->getSample(cellX, cellY);
+            float h10 = heightfield->getSample(cellX + 1, cellY);
+            float h01 = heightfield->getSample(cellX, cellY + 1);
+            float h11 = heightfield->getSample(cellX + 1, cellY + 1);
+            float t0 = tMin;
+            float t1 = nearest >= 0.0f ? nearest : tMax;
+            glm::vec3 boxMin(cellX, -FLT_MAX, cellY);
+            glm::vec3 boxMax(cellX + 1, std::max(std::max(h00, h10), std::max(h01, h11)), cellY + 1);
+            if (!intersectBox(ray, boxMin, boxMax, t0, t1))
+                continue;
+
+            // bilinear patch h = a + b fx + c fy + d fx fy along the ray is quadratic in t;
+            // f(t) = ray height - surface height, the first root after t0 is the hit
+            float px = origin.x - cellX;
+            float py = origin.z - cellY;
+            float b = h10 - h00;
+            float c = h01 - h00;
+            float d = h00 - h10 - h01 + h11;
+            float A = -d * direction.x * direction.z;
+            float B = direction.y - (b * direction.x + c * direction.z + d * (px * direction.z + py * direction.x));
+            float C = origin.y - (h00 + b * px + c * py + d * px * py);
+            auto f = [&](float t) { return (A * t + B) * t + C; };
+            float t = -1.0f;
+            if (f(t0) <= 0.0f)
+                t = t0;  // enters the cell below the surface
+            else {
+                float roots[2];
+                int numRoots = 0;
+                if (std::abs(A) < 1e-9f) {
+                    if (B != 0.0f)
+                        roots[numRoots++] = -C / B;
+                } else {
+                    float discriminant = B * B - 4.0f * A * C;
+                    if (discriminant >= 0.0f) {
+                        // numerically stable pair
+                        float q = -0.5f * (B + std::copysign(std::sqrt(discriminant), B));
+                        roots[numRoots++] = q / A;
+                        if (q != 0.0f)
+                            roots[numRoots++] = C / q;
+                    }
+                }
+                for (int i = 0; i < numRoots; i++) {
+                    if (roots[i] >= t0 && roots[i] <= t1 && (t < 0.0f || roots[i] < t))
+                        t = roots[i];
+                }
+                if (t < 0.0f && f(t1) <= 0.0f)
+                    t = t1;  // grazing hit lost to rounding
+            }
+            if (t >= 0.0f)
+                nearest = t;
+        }
+    }
+    return nearest;
+}
+
+TerrainRaycaster::Hit TerrainRaycaster::intersect(const Ray& ray) const {
+    Hit hit;
+    float heightScale = heightfield->getHeightScale();
+    float heightOffset = heightfield->getHeightOffset();
+    float tMax = ray.maxDistance;
+    if (std::abs(heightScale) < 1e-6f) {
+        // flat: the plane at the offset
+        if (ray.direction.y == 0.0f)
+            return hit;
+        float t = (heightOffset - ray.origin.y) / ray.direction.y;
+        glm::vec3 position = ray.origin + ray.direction * t;
+        if (t >= 0.0f && t <= tMax && heightfield->contains(position.x, position.z)) {
+            hit.hit = true;
+            hit.distance = t;
+            hit.position = position;
+        }
+        return hit;
+    }
+
+    // world to grid space keeps the ray parameter, so distances carry over unchanged
+    float horizontalScale = heightfield->getHorizontalScale();
+    int width = heightfield->getWidth();
+    int height = heightfield->getHeight();
+    glm::vec3 scale(width / horizontalScale, 1.0f / heightScale, height / horizontalScale);
+    glm::vec3 bias(width * 0.5f - 0.5f, -heightOffset / heightScale, height * 0.5f - 0.5f);
+    GridRay gridRay;
+    gridRay.origin = ray.origin * scale + bias;
+    gridRay.direction = ray.direction * scale;
+    gridRay.inverseDirection = glm::vec3(safeInverse(gridRay.direction.x), safeInverse(gridRay.direction.y),
+        safeInverse(gridRay.direction.z));
+
+    // front-to-back depth first: the children of a node are disjoint along the ray, so the first hit is the nearest
+    struct Node {
+        int level;
+        int x;
+        int y;
+        float tMin;
+        float tMax;
+    };
+    auto nodeBounds = [&](int level, int x, int y, glm::vec3& boxMin, glm::vec3& boxMax) {
+        int shift = level + LEAF_SHIFT;
+        float top = levels[level].maxHeights[(size_t)y * levels[level].width + x];
+        boxMin = glm::vec3(x << shift, -FLT_MAX, y << shift);  // solid down to the bottom
+        boxMax = glm::vec3(std::min((x + 1) << shift, numCellsX), top, std::min((y + 1) << shift, numCellsY));
+    };
+    Node stack[4 * 32];
+    int stackSize = 0;
+    glm::vec3 boxMin, boxMax;
+    int rootLevel = (int)levels.size() - 1;
+    nodeBounds(rootLevel, 0, 0, boxMin, boxMax);
+    float rootMin = 0.0f;
+    float rootMax = tMax;
+    if (intersectBox(gridRay, boxMin, boxMax, rootMin, rootMax))
+        stack[stackSize++] = { rootLevel, 0, 0, rootMin, rootMax };
+
+    while (stackSize > 0) {
+        Node node = stack[--stackSize];
+        if (node.level == 0) {
+            float t = intersectLeaf(node.x, node.y, gridRay.origin, gridRay.direction, node.tMin, node.tMax);
+            if (t >= 0.0f) {
+                hit.hit = true;
+                hit.distance = t;
+                hit.position = ray.origin + ray.direction * t;
+                return hit;
+            }
+            continue;
+        }
+
+        const Level& children = levels[node.level - 1];
+        Node hits[4];
+        int numHits = 0;
+        for (int y = 2 * node.y; y < std::min(2 * node.y + 2, children.height); y++) {
+            for (int x = 2 * node.x; x < std::min(2 * node.x + 2, children.width); x++) {
+                nodeBounds(node.level - 1, x, y, boxMin, boxMax);
+                float childMin = node.tMin;
+                float childMax = node.tMax;
+                if (intersectBox(gridRay, boxMin, boxMax, childMin, childMax))
+                    hits[numHits++] = { node.level - 1, x, y, childMin, childMax };
+            }
+        }
+        std::sort(hits, hits + numHits, [](const Node& a, const Node& b) { return a.tMin < b.tMin; });
+        for (int i = numHits - 1; i >= 0; i--)
+            stack[stackSize++] = hits[i];
+    }
+    return hit;
+}
+
+void TerrainRaycaster::intersect(const Ray* rays, Hit* hits, size_t count, ThreadPool* threadPool) const {
+    PROFILE_FUNCTION();
+    auto intersectRange = [&](int begin, int end) {
+        for (int i = begin; i < end; i++)
+            hits[i] = intersect(rays[i]);
+    };
+    if (threadPool)
+        threadPool->parallelFor((int)count, intersectRange);
+    else
+        intersectRange(0, (int)count);
+}
+
+bool TerrainRaycaster::isVisible(const glm::vec3& from, const glm::vec3& to) const {
+    // stop just short of the target so a point on the surface can see and be seen
+    Ray ray = { from, to - from, 1.0f - 1e-4f };
+    return !intersect(ray).hit;
+}
@@ -0,0 +1,97 @@
+#include "terrain_sculptor.h"
+#include "cpu_profiler.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr float BLEND_RATE = 20.0f;  // smooth and flatten blend factor per second, per unit of strength
+}
+
+std::unique_ptr<TerrainSculptor> TerrainSculptor::create() {
+    return std::unique_ptr<TerrainSculptor>(new TerrainSculptor());
+}
+
+void TerrainSculptor::beginStroke(const std::vector<float>& heights, int width, int height, glm::vec2 center) {
+    int x = std::clamp((int)std::lround(center.x), 0, width - 1);
+    int y = std::clamp((int)std::lround(center.y), 0, height - 1);
+    flattenHeight = heights[(size_t)y * width + x];
+}
+
+TexelRegion TerrainSculptor::getStampRegion(glm::vec2 center, int width, int height) const {
+    float brushRadius = std::max(radius, 0.5f);
+    TexelRegion region = {
+        std::max((int)std::floor(center.x - brushRadius), 0),
+        std::max((int)std::floor(center.y - brushRadius), 0),
+        std::min((int)std::ceil(center.x + brushRadius) + 1, width),
+        std::min((int)std::ceil(center.y + brushRadius) + 1, height)
+    };
+    if (region.x0 >= region.x1 || region.y0 >= region.y1)
+        return { 0, 0, 0, 0 };
+    return region;
+}
+
+TexelRegion TerrainSculptor::stamp(ThreadPool* threadPool, std::vector<float>& heights, int width, int height,
+    glm::vec2 center, float deltaTime) {
+    PROFILE_FUNCTION();
+    float brushRadius = std::max(radius, 0.5f);
+    TexelRegion region = getStampRegion(center, width, height);
+    if (region.x0 >= region.x1)
+        return region;
+
+    // smoothing reads the heights before the stamp, including the texels around the region
+    int sourceX0 = std::max(region.x0 - 1, 0);
+    int sourceY0 = std::max(region.y0 - 1, 0);
+    int sourceWidth = std::min(region.x1 + 1, width) - sourceX0;
+    int sourceHeight = std::min(region.y1 + 1, height) - sourceY0;
+    if (mode == SMOOTH) {
+        source.resize((size_t)sourceWidth * sourceHeight);
+        for (int y = 0; y < sourceHeight; y++) {
+            const float* row = heights.data() + (size_t)(sourceY0 + y) * width + sourceX0;
+            std::copy(row, row + sourceWidth, source.begin() + (size_t)y * sourceWidth);
+        }
+    }
+
+    float innerRadius = brushRadius * std::clamp(hardness, 0.0f, 1.0f);
+    float step = strength * deltaTime;
+    float blend = BLEND_RATE * step;
+    threadPool->parallelFor(region.y1 - region.y0, [&](int rowBegin, int rowEnd) {
+        for (int y = region.y0 + rowBegin; y < region.y0 + rowEnd; y++) {
+            float* row = heights.data() + (size_t)y * width;
+            float dy = y - center.y;
+            for (int x = region.x0; x < region.x1; x++) {
+                float distance = std::sqrt((x - center.x) * (x - center.x) + dy * dy);
+                if (distance >= brushRadius)
+                    continue;
+                float weight = distance <= innerRadius ? 1.0f
+                    : 1.0f - glm::smoothstep(innerRadius, brushRadius, distance);
+                float h = row[x];
+                switch (mode) {
+                case RAISE:
+                    h += step * weight;
+                    break;
+                case LOWER:
+                    h -= step * weight;
+                    break;
+                case SMOOTH: {
+                    // 3x3 mean of the heights before the stamp, clamped at the map border
+                    float sum = 0.0f;
+                    for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, height - 1); ny++) {
+                        for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, width - 1); nx++)
+                            sum += source[(size_t)(ny - sourceY0) * sourceWidth + (nx - sourceX0)];
+                    }
+                    int count = (std::min(y + 1, height - 1) - std::max(y - 1, 0) + 1)
+                        * (std::min(x + 1, width - 1) - std::max(x - 1, 0) + 1);
+                    h += (sum / count - h) * std::min(blend * weight, 1.0f);
+                    break;
+                }
+                case FLATTEN:
+                    h += (flattenHeight - h) * std::min(blend * weight, 1.0f);
+                    break;
+                }
+                row[x] = std::clamp(h, 0.0f, 1.0f);  // the height map range
+            }
+        }
+    });
+    return region;
+}
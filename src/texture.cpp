@@ -1,8 +1,10 @@
 #include "common.h"
 #include "texture.h"
+#include "cpu_profiler.h"
 #include <stb/stb_image.h>
 
 Texture::Texture(const char* filePath) {
+    PROFILE_ZONE("Texture::Texture");
     glGenTextures(1, &ID);
     glBindTexture(GL_TEXTURE_2D, ID);
     // set the texture wrapping parameters
@@ -16,12 +18,9 @@ Texture::Texture(const char* filePath) {
     SPDLOG_INFO("Image loaded: path: {} width: {}, height: {}, channels: {}", filePath, width, height, channels);
     if (data)
     {
-        if (channels == 3) {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        }
-        else {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        }
+        format = channels == 3 ? GL_RGB : GL_RGBA;
+        dataType = GL_UNSIGNED_BYTE;
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
         SPDLOG_INFO("Texture loaded");
     }
@@ -32,8 +31,73 @@ Texture::Texture(const char* filePath) {
     stbi_image_free(data);
 }
 
+Texture::Texture(int width, int height, int channels, const unsigned char* data)
+    : width(width), height(height), channels(channels) {
+    PROFILE_ZONE("Texture::Texture");
+    format = channels == 3 ? GL_RGB : GL_RGBA;
+    dataType = GL_UNSIGNED_BYTE;
+    glGenTextures(1, &ID);
+    glBindTexture(GL_TEXTURE_2D, ID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);  // RGB rows are not padded
+    // sized, so the texture can also be bound as an image by the compute passes
+    GLenum internalFormat = channels == 3 ? GL_RGB8 : GL_RGBA8;
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+Texture::Texture(int width, int height, const float* data)
+    : width(width), height(height), channels(1) {
+    PROFILE_ZONE("Texture::Texture");
+    format = GL_RED;
+    dataType = GL_FLOAT;
+    glGenTextures(1, &ID);
+    glBindTexture(GL_TEXTURE_2D, ID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // the shaders read height maps from the green channel
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, data);
+}
+
+void Texture::update(const void* data) {
+    PROFILE_ZONE("Texture::update");
+    glBindTexture(GL_TEXTURE_2D, ID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, dataType, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (dataType == GL_UNSIGNED_BYTE)
+        glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+void Texture::updateRegion(int x, int y, int w, int h, const void* data) {
+    PROFILE_ZONE("Texture::updateRegion");
+    glBindTexture(GL_TEXTURE_2D, ID);
+    // data is laid out like update's, the unpack state picks the rectangle out of it
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, x);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, y);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, format, dataType, data);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    // only the float height map is updated by region, and it has no mips
+    if (dataType == GL_UNSIGNED_BYTE)
+        glGenerateMipmap(GL_TEXTURE_2D);
+}
+
 CubemapTexture::CubemapTexture(const std::vector<std::string>& faces)
 {
+    PROFILE_ZONE("CubemapTexture::CubemapTexture");
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
     stbi_set_flip_vertically_on_load(false);
@@ -0,0 +1,95 @@
+#include "thread_pool.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+
+std::unique_ptr<ThreadPool> ThreadPool::create(int numThreads) {
+    auto threadPool = std::unique_ptr<ThreadPool>(new ThreadPool());
+    threadPool->init(numThreads);
+    return std::move(threadPool);
+}
+
+void ThreadPool::init(int numThreads) {
+    if (numThreads <= 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < numThreads; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push(std::move(task));
+        numUnfinishedTasks++;
+    }
+    taskAvailable.notify_one();
+}
+
+void ThreadPool::waitForPendingBelow(size_t maxPending) {
+    std::unique_lock<std::mutex> lock(mutex);
+    taskFinished.wait(lock, [&]() { return numUnfinishedTasks < maxPending; });
+}
+
+void ThreadPool::wait() {
+    waitForPendingBelow(1);
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int begin, int end)>& body) {
+    int numChunks = std::min(count, 4 * (getNumThreads() + 1));
+    if (numChunks <= 1) {
+        body(0, count);
+        return;
+    }
+
+    // the caller only waits for its own chunks, not for unrelated queued tasks
+    std::mutex chunkMutex;
+    std::condition_variable chunkFinished;
+    int numRemaining = numChunks - 1;
+    auto chunkRange = [count, numChunks](int chunk) {
+        return std::make_pair((int)((int64_t)count * chunk / numChunks), (int)((int64_t)count * (chunk + 1) / numChunks));
+    };
+    for (int chunk = 1; chunk < numChunks; chunk++) {
+        submit([&, chunk]() {
+            auto [begin, end] = chunkRange(chunk);
+            body(begin, end);
+            std::lock_guard<std::mutex> lock(chunkMutex);
+            if (--numRemaining == 0)
+                chunkFinished.notify_one();
+        });
+    }
+    auto [begin, end] = chunkRange(0);
+    body(begin, end);
+    std::unique_lock<std::mutex> lock(chunkMutex);
+    chunkFinished.wait(lock, [&]() { return numRemaining == 0; });
+}
+
+void ThreadPool::workerLoop(int index) {
+    CpuProfiler::setThreadName("worker " + std::to_string(index));
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            // finish the queue before stopping so no submitted work is lost
+            if (tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            numUnfinishedTasks--;
+        }
+        taskFinished.notify_all();
+    }
+}
@@ -106,3 +106,16 @@ unsigned int generatePositionTextureVAOWithEBO(const std::vector<float>& vertice
         indices.size() * sizeof(unsigned int)
     );
 }
+
+void extractFrustumPlanes(const glm::mat4& matrix, glm::vec4 planes[6])
+{
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+    planes[0] = rows[3] + rows[0];
+    planes[1] = rows[3] - rows[0];
+    planes[2] = rows[3] + rows[1];
+    planes[3] = rows[3] - rows[1];
+    planes[4] = rows[3] + rows[2];
+    planes[5] = rows[3] - rows[2];
+}
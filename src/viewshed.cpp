@@ -0,0 +1,245 @@
+#include "viewshed.h"
+#include "thread_pool.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+
+namespace {
+// one eighth of the plane around the observer: the texel at ring r (steps along the major axis) and
+// minor offset m is observer + majorSign * r * major + minorSign * m * minor
+struct Octant {
+    int majorAxis;  // 0: x, 1: y
+    int majorSign;
+    int minorSign;
+    int majorLimit;  // rings until the border
+    int minorLimit;
+    int numRays;     // rays 0..numRays-1 have slopes k / (numRays - 1)
+};
+}
+
+std::unique_ptr<Viewshed> Viewshed::create() {
+    auto viewshed = std::unique_ptr<Viewshed>(new Viewshed());
+    glGenTextures(1, &viewshed->texture);
+    // half the cores, the frame's pool keeps the others; the trace occupies one tracer, so at least two
+    viewshed->tracers = ThreadPool::create(std::max(2, (int)std::thread::hardware_concurrency() / 2));
+    return std::move(viewshed);
+}
+
+Viewshed::~Viewshed() {
+    tracers->wait();
+    glDeleteTextures(1, &texture);
+}
+
+bool Viewshed::compute(const Heightfield* heightfield, const glm::vec2& observer) {
+    bool uploaded = false;
+    if (computing) {
+        if (!finished)
+            return false;  // the last mask stays displayed meanwhile
+        computing = false;
+        observerPosition = computedObserverPosition;
+        computeTime = computedTime;
+        valid = true;
+        upload();
+        uploaded = true;
+    }
+    if (!heightfield)
+        return uploaded;
+    int width = heightfield->getWidth();
+    int height = heightfield->getHeight();
+    float horizontalScale = heightfield->getHorizontalScale();
+    float heightScale = heightfield->getHeightScale();
+    float heightOffset = heightfield->getHeightOffset();
+
+    // the observer stands on the nearest texel center, clamped to the terrain
+    glm::ivec2 observerTexel(
+        std::clamp((int)std::lround(observer.x * width / horizontalScale + width * 0.5f - 0.5f), 0, width - 1),
+        std::clamp((int)std::lround(observer.y * height / horizontalScale + height * 0.5f - 0.5f), 0, height - 1));
+    glm::vec4 heights(heightScale, heightOffset, observerHeight, targetHeight);
+    bool heightsChanged = !snapshot || snapshot->getRevision() != heightfield->getRevision();
+    if (valid && !stale && !heightsChanged && observerTexel == lastObserverTexel && heights == lastHeights
+        && horizontalScale == lastHorizontalScale)
+        return uploaded;
+
+    PROFILE_FUNCTION();
+    // the trace reads its own copy, so the heightfield can be edited or replaced while it runs
+    if (heightsChanged) {
+        if (snapshot)
+            *snapshot = *heightfield;
+        else
+            snapshot = std::make_unique<Heightfield>(*heightfield);
+    }
+    if (width != this->width || height != this->height) {
+        this->width = width;
+        this->height = height;
+        mask.assign((size_t)width * height, 0);
+        uploadedMask.clear();  // forces a full upload
+    }
+    stale = false;
+    lastObserverTexel = observerTexel;
+    lastHeights = heights;
+    lastHorizontalScale = horizontalScale;
+
+    computing = true;
+    finished = false;
+    tracers->submit([this, observerTexel, heights, horizontalScale]() {
+        trace(observerTexel, heights, horizontalScale);
+        finished = true;
+    });
+    return uploaded;
+}
+
+void Viewshed::trace(glm::ivec2 observerTexel, glm::vec4 heights, float horizontalScale) {
+    PROFILE_FUNCTION();
+    auto start = std::chrono::steady_clock::now();
+    const Heightfield* heightfield = snapshot.get();
+    float heightScale = heights.x;
+    float heightOffset = heights.y;
+    float observerHeight = heights.z;
+    float targetHeight = heights.w;
+
+    float groundHeight = heightfield->getSample(observerTexel.x, observerTexel.y) * heightScale + heightOffset;
+    float eyeHeight = groundHeight + observerHeight;
+    computedObserverPosition = glm::vec3(
+        horizontalScale * ((observerTexel.x + 0.5f) / width - 0.5f), eyeHeight,
+        horizontalScale * ((observerTexel.y + 0.5f) / height - 0.5f));
+    mask[(size_t)observerTexel.y * width + observerTexel.x] = 255;
+
+    // texels with |dx| >= |dy| belong to the x-major octants, the others to the y-major ones;
+    // the negative-minor octants leave the axis (m = 0) and the y-major ones the diagonal (m = r) to their neighbors
+    Octant octants[8];
+    int rayOffsets[9] = {};
+    for (int i = 0; i < 8; i++) {
+        Octant& octant = octants[i];
+        octant.majorAxis = i / 4;
+        octant.majorSign = (i & 2) ? -1 : 1;
+        octant.minorSign = (i & 1) ? -1 : 1;
+        glm::ivec2 size(width, height);
+        int majorPosition = observerTexel[octant.majorAxis];
+        int minorPosition = observerTexel[1 - octant.majorAxis];
+        octant.majorLimit = octant.majorSign > 0 ? size[octant.majorAxis] - 1 - majorPosition : majorPosition;
+        octant.minorLimit = octant.minorSign > 0 ? size[1 - octant.majorAxis] - 1 - minorPosition : minorPosition;
+        octant.numRays = octant.majorLimit > 0 ? octant.majorLimit + 1 : 0;  // one per border texel
+        rayOffsets[i + 1] = rayOffsets[i] + octant.numRays;
+    }
+
+    // rays of a group advance ring by ring together, so neighboring rays share the cache lines they read
+    constexpr int RAY_GROUP_SIZE = 32;
+    auto traceRayGroup = [&](const Octant& octant, int64_t firstRay, int numRays) {
+        int64_t numSlopes = octant.numRays - 1;  // > 0
+        int firstMinor = octant.minorSign < 0 ? 1 : 0;
+        auto texel = [&](int r, int m) {
+            int major = observerTexel[octant.majorAxis] + octant.majorSign * r;
+            int minor = observerTexel[1 - octant.majorAxis] + octant.minorSign * m;
+            return octant.majorAxis == 0 ? glm::ivec2(major, minor) : glm::ivec2(minor, major);
+        };
+        auto sampleHeight = [&](int r, int m) {
+            glm::ivec2 position = texel(r, m);
+            return heightfield->getSample(position.x, position.y) * heightScale + heightOffset;
+        };
+
+        // ray i owns the texels m at ring r with round(m * numSlopes / r) == k, i.e. m from
+        // ceil((2k - 1) r / (2 numSlopes)) on; these bounds are stepped along the rings without divisions
+        int denominator = 2 * (int)numSlopes;
+        int boundSteps[RAY_GROUP_SIZE + 1];
+        int bounds[RAY_GROUP_SIZE + 1];
+        int boundSlacks[RAY_GROUP_SIZE + 1];  // bound * denominator - (2k - 1) r, in [0, denominator)
+        float raySlopes[RAY_GROUP_SIZE];
+        for (int i = 0; i <= numRays; i++) {
+            boundSteps[i] = 2 * (int)(firstRay + i) - 1;
+            bounds[i] = 0;
+            boundSlacks[i] = 0;
+            if (i < numRays)
+                raySlopes[i] = (float)(firstRay + i) / (float)numSlopes;
+        }
+
+        // elevation slopes are height over ring number: a ray's horizontal length per ring is constant
+        float horizons[RAY_GROUP_SIZE];
+        std::fill(horizons, horizons + numRays, -FLT_MAX);
+        int lastMinor = octant.majorAxis == 0 ? 0 : -1;  // the diagonal belongs to the x-major octants
+        for (int r = 1; r <= octant.majorLimit; r++) {
+            for (int i = 0; i <= numRays; i++) {
+                boundSlacks[i] -= boundSteps[i];
+                while (boundSlacks[i] < 0) {
+                    bounds[i]++;
+                    boundSlacks[i] += denominator;
+                }
+                while (boundSlacks[i] >= denominator) {
+                    bounds[i]--;
+                    boundSlacks[i] -= denominator;
+                }
+            }
+            float inverseRing = 1.0f / r;
+            for (int i = 0; i < numRays; i++) {
+                float rayMinor = r * raySlopes[i];
+                if (rayMinor - 0.5f > octant.minorLimit) {
+                    // left the terrain, and so did every texel this ray and the steeper ones are closest to
+                    if (i == 0)
+                        return;
+                    break;
+                }
+
+                int ownedBegin = std::max(firstMinor, bounds[i]);
+                int ownedEnd = std::min(std::min(bounds[i + 1], r + 1 + lastMinor), octant.minorLimit + 1);
+                for (int m = ownedBegin; m < ownedEnd; m++) {
+                    float slope = (sampleHeight(r, m) + targetHeight - eyeHeight) * inverseRing;
+                    glm::ivec2 position = texel(r, m);
+                    mask[(size_t)position.y * width + position.x] = slope >= horizons[i] ? 255 : 0;
+                }
+
+                // the terrain under the ray itself, interpolated across the ring
+                int minor0 = std::min((int)rayMinor, octant.minorLimit);
+                int minor1 = std::min(minor0 + 1, octant.minorLimit);
+                float t = std::min(rayMinor - minor0, 1.0f);
+                float height0 = sampleHeight(r, minor0);
+                float rayHeight = height0 + (sampleHeight(r, minor1) - height0) * t;
+                horizons[i] = std::max(horizons[i], (rayHeight - eyeHeight) * inverseRing);
+            }
+        }
+    };
+    auto traceRays = [&](int begin, int end) {
+        for (int ray = begin; ray < end;) {
+            int octantIndex = (int)(std::upper_bound(rayOffsets, rayOffsets + 9, ray) - rayOffsets) - 1;
+            int groupEnd = std::min({ end, ray + RAY_GROUP_SIZE, rayOffsets[octantIndex + 1] });
+            traceRayGroup(octants[octantIndex], ray - rayOffsets[octantIndex], groupEnd - ray);
+            ray = groupEnd;
+        }
+    };
+    // runs on one of the tracers, the parallelFor hands the other sectors to the rest of them
+    tracers->parallelFor(rayOffsets[8], traceRays);
+
+    computedTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Viewshed::upload() {
+    PROFILE_FUNCTION();
+    size_t numVisible = std::count(mask.begin(), mask.end(), (unsigned char)255);
+    visibleFraction = (float)numVisible / (float)mask.size();
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (uploadedMask.size() != mask.size()) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, mask.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    } else {
+        // a short move mostly changes the rows near the observer
+        int firstRow = 0;
+        int lastRow = height - 1;
+        auto rowEquals = [&](int y) {
+            return std::equal(mask.begin() + (size_t)y * width, mask.begin() + (size_t)(y + 1) * width,
+                uploadedMask.begin() + (size_t)y * width);
+        };
+        while (firstRow <= lastRow && rowEquals(firstRow))
+            firstRow++;
+        while (lastRow > firstRow && rowEquals(lastRow))
+            lastRow--;
+        if (firstRow <= lastRow)
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, width, lastRow - firstRow + 1, GL_RED, GL_UNSIGNED_BYTE,
+                mask.data() + (size_t)firstRow * width);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    uploadedMask = mask;
+}
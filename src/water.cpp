@@ -42,7 +42,7 @@ void Water::render() {
     waterShader->setBool("useSpecular", specular);
     waterShader->setVec3("lightColor", context->light->color);
     waterShader->setVec3("lightDir", context->light->direction);
-    float moveFactor = WAVE_SPEED * glfwGetTime();
+    float moveFactor = WAVE_SPEED * context->getElapsedTime();
     moveFactor = fmod(moveFactor, 1.0f);
     waterShader->setFloat("moveFactor", moveFactor);
     waterShader->setFloat("tiling", tiling);